@@ -21,6 +21,8 @@ DOWNLOAD_RDEP=$(STAMP_PREPARED) $(HOST_STAMP_PREPARED)
 # Export options for download.pl
 export DOWNLOAD_CHECK_CERTIFICATE:=$(CONFIG_DOWNLOAD_CHECK_CERTIFICATE)
 export DOWNLOAD_TOOL_CUSTOM:=$(CONFIG_DOWNLOAD_TOOL_CUSTOM)
+export DOWNLOAD_MIRROR_RACE:=$(CONFIG_DOWNLOAD_MIRROR_RACE)
+export DOWNLOAD_STORE:=$(call qstrip,$(CONFIG_DOWNLOAD_STORE))
 
 define dl_method_git
 $(if $(filter https://github.com/% git://github.com/%,$(1)),github_archive,git)
@@ -331,6 +333,7 @@ define Download
   )
   download: $(DL_DIR)/$(FILE)
 
+  $(call ProfileStep,$(DL_DIR)/$(FILE),download)
   $(DL_DIR)/$(FILE):
 	mkdir -p $(DL_DIR)
 	$(call locked, \
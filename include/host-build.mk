@@ -54,7 +54,7 @@ HOST_CONFIGURE_VARS = \
 	CPPFLAGS="$(HOST_CPPFLAGS)" \
 	CXXFLAGS="$(HOST_CXXFLAGS)" \
 	LDFLAGS="$(HOST_LDFLAGS)" \
-	CONFIG_SHELL="$(SHELL)"
+	CONFIG_SHELL="$(or $(BUILD_PROFILE_SHELL),$(SHELL))"
 
 HOST_CONFIGURE_ARGS = \
 	--target=$(GNU_HOST_NAME) \
@@ -138,6 +138,84 @@ define Host/Exports/Default
 endef
 Host/Exports=$(Host/Exports/Default)
 
+# Host build cache (CONFIG_HOST_CACHE): the files installed by a host build
+# of tools/ or toolchain/ are stored under a key made from the package
+# directory, the source, the expanded build recipes, the host compilers and
+# the keys of the builds it depends on (passed in HOST_CACHE_DEPENDS by
+# subdir.mk), and are unpacked from there instead of building again.
+# Files written to the install roots are collected from the start of the
+# install step, or for toolchain/ from the start of the prepare step, as
+# those builds write to the toolchain directory early on. While the cache is
+# enabled, all host builds hold a lock during that time and record the files
+# they installed in HOST_CACHE_FILES, so that no other build can add to the
+# collected files and files the install left untouched are not missed.
+# Builds installed before without such a list are not stored.
+HOST_CACHE_DIR ?= $(if $(call qstrip,$(CONFIG_HOST_CACHE_DIR)),$(call qstrip,$(CONFIG_HOST_CACHE_DIR)),$(TOPDIR)/.host-cache)
+HOST_CACHE_SCOPE ?= $(if $(filter toolchain/%,$(BUILD_SUBDIR)),build,install)
+HOST_CACHE_ROOTS ?= $(HOST_BUILD_PREFIX) $(filter-out $(HOST_BUILD_PREFIX),$(STAGING_DIR_HOST))
+HOST_CACHE_KEYFILE = $(HOST_BUILD_PREFIX)/stamp/.host-cache_$(subst /,_,$(BUILD_SUBDIR))
+HOST_CACHE_FILES = $(HOST_BUILD_PREFIX)/stamp/.host-cache-files_$(subst /,_,$(BUILD_SUBDIR))
+HOST_CACHE_LOCK = $(TMP_DIR)/.host-cache.lock
+HOST_CACHE_MARKER = $(HOST_BUILD_DIR)/.host-cache
+# the make process building the package, which holds the lock. Taken once
+# here, as the parent of a recipe line can be a shell or wrapper that is
+# gone by the next line.
+HOST_CACHE_OWNER := $(if $(CONFIG_HOST_CACHE),$(shell echo $$PPID))
+
+HostCache/DepFile=$(firstword $(wildcard $(foreach dir,$(HOST_BUILD_PREFIX) $(STAGING_DIR_HOST),$(dir)/stamp/.host-cache_$(subst /,_,$(1)))) missing)
+
+HOST_CACHE_DEPFILES = \
+	$(foreach dep,$(HOST_CACHE_DEPENDS),$(call HostCache/DepFile,$(dep))) \
+	$(if $(filter toolchain/%,$(BUILD_SUBDIR)),$(wildcard $(STAGING_DIR_HOST)/stamp/.host-cache_tools_*))
+
+HostCache/Recipes=$(filter-out -j% --jobserver%,$(subst $(TOPDIR),,$(subst $(DL_DIR),,$(Host/Prepare) $(Host/Configure) $(Host/Compile) $(call Host/Install,$(HOST_BUILD_PREFIX)))))
+
+# prints the key and a hash of the locations, which is used for entries
+# that cannot be relocated
+define HostCache/Key
+$(shell ( \
+	$(call find_md5_reproducible,${CURDIR} $(PKG_FILE_DEPENDS),); \
+	cat $(HOST_CACHE_DEPFILES) /dev/null; \
+	echo '$(subst ','\'',$(HOST_OS) $(HOST_ARCH) $(PKG_NAME) $(PKG_VERSION) $(PKG_HASH) $(HOST_CACHE_SCOPE) $(words $(HOST_CACHE_ROOTS)))'; \
+	echo '$(subst ','\'',$(HostCache/Recipes))'; \
+	$(HOSTCC_NOCACHE) -dumpmachine; \
+	$(HOSTCC_NOCACHE) --version | head -n1; \
+	$(HOSTCXX_NOCACHE) --version | head -n1; \
+	ldd --version 2>&1 | head -n1 \
+) | $(MKHASH) md5; echo '$(TOPDIR) $(HOST_CACHE_ROOTS)' | $(MKHASH) md5)
+endef
+
+# only used for the compile step started by subdir.mk, and only when all
+# dependencies have a key and the files of a previous install are known
+define HostCache/Setup
+  $(if $(and $(CONFIG_HOST_CACHE),$(filter command line,$(origin HOST_CACHE_DEPENDS))),
+    $(if $(HOST_QUILT)$(DUMP)$(filter missing,$(HOST_CACHE_DEPFILES))$(if $(wildcard $(HOST_CACHE_FILES)),,$(wildcard $(HOST_STAMP_INSTALLED))),,
+      $(eval HOST_CACHE_KEY:=$(HostCache/Key))
+      $(eval HOST_CACHE_HIT:=$(wildcard $(HOST_CACHE_DIR)/$(word 1,$(HOST_CACHE_KEY)) $(HOST_CACHE_DIR)/$(word 1,$(HOST_CACHE_KEY))-$(word 2,$(HOST_CACHE_KEY))))
+    )
+  )
+endef
+
+define HostCache/Begin
+	$(if $(and $(CONFIG_HOST_CACHE),$(filter $(1),$(HOST_CACHE_SCOPE))), \
+		$(SCRIPT_DIR)/host-cache.sh lock $(HOST_CACHE_LOCK) $(HOST_CACHE_OWNER) && \
+		touch $(HOST_CACHE_MARKER) \
+	)
+endef
+
+define HostCache/Store
+	$(if $(CONFIG_HOST_CACHE), \
+		$(SCRIPT_DIR)/host-cache.sh store $(HOST_CACHE_LOCK) $(HOST_CACHE_OWNER) $(HOST_CACHE_DIR) \
+			$(or $(HOST_CACHE_KEY),- -) $(HOST_CACHE_MARKER) $(HOST_CACHE_FILES) \
+			$(TOPDIR) $(HOST_CACHE_ROOTS) \
+	)
+endef
+
+define HostCache/Restore
+	$(SCRIPT_DIR)/host-cache.sh restore $(HOST_CACHE_LOCK) $(HOST_CACHE_DIR) \
+		$(HOST_CACHE_KEY) $(HOST_CACHE_FILES) $(TOPDIR) $(HOST_CACHE_ROOTS)
+endef
+
 .NOTPARALLEL:
 
 ifndef DUMP
@@ -145,15 +223,18 @@ ifndef DUMP
   $(if $(HOST_QUILT),$(Host/Quilt))
   $(if $(DUMP),,$(call HostHost/Autoclean))
 
+  $(call ProfileStep,$(HOST_STAMP_PREPARED),host-prepare)
   $(HOST_STAMP_PREPARED):
 	@-rm -rf $(HOST_BUILD_DIR)
 	@mkdir -p $(HOST_BUILD_DIR)
+	$(call HostCache/Begin,build)
 	$(foreach hook,$(Hooks/HostPrepare/Pre),$(call $(hook))$(sep))
 	$(call Host/Prepare)
 	$(foreach hook,$(Hooks/HostPrepare/Post),$(call $(hook))$(sep))
 	touch $$@
 
   $(call Host/Exports,$(HOST_STAMP_CONFIGURED))
+  $(call ProfileStep,$(HOST_STAMP_CONFIGURED),host-configure)
   $(HOST_STAMP_CONFIGURED): $(HOST_STAMP_PREPARED)
 	$(foreach hook,$(Hooks/HostConfigure/Pre),$(call $(hook))$(sep))
 	$(call Host/Configure)
@@ -161,6 +242,7 @@ ifndef DUMP
 	touch $$@
 
   $(call Host/Exports,$(HOST_STAMP_BUILT))
+  $(call ProfileStep,$(HOST_STAMP_BUILT),host-compile)
   $(HOST_STAMP_BUILT): $(HOST_STAMP_CONFIGURED)
 		$(foreach hook,$(Hooks/HostCompile/Pre),$(call $(hook))$(sep))
 		$(call Host/Compile)
@@ -168,12 +250,21 @@ ifndef DUMP
 		touch $$@
 
   $(call Host/Exports,$(HOST_STAMP_INSTALLED))
-  $(HOST_STAMP_INSTALLED): $(HOST_STAMP_BUILT) $(if $(FORCE_HOST_INSTALL),FORCE)
+  $(call ProfileStep,$(HOST_STAMP_INSTALLED),host-install)
+  $(HOST_STAMP_INSTALLED): $(if $(HOST_CACHE_HIT),$(if $(filter-out $(word 1,$(HOST_CACHE_KEY)),$(shell cat $(HOST_CACHE_KEYFILE) 2>/dev/null)),FORCE),$(HOST_STAMP_BUILT)) $(if $(FORCE_HOST_INSTALL),FORCE)
+    ifneq ($(HOST_CACHE_HIT),)
+		$(call HostCache/Restore)
+		mkdir -p $$(shell dirname $$@)
+    else
+		$(call HostCache/Begin,install)
 		$(call Host/Install,$(HOST_BUILD_PREFIX))
 		$(foreach hook,$(Hooks/HostInstall/Post),$(call $(hook))$(sep))
+		$(call HostCache/Store)
 		mkdir -p $$(shell dirname $$@)
 		touch $(HOST_STAMP_BUILT)
+    endif
 		touch $$@ $(HOST_STAMP_PROGRAMS)
+		$(if $(HOST_CACHE_KEY),echo $(word 1,$(HOST_CACHE_KEY)) > $(HOST_CACHE_KEYFILE))
 
   $(call DefaultTargets,$(patsubst %,host-%,$(DEFAULT_SUBDIR_TARGETS)))
   ifndef STAMP_BUILT
@@ -188,7 +279,7 @@ ifndef DUMP
 
   $(_host_target)host-prepare: $(HOST_STAMP_PREPARED)
   $(_host_target)host-configure: $(HOST_STAMP_CONFIGURED)
-  $(_host_target)host-compile: $(HOST_STAMP_BUILT) $(HOST_STAMP_INSTALLED) $(HOST_STAMP_PROGRAMS)
+  $(_host_target)host-compile: $(if $(HOST_CACHE_HIT),,$(HOST_STAMP_BUILT)) $(HOST_STAMP_INSTALLED) $(HOST_STAMP_PROGRAMS)
   host-install: host-compile
 
   host-clean-build: FORCE
@@ -197,17 +288,20 @@ ifndef DUMP
 
   host-clean: host-clean-build
 	$(call Host/Clean)
-	rm -rf $(HOST_STAMP_INSTALLED) $(HOST_STAMP_PROGRAMS)
+	rm -rf $(HOST_STAMP_INSTALLED) $(HOST_STAMP_PROGRAMS) $(HOST_CACHE_KEYFILE)
 
     ifneq ($(CONFIG_AUTOREMOVE),)
+    ifeq ($(HOST_CACHE_HIT),)
       host-compile:
 		$(FIND) $(HOST_BUILD_DIR) -mindepth 1 -maxdepth 1 -not '(' -type f -and -name '.*' -and -size 0 ')' -print0 | \
 			$(XARGS) -0 rm -rf
     endif
+    endif
   endef
 endif
 
 define HostBuild
+  $(HostCache/Setup)
   $(HostBuild/Core)
   $(if $(if $(PKG_HOST_ONLY),,$(if $(and $(filter host-%,$(MAKECMDGOALS)),$(PKG_SKIP_DOWNLOAD)),,$(STAMP_PREPARED))),,
 	$(if $(and $(CONFIG_AUTOREMOVE), $(wildcard $(HOST_STAMP_INSTALLED), $(wildcard $(HOST_STAMP_BUILT)))),,
@@ -319,22 +319,66 @@ opkg_target = \
 	$(call opkg,$(mkfs_cur_target_dir)) \
 		-f $(mkfs_cur_target_dir).conf
 
-target-dir-%: FORCE
-	rm -rf $(mkfs_cur_target_dir) $(mkfs_cur_target_dir).opkg
-	$(CP) $(TARGET_DIR_ORIG) $(mkfs_cur_target_dir)
-	-mv $(mkfs_cur_target_dir)/etc/opkg $(mkfs_cur_target_dir).opkg
-	echo 'src default file://$(PACKAGE_DIR_ALL)' > $(mkfs_cur_target_dir).conf
+# Package sets that only add to the default selection are layered on top of
+# the already prepared default rootfs, so that only the added packages are
+# installed and post-processed. Removals, stripped opkg metadata and added
+# packages creating users (which would reorder /etc/passwd), shipping their
+# own postinst, uci-defaults or a rootfs overlay (which the postinst scripts
+# of the default packages could depend on) fall back to a full assembly
+# from $(TARGET_DIR_ORIG).
+mkfs_layered = $(if $(IB)$(CONFIG_CLEAN_IPKG)$(mkfs_packages_remove),,$(call opkg_package_files,$(mkfs_packages_add)))
+
+define target_dir_layered
+	( set -e; \
+		$(CP) --reflink=auto $(TARGET_DIR) $(mkfs_cur_target_dir); \
+		ls $(mkfs_cur_target_dir)/usr/lib/opkg/info > $(mkfs_cur_target_dir).base; \
+		if [ -d $(mkfs_cur_target_dir)/etc/opkg ]; then \
+			mv $(mkfs_cur_target_dir)/etc/opkg $(mkfs_cur_target_dir).opkg; \
+		fi; \
+		echo 'src default file://$(PACKAGE_DIR_ALL)' > $(mkfs_cur_target_dir).conf; \
+		$(opkg_target) update; \
+		$(opkg_target) install $(mkfs_layered); \
+		if [ -d $(mkfs_cur_target_dir).opkg ]; then \
+			$(CP) -T $(mkfs_cur_target_dir).opkg/ $(mkfs_cur_target_dir)/etc/opkg/; \
+		fi; \
+		cd $(mkfs_cur_target_dir)/usr/lib/opkg/info; \
+		for pkg in $$(ls | grep -vxF -f $(mkfs_cur_target_dir).base | sed -n 's/\.control$$//p'); do \
+			if grep -q '^Require-User:' $$pkg.control; then exit 1; fi; \
+			if [ -f $$pkg.postinst-pkg ]; then exit 1; fi; \
+			if grep -q '^/etc/uci-defaults/\|^/rootfs-overlay/' $$pkg.list; then exit 1; fi; \
+			grep '^/etc/init.d/' $$pkg.list || true; \
+		done > $(mkfs_cur_target_dir).initd; \
+	) || { \
+		echo "Cannot layer $(mkfs_cur_target_dir) on the default rootfs, assembling it from scratch"; \
+		rm -rf $(mkfs_cur_target_dir) $(mkfs_cur_target_dir).initd; \
+	}; \
+	rm -rf $(mkfs_cur_target_dir).base $(mkfs_cur_target_dir).opkg $(mkfs_cur_target_dir).conf
+endef
+
+define target_dir_full
+	$(CP) --reflink=auto $(TARGET_DIR_ORIG) $(mkfs_cur_target_dir) && \
+	{ mv $(mkfs_cur_target_dir)/etc/opkg $(mkfs_cur_target_dir).opkg || true; } && \
+	echo 'src default file://$(PACKAGE_DIR_ALL)' > $(mkfs_cur_target_dir).conf && \
 	$(if $(mkfs_packages_remove), \
-		-$(call opkg,$(mkfs_cur_target_dir)) remove \
-			$(mkfs_packages_remove))
+		{ $(call opkg,$(mkfs_cur_target_dir)) remove \
+			$(mkfs_packages_remove) || true; } && ) \
 	$(if $(call opkg_package_files,$(mkfs_packages_add)), \
 		$(opkg_target) update && \
 		$(opkg_target) install \
-			$(call opkg_package_files,$(mkfs_packages_add)))
-	-$(CP) -T $(mkfs_cur_target_dir).opkg/ $(mkfs_cur_target_dir)/etc/opkg/
+			$(call opkg_package_files,$(mkfs_packages_add)) && ) \
+	{ $(CP) -T $(mkfs_cur_target_dir).opkg/ $(mkfs_cur_target_dir)/etc/opkg/ || true; } && \
 	rm -rf $(mkfs_cur_target_dir).opkg $(mkfs_cur_target_dir).conf
-	$(call prepare_rootfs,$(mkfs_cur_target_dir),$(TOPDIR)/files)
+endef
+
+$(eval $(call ProfileStep,target-dir-%,target-dir/$$*))
+target-dir-%: FORCE
+	rm -rf $(mkfs_cur_target_dir) $(mkfs_cur_target_dir).opkg $(mkfs_cur_target_dir).initd
+	$(if $(mkfs_layered),$(target_dir_layered))
+	[ -d $(mkfs_cur_target_dir) ] || { $(target_dir_full); }
+	$(call prepare_rootfs,$(mkfs_cur_target_dir),$(TOPDIR)/files,,$(mkfs_cur_target_dir).initd)
+	rm -f $(mkfs_cur_target_dir).initd
 
+$(eval $(call ProfileStep,$(KDIR)/root.%,rootfs/$$(@F)))
 $(KDIR)/root.%: kernel_prepare
 	$(call Image/mkfs/$(word 1,$(target_params)),$(target_params))
 
@@ -504,6 +548,7 @@ define Device/Build/initramfs
   $(BIN_DIR)/$$(KERNEL_INITRAMFS_IMAGE): $(KDIR)/tmp/$$(KERNEL_INITRAMFS_IMAGE)
 	cp $$^ $$@
 
+  $(call ProfileStep,$(KDIR)/tmp/$$(KERNEL_INITRAMFS_IMAGE),kernel/$$(@F))
   $(KDIR)/tmp/$$(KERNEL_INITRAMFS_IMAGE): $(KDIR)/$$(KERNEL_INITRAMFS_NAME) $(CURDIR)/Makefile $$(KERNEL_DEPENDS) image_prepare
 	@rm -f $$@
 	$$(call concat_cmd,$$(KERNEL_INITRAMFS))
@@ -604,6 +649,7 @@ define Device/Build/kernel
     ifdef CONFIG_IB
       install: $$(KDIR_KERNEL_IMAGE)
     endif
+    $(call ProfileStep,$$(KDIR_KERNEL_IMAGE),kernel/$$(@F))
     $$(KDIR_KERNEL_IMAGE): $(KDIR)/$$(KERNEL_NAME) $(CURDIR)/Makefile $$(KERNEL_DEPENDS) image_prepare
 	@rm -f $$@
 	$$(call concat_cmd,$$(KERNEL))
@@ -628,6 +674,7 @@ define Device/Build/image
   ifndef IB
     $$(ROOTFS/$(1)/$(3)): $(if $(TARGET_PER_DEVICE_ROOTFS),target-dir-$$(ROOTFS_ID/$(3)))
   endif
+  $(call ProfileStep,$(KDIR)/tmp/$(call DEVICE_IMG_NAME,$(1),$(2)),image/$$(@F))
   $(KDIR)/tmp/$(call DEVICE_IMG_NAME,$(1),$(2)): $$(KDIR_KERNEL_IMAGE) $$(ROOTFS/$(1)/$(3))
 	@rm -f $$@
 	[ -f $$(word 1,$$^) -a -f $$(word 2,$$^) ]
@@ -684,6 +731,7 @@ define Device/Build/artifact
 	  $(BUILD_DIR)/json_info_files/$(DEVICE_IMG_PREFIX)-$(1).json, \
 	  $(BIN_DIR)/$(DEVICE_IMG_PREFIX)-$(1))
   $(eval $(call Device/Export,$(KDIR)/tmp/$(DEVICE_IMG_PREFIX)-$(1)))
+  $(call ProfileStep,$(KDIR)/tmp/$(DEVICE_IMG_PREFIX)-$(1),image/$$(@F))
   $(KDIR)/tmp/$(DEVICE_IMG_PREFIX)-$(1): $$(KDIR_KERNEL_IMAGE) $(2)-images
 	@rm -f $$@
 	$$(call concat_cmd,$(ARTIFACT/$(1)))
@@ -834,6 +882,9 @@ define BuildImage
 		mkdir -p $(BIN_DIR) $(KDIR)/tmp
   endif
 
+  $(call ProfileStep,image_prepare,image-prepare)
+  $(call ProfileStep,kernel_prepare,kernel)
+  $(call ProfileStep,install-images,image)
   kernel_prepare: image_prepare
 	$(call Image/Build/targz)
 	$(call Image/Build/cpiogz)
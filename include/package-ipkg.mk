@@ -147,6 +147,7 @@ ifeq ($(DUMP),)
     $(eval $(call BuildIPKGVariable,$(1),prerm,-pkg,1))
     $(eval $(call BuildIPKGVariable,$(1),postrm,,1))
 
+    $(call ProfileStep,$(PKG_BUILD_DIR)/.pkgdir/$(1).installed,pkgdir/$(1))
     $(PKG_BUILD_DIR)/.pkgdir/$(1).installed : export PATH=$$(TARGET_PATH_PKG)
     $(PKG_BUILD_DIR)/.pkgdir/$(1).installed: $(STAMP_BUILT)
 	rm -rf $$@ $(PKG_BUILD_DIR)/.pkgdir/$(1)
@@ -194,6 +195,7 @@ $$(call addfield,Depends,$$(Package/$(1)/DEPENDS)
 Installed-Size: 0
 $(_endef)
 
+    $(call ProfileStep,$$(IPKG_$(1)),ipkg/$(1))
     $$(IPKG_$(1)) : export CONTROL=$$(Package/$(1)/CONTROL)
     $$(IPKG_$(1)) : export DESCRIPTION=$$(Package/$(1)/description)
     $$(IPKG_$(1)) : export PATH=$$(TARGET_PATH_PKG)
@@ -217,7 +219,7 @@ $(_endef)
 	$(if $(PROVIDES),@for pkg in $(filter-out $(1),$(PROVIDES)); do cp $(PKG_INFO_DIR)/$(1).provides $(PKG_INFO_DIR)/$$$$pkg.provides; done)
 	$(CheckDependencies)
 
-	$(RSTRIP) $$(IDIR_$(1))
+	+export RSTRIP_JOBSERVER=1; $(RSTRIP) $$(IDIR_$(1))
 
     ifneq ($$(CONFIG_IPK_FILES_CHECKSUMS),)
 	(cd $$(IDIR_$(1)); \
@@ -264,6 +266,7 @@ $(_endef)
     endif
 
 	$(INSTALL_DIR) $$(PDIR_$(1))
+	$(if $(CONFIG_IPKG_BUILD_NATIVE),IPKG_PACK=$(STAGING_DIR_HOST)/bin/ipkg-pack) \
 	$(FAKEROOT) $(STAGING_DIR_HOST)/bin/bash $(SCRIPT_DIR)/ipkg-build -m "$(FILE_MODES)" $$(IDIR_$(1)) $$(PDIR_$(1))
 	@[ -f $$(IPKG_$(1)) ]
 
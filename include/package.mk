@@ -218,6 +218,7 @@ define Build/CoreTargets
 		$(call $(hook))$(sep)
 	)
 
+  $(call ProfileStep,$(STAMP_PREPARED),prepare)
   $(STAMP_PREPARED) : export PATH=$$(TARGET_PATH_PKG)
   $(STAMP_PREPARED): $(STAMP_PREPARED_DEPENDS)
 	@-rm -rf $(PKG_BUILD_DIR)
@@ -229,6 +230,7 @@ define Build/CoreTargets
 	touch $$@
 
   $(call Build/Exports,$(STAMP_CONFIGURED))
+  $(call ProfileStep,$(STAMP_CONFIGURED),configure)
   $(STAMP_CONFIGURED): $(STAMP_PREPARED) $(STAMP_CONFIGURED_DEPENDS)
 	rm -f $(STAMP_CONFIGURED_WILDCARD)
 	$(CleanStaging)
@@ -238,6 +240,7 @@ define Build/CoreTargets
 	touch $$@
 
   $(call Build/Exports,$(STAMP_BUILT))
+  $(call ProfileStep,$(STAMP_BUILT),compile)
   $(STAMP_BUILT): $(STAMP_CONFIGURED) $(STAMP_BUILT_DEPENDS)
 	rm -f $$@
 	touch $$@_check
@@ -248,6 +251,7 @@ define Build/CoreTargets
 	$(foreach hook,$(Hooks/Install/Post),$(call $(hook))$(sep))
 	touch $$@
 
+  $(call ProfileStep,$(STAMP_INSTALLED),install)
   $(STAMP_INSTALLED) : export PATH=$$(TARGET_PATH_PKG)
   $(STAMP_INSTALLED): $(STAMP_BUILT)
 	rm -rf $(TMP_DIR)/stage-$(PKG_DIR_NAME)
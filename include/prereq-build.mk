@@ -7,6 +7,8 @@ include $(INCLUDE_DIR)/prereq.mk
 
 SHELL:=sh
 PKG_NAME:=Build dependency
+PREREQ_CACHE:=$(STAGING_DIR_HOST)/.prereq-cache
+PREREQ_PARALLEL:=1
 
 $(eval $(call TestHostCommand,true, \
 	Please install GNU 'coreutils', \
@@ -41,7 +43,7 @@ $(eval $(call TestHostCommand,working-gcc, \
 	Please reinstall the GNU C Compiler (6 or later) - \
 	it appears to be broken, \
 	echo 'int main(int argc, char **argv) { return 0; }' | \
-		gcc -x c -o $(TMP_DIR)/a.out -))
+		gcc -x c -o $(TMP_DIR)/a.out-gcc -))
 
 $(eval $(call SetupHostCommand,g++, \
 	Please install the GNU C++ Compiler (g++) 6 or later, \
@@ -53,8 +55,8 @@ $(eval $(call TestHostCommand,working-g++, \
 	Please reinstall the GNU C++ Compiler (6 or later) - \
 	it appears to be broken, \
 	echo 'int main(int argc, char **argv) { return 0; }' | \
-		g++ -x c++ -o $(TMP_DIR)/a.out - -lstdc++ && \
-		$(TMP_DIR)/a.out))
+		g++ -x c++ -o $(TMP_DIR)/a.out-g++ - -lstdc++ && \
+		$(TMP_DIR)/a.out-g++))
 
 $(eval $(call RequireCHeader,ncurses.h, \
 	Please install ncurses. (Missing libncurses.so or ncurses.h), \
@@ -86,6 +88,10 @@ $(eval $(call TestHostCommand,perl-file-copy, \
 	Please install the Perl File::Copy module, \
 	perl -MFile::Copy -e 1))
 
+$(eval $(call TestHostCommand,perl-digest-sha, \
+	Please install the Perl Digest::SHA module, \
+	perl -MDigest::SHA -e 1))
+
 $(eval $(call TestHostCommand,perl-file-compare, \
 	Please install the Perl File::Compare module, \
 	perl -MFile::Compare -e 1))
@@ -203,6 +209,8 @@ $(eval $(call TestHostCommand,python3-stdlib, \
 	Please install the Python3 stdlib module, \
 	$(STAGING_DIR_HOST)/bin/python3 -c 'import ntpath'))
 
+prereq-python3-distutils prereq-python3-stdlib: prereq-python3
+
 $(eval $(call SetupHostCommand,file,Please install the 'file' package, \
 	file --version 2>&1 | grep file))
 
@@ -227,13 +235,15 @@ endif
 
 $(STAGING_DIR_HOST)/bin/mkhash: $(SCRIPT_DIR)/mkhash.c
 	mkdir -p $(dir $@)
-	$(CC) -O2 -I$(TOPDIR)/tools/include -o $@ $<
+	$(CC) -O2 -I$(TOPDIR)/tools/include -o $@ $< -lpthread
 
 $(STAGING_DIR_HOST)/bin/xxd: $(SCRIPT_DIR)/xxdi.pl
+	mkdir -p $(dir $@)
 	$(LN) $< $@
 
 prereq: $(STAGING_DIR_HOST)/bin/mkhash $(STAGING_DIR_HOST)/bin/xxd
 
 # Install ldconfig stub
 $(eval $(call TestHostCommand,ldconfig-stub,Failed to install stub, \
+	mkdir -p $(STAGING_DIR_HOST)/bin && \
 	$(LN) $(firstword $(wildcard /bin/true /usr/bin/true)) $(STAGING_DIR_HOST)/bin/ldconfig))
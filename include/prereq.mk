@@ -19,6 +19,18 @@ endif
 
 PREREQ_PREV=
 
+# If PREREQ_CACHE is set to a directory, the key printed by prereq-key.sh
+# (the check definition and the host binaries it refers to) of every
+# successful check is kept there, and the check is skipped as long as the
+# key does not change. If PREREQ_PARALLEL is set, the checks are not chained
+# and may run in parallel; dependencies between them have to be added
+# explicitly then.
+define PrereqKey
+$$$$(PATH="$(ORIG_PATH)" $(SCRIPT_DIR)/prereq-key.sh $(call QuoteHostCommand,$(Require/$(1))) $(TMP_DIR))
+endef
+
+PrereqStamp=$(PREREQ_CACHE)/$(subst /,_,$(1))
+
 # 1: display name
 # 2: error message
 define Require
@@ -26,23 +38,32 @@ define Require
   ifeq ($$(CHECK_$(1)),)
     prereq: prereq-$(1)
 
-    prereq-$(1): $(if $(PREREQ_PREV),prereq-$(PREREQ_PREV)) FORCE
-		printf "Checking '$(1)'... "
+    prereq-$(1): $(if $(PREREQ_PARALLEL),,$(if $(PREREQ_PREV),prereq-$(PREREQ_PREV))) FORCE
+		$(if $(PREREQ_CACHE),[ "$(call PrereqKey,$(1))" = "$$$$(cat "$(call PrereqStamp,$(1))" 2>/dev/null)" ] && { \
+			echo "Checking '$(1)'... ok."; \
+			exit 0; \
+		}; \
+		rm -f "$(call PrereqStamp,$(1))";) \
 		if $(NO_TRACE_MAKE) -f $(firstword $(MAKEFILE_LIST)) check-$(1) PATH="$(ORIG_PATH)" >/dev/null 2>/dev/null; then \
-			echo 'ok.'; \
+			result='ok.'; \
 		elif $(NO_TRACE_MAKE) -f $(firstword $(MAKEFILE_LIST)) check-$(1) PATH="$(ORIG_PATH)" >/dev/null 2>/dev/null; then \
-			echo 'updated.'; \
+			result='updated.'; \
 		else \
-			echo 'failed.'; \
+			result='failed.'; \
 			echo "$(PKG_NAME): $(strip $(2))" >> $(TMP_DIR)/.prereq-error; \
-		fi
+		fi; \
+		echo "Checking '$(1)'... $$$$result"; \
+		$(if $(PREREQ_CACHE),[ "$$$$result" = 'failed.' ] || { \
+			mkdir -p "$(PREREQ_CACHE)"; \
+			echo "$(call PrereqKey,$(1))" > "$(call PrereqStamp,$(1))"; \
+		})
 
     check-$(1): FORCE
 	  $(call Require/$(1))
     CHECK_$(1):=1
 
     .SILENT: prereq-$(1) check-$(1)
-    .NOTPARALLEL:
+    $(if $(PREREQ_PARALLEL),,.NOTPARALLEL:)
   endif
 
   PREREQ_PREV=$(1)
@@ -71,7 +92,7 @@ endef
 # 4: optional link library test (example -lncurses)
 define RequireCHeader
   define Require/$(1)
-    echo 'int main(int argc, char **argv) { $(3); return 0; }' | gcc -include $(1) -x c -o $(TMP_DIR)/a.out - $(4)
+    echo 'int main(int argc, char **argv) { $(3); return 0; }' | gcc -include $(1) -x c -o $(TMP_DIR)/a.out-$(subst /,_,$(1)) - $(4)
   endef
 
   $$(eval $$(call Require,$(1),$(2)))
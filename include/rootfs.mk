@@ -1,33 +1,34 @@
 ifdef CONFIG_USE_MKLIBS
+  # the scratch files are kept next to the rootfs, so that the rootfs
+  # variants of the image stage can be processed concurrently
   define mklibs
-	rm -rf $(TMP_DIR)/mklibs-progs $(TMP_DIR)/mklibs-out
-	# first find all programs and add them to the mklibs list
-	find $(STAGING_DIR_ROOT) -type f -perm /100 -exec \
-		file -r -N -F '' {} + | \
-		awk ' /executable.*dynamically/ { print $$1 }' > $(TMP_DIR)/mklibs-progs
-	# find all loadable objects that are not regular libraries and add them to the list as well
-	find $(STAGING_DIR_ROOT) -type f -name \*.so\* -exec \
-		file -r -N -F '' {} + | \
-		awk ' /shared object/ { print $$1 }' > $(TMP_DIR)/mklibs-libs
-	mkdir -p $(TMP_DIR)/mklibs-out
+	rm -rf $(1).mklibs
+	mkdir -p $(1).mklibs/out
+	# find all dynamically linked programs and all loadable objects in
+	# a single pass and add them to the mklibs list
+	$(STAGING_DIR_HOST)/bin/elfscan \
+		-x $(1).mklibs/progs \
+		-l $(1).mklibs/libs \
+		$(STAGING_DIR_ROOT)
 	$(STAGING_DIR_HOST)/bin/mklibs -D \
-		-d $(TMP_DIR)/mklibs-out \
+		-d $(1).mklibs/out \
 		--sysroot $(STAGING_DIR_ROOT) \
-		`cat $(TMP_DIR)/mklibs-libs | sed 's:/*[^/]\+/*$$::' | uniq | sed 's:^$(STAGING_DIR_ROOT):-L :'` \
+		`cat $(1).mklibs/libs | sed 's:/*[^/]\+/*$$::' | uniq | sed 's:^$(STAGING_DIR_ROOT):-L :'` \
 		--ldlib $(patsubst $(STAGING_DIR_ROOT)/%,/%,$(firstword $(wildcard \
 			$(foreach name,ld-uClibc.so.* ld-linux.so.* ld-*.so ld-musl-*.so.*, \
 			  $(STAGING_DIR_ROOT)/lib/$(name) \
 			)))) \
 		--target $(REAL_GNU_TARGET_NAME) \
-		`cat $(TMP_DIR)/mklibs-progs $(TMP_DIR)/mklibs-libs` 2>&1
-	$(RSTRIP) $(TMP_DIR)/mklibs-out
-	for lib in `ls $(TMP_DIR)/mklibs-out/*.so.* 2>/dev/null`; do \
+		`cat $(1).mklibs/progs $(1).mklibs/libs` 2>&1
+	+export RSTRIP_JOBSERVER=1; $(RSTRIP) $(1).mklibs/out
+	for lib in `ls $(1).mklibs/out/*.so.* 2>/dev/null`; do \
 		LIB="$${lib##*/}"; \
 		DEST="`ls "$(1)/lib/$$LIB" "$(1)/usr/lib/$$LIB" 2>/dev/null`"; \
 		[ -n "$$DEST" ] || continue; \
 		echo "Copying stripped library $$lib to $$DEST"; \
 		cp "$$lib" "$$DEST" || exit 1; \
 	done
+	rm -rf $(1).mklibs
   endef
 endif
 
@@ -60,33 +61,17 @@ ifdef CONFIG_CLEAN_IPKG
   endef
 endif
 
+# prepare_rootfs <dir>,[<files>],[<disabled services>],[<init script list>]
+# If the optional list file exists, only the init scripts named in it are
+# enabled or disabled, the others are assumed to be set up already. See
+# scripts/prepare-rootfs.sh.
 define prepare_rootfs
 	$(if $(2),@if [ -d '$(2)' ]; then \
 		$(call file_copy,$(2)/.,$(1)); \
 	fi)
 	@mkdir -p $(1)/etc/rc.d
 	@mkdir -p $(1)/var/lock
-	@( \
-		cd $(1); \
-		for script in ./usr/lib/opkg/info/*.postinst; do \
-			IPKG_INSTROOT=$(1) $$(command -v bash) $$script; \
-			ret=$$?; \
-			if [ $$ret -ne 0 ]; then \
-				echo "postinst script $$script has failed with exit code $$ret" >&2; \
-				exit 1; \
-			fi; \
-		done; \
-		for script in ./etc/init.d/*; do \
-			grep '#!/bin/sh /etc/rc.common' $$script >/dev/null || continue; \
-			if ! echo " $(3) " | grep -q " $$(basename $$script) "; then \
-				IPKG_INSTROOT=$(1) $$(command -v bash) ./etc/rc.common $$script enable; \
-				echo "Enabling" $$(basename $$script); \
-			else \
-				IPKG_INSTROOT=$(1) $$(command -v bash) ./etc/rc.common $$script disable; \
-				echo "Disabling" $$(basename $$script); \
-			fi; \
-		done || true \
-	)
+	@$(SCRIPT_DIR)/prepare-rootfs.sh $(1) '$(3)' $(4)
 	$(if $(SOURCE_DATE_EPOCH),sed -i "s/Installed-Time: .*/Installed-Time: $(SOURCE_DATE_EPOCH)/" $(1)/usr/lib/opkg/status)
 	@-find $(1) -name CVS -o -name .svn -o -name .git -o -name '.#*' | $(XARGS) rm -rf
 	rm -rf \
@@ -30,7 +30,9 @@ subdir_make_opts = \
 	$(if $(SUBDIR_MAKE_DEBUG),-d) -r -C $(1) \
 		BUILD_SUBDIR="$(1)" \
 		BUILD_VARIANT="$(4)" \
-		ALL_VARIANTS="$(5)"
+		ALL_VARIANTS="$(5)" \
+		$(if $(and $(CONFIG_HOST_CACHE),$(filter compile,$(2)),$(filter tools/% toolchain/%,$(1))), \
+			HOST_CACHE_DEPENDS="$(patsubst %/compile,%,$(filter %/compile,$($(1)/compile)))")
 
 # 1: subdir
 # 2: target
@@ -292,6 +292,9 @@ default_postinst() {
 		rm -f /tmp/luci-indexcache
 	fi
 
+	# prepare_rootfs sets up the init scripts of all packages at once
+	[ -n "$root" ] && [ "$IPKG_DEFER_INIT" = "1" ] && return $ret
+
 	local shell="$(command -v bash)"
 	for i in $(grep -s "^/etc/init.d/" "$root$filelist"); do
 		if [ -n "$root" ]; then
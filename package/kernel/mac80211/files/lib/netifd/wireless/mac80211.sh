@@ -15,6 +15,8 @@ MP_CONFIG_INT="mesh_retry_timeout mesh_confirm_timeout mesh_holding_timeout mesh
 MP_CONFIG_BOOL="mesh_auto_open_plinks mesh_fwding"
 MP_CONFIG_STRING="mesh_power_mode"
 
+MAC80211_PHY_CACHE=/var/run/mac80211
+
 NEWAPLIST=
 OLDAPLIST=
 NEWSPLIST=
@@ -30,7 +32,7 @@ drv_mac80211_init_device_config() {
 	config_add_string distance
 	config_add_int beacon_int chanbw frag rts
 	config_add_int rxantenna txantenna antenna_gain txpower min_tx_power
-	config_add_boolean noscan ht_coex acs_exclude_dfs background_radar
+	config_add_boolean noscan ht_coex acs_exclude_dfs background_radar separate_hostapd
 	config_add_array ht_capab
 	config_add_array channels
 	config_add_array scan_list
@@ -157,6 +159,8 @@ mac80211_hostapd_setup_base() {
 	chan_ofs=0
 	[ "$band" = "6g" ] && chan_ofs=1
 
+	mac80211_phy_caps "$phy"
+
 	ieee80211n=1
 	ht_capab=
 	case "$htmode" in
@@ -205,7 +209,7 @@ mac80211_hostapd_setup_base() {
 			dsss_cck_40:1
 
 		ht_cap_mask=0
-		for cap in $(iw phy "$phy" info | grep 'Capabilities:' | cut -d: -f2); do
+		for cap in $phy_ht_caps; do
 			ht_cap_mask="$(($ht_cap_mask | $cap))"
 		done
 
@@ -318,7 +322,7 @@ mac80211_hostapd_setup_base() {
 		set_default tx_burst 2.0
 		append base_cfg "ieee80211ac=1" "$N"
 		vht_cap=0
-		for cap in $(iw phy "$phy" info | awk -F "[()]" '/VHT Capabilities/ { print $2 }'); do
+		for cap in $phy_vht_caps; do
 			vht_cap="$(($vht_cap | $cap))"
 		done
 
@@ -425,10 +429,8 @@ mac80211_hostapd_setup_base() {
 			he_bss_color:128 \
 			he_bss_color_enabled:1
 
-		he_phy_cap=$(iw phy "$phy" info | sed -n '/HE Iftypes: AP/,$p' | awk -F "[()]" '/HE PHY Capabilities/ { print $2 }' | head -1)
-		he_phy_cap=${he_phy_cap:2}
-		he_mac_cap=$(iw phy "$phy" info | sed -n '/HE Iftypes: AP/,$p' | awk -F "[()]" '/HE MAC Capabilities/ { print $2 }' | head -1)
-		he_mac_cap=${he_mac_cap:2}
+		he_phy_cap=${phy_he_phy_cap:2}
+		he_mac_cap=${phy_he_mac_cap:2}
 
 		append base_cfg "ieee80211ax=1" "$N"
 		[ "$hwmode" = "a" ] && {
@@ -612,6 +614,8 @@ rename_board_phy_by_path() {
 	local new_phy="$(get_board_phy_name "$path")"
 	[ -z "$new_phy" -o "$new_phy" = "$phy" ] && return
 
+	mac80211_phy_cache_flush "$phy"
+	mac80211_phy_cache_flush "$new_phy"
 	iw "$phy" set name "$new_phy" && phy="$new_phy"
 }
 
@@ -630,6 +634,8 @@ rename_board_phy_by_name() (
 
 	[ "$prev_phy" = "$phy" ] && return 0
 
+	mac80211_phy_cache_flush "$prev_phy"
+	mac80211_phy_cache_flush "$phy"
 	iw "$prev_phy" set name "$phy"
 )
 
@@ -1060,6 +1066,82 @@ mac80211_setup_vif() {
 	[ -n "$failed" ] || wireless_add_vif "$name" "$ifname"
 }
 
+# The output of "iw phy info" is only fetched once per phy and boot. The
+# cache is dropped by the ieee80211 hotplug handler, when a phy is renamed
+# and when the regulatory domain changes.
+mac80211_phy_cache_flush() {
+	local phy="$1"
+
+	if [ -n "$phy" ]; then
+		rm -f "$MAC80211_PHY_CACHE/$phy.info" "$MAC80211_PHY_CACHE/$phy.caps"
+	else
+		rm -rf "$MAC80211_PHY_CACHE"
+	fi
+}
+
+mac80211_phy_info() {
+	local phy="$1"
+
+	phy_info="$MAC80211_PHY_CACHE/$phy.info"
+	[ -s "$phy_info" ] && return 0
+
+	mkdir -p "$MAC80211_PHY_CACHE"
+	iw phy "$phy" info > "$phy_info.$$" && mv "$phy_info.$$" "$phy_info" || {
+		rm -f "$phy_info.$$"
+		return 1
+	}
+}
+
+mac80211_phy_caps() {
+	local phy="$1"
+	local file="$MAC80211_PHY_CACHE/$phy.caps"
+
+	phy_ht_caps=
+	phy_vht_caps=
+	phy_he_phy_cap=
+	phy_he_mac_cap=
+
+	[ -s "$file" ] || {
+		mac80211_phy_info "$phy" || return 1
+		awk -F "[()]" '
+/Capabilities:/ {
+	split($0, cap, ":")
+	ht = ht " " cap[2]
+}
+
+/VHT Capabilities/ {
+	vht = vht " " $2
+}
+
+/HE Iftypes: AP/ {
+	he_ap = 1
+}
+
+he_ap && !he_phy_found && /HE PHY Capabilities/ {
+	he_phy = $2
+	he_phy_found = 1
+}
+
+he_ap && !he_mac_found && /HE MAC Capabilities/ {
+	he_mac = $2
+	he_mac_found = 1
+}
+
+END {
+	printf "phy_ht_caps=\"%s\"\n", ht
+	printf "phy_vht_caps=\"%s\"\n", vht
+	printf "phy_he_phy_cap=\"%s\"\n", he_phy
+	printf "phy_he_mac_cap=\"%s\"\n", he_mac
+}
+' "$phy_info" > "$file.$$" && mv "$file.$$" "$file" || {
+			rm -f "$file.$$"
+			return 1
+		}
+	}
+
+	. "$file"
+}
+
 get_freq() {
 	local phy="$1"
 	local channel="$2"
@@ -1072,7 +1154,8 @@ get_freq() {
 		6g) band="4:";;
 	esac
 
-	iw "$phy" info | awk -v band="$band" -v channel="[$channel]" '
+	mac80211_phy_info "$phy" || return
+	awk -v band="$band" -v channel="[$channel]" '
 
 $1 ~ /Band/ {
 	band_match = band == $2
@@ -1082,17 +1165,47 @@ band_match && $3 == "MHz" && $4 == channel {
 	print $2
 	exit
 }
-'
+' "$phy_info"
 }
 
 
 chan_is_dfs() {
 	local phy="$1"
 	local chan="$2"
-	iw "$phy" info | grep -E -m1 "(\* ${chan:-....} MHz${chan:+|\\[$chan\\]})" | grep -q "MHz.*radar detection"
+	mac80211_phy_info "$phy" || return
+	grep -E -m1 "(\* ${chan:-....} MHz${chan:+|\\[$chan\\]})" "$phy_info" | grep -q "MHz.*radar detection"
 	return $!
 }
 
+# With separate_hostapd set, the APs of the radio are run by a hostapd
+# process of their own instead of the shared one started by wpad, so that
+# slow operations on other radios do not delay them.
+mac80211_hostapd_start() {
+	local phy="$1"
+	local pidfile="/var/run/hostapd-$phy.pid"
+
+	/usr/sbin/hostapd -s -U -P "$pidfile" -B "$hostapd_conf_file" || return 1
+	wireless_add_process "$(cat "$pidfile")" "/usr/sbin/hostapd" 1
+}
+
+mac80211_hostapd_stop() {
+	local phy="$1"
+	local pidfile="/var/run/hostapd-$phy.pid"
+	local pid i
+
+	[ -s "$pidfile" ] || return 0
+	read pid < "$pidfile"
+	rm -f "$pidfile"
+	[ -n "$pid" ] && grep -qs hostapd "/proc/$pid/cmdline" || return 0
+
+	kill "$pid"
+	for i in 1 2 3 4 5 6 7 8 9 10; do
+		[ -d "/proc/$pid" ] || return 0
+		sleep 0.2
+	done
+	kill -9 "$pid" 2>/dev/null
+}
+
 mac80211_vap_cleanup() {
 	local service="$1"
 	local vaps="$2"
@@ -1129,7 +1242,7 @@ drv_mac80211_setup() {
 		country chanbw distance \
 		txpower antenna_gain \
 		rxantenna txantenna \
-		frag rts beacon_int:100 htmode
+		frag rts beacon_int:100 htmode separate_hostapd:0
 	json_get_values basic_rate_list basic_rate
 	json_get_values scan_list scan_list
 	json_select ..
@@ -1171,6 +1284,7 @@ drv_mac80211_setup() {
 	[ -n "$country" ] && {
 		iw reg get | grep -q "^country $country:" || {
 			iw reg set "$country"
+			mac80211_phy_cache_flush
 			sleep 1
 		}
 	}
@@ -1225,6 +1339,7 @@ drv_mac80211_setup() {
 	for_each_interface "ap" mac80211_prepare_vif
 	NEW_MD5=$(test -e "${hostapd_conf_file}" && md5sum ${hostapd_conf_file})
 	OLD_MD5=$(uci -q -P /var/state get wireless._${phy}.md5)
+	OLD_SEPARATE=$(uci -q -P /var/state get wireless._${phy}.separate_hostapd)
 	if [ "${NEWAPLIST}" != "${OLDAPLIST}" ]; then
 		mac80211_vap_cleanup hostapd "${OLDAPLIST}"
 	fi
@@ -1235,20 +1350,30 @@ drv_mac80211_setup() {
 		local no_reload=1
 		if [ -n "$(ubus list | grep hostapd.$primary_ap)" ]; then
 			no_reload=0
-			[ "${NEW_MD5}" = "${OLD_MD5}" ] || {
+			# moving the APs to or from a separate process needs a restart
+			if [ "${OLD_SEPARATE:-0}" != "$separate_hostapd" ]; then
+				no_reload=1
+			elif [ "${NEW_MD5}" != "${OLD_MD5}" ]; then
 				ubus call hostapd.$primary_ap reload
 				no_reload=$?
-				if [ "$no_reload" != "0" ]; then
-					mac80211_vap_cleanup hostapd "${OLDAPLIST}"
-					mac80211_vap_cleanup wpa_supplicant "$(uci -q -P /var/state get wireless._${phy}.splist)"
-					mac80211_vap_cleanup none "$(uci -q -P /var/state get wireless._${phy}.umlist)"
-					sleep 2
-					mac80211_iw_interface_add "$phy" "${NEWAPLIST%% *}" __ap
-					for_each_interface "sta adhoc mesh monitor" mac80211_prepare_vif
-				fi
-			}
+			fi
+			if [ "$no_reload" != "0" ]; then
+				mac80211_hostapd_stop "$phy"
+				mac80211_vap_cleanup hostapd "${OLDAPLIST}"
+				mac80211_vap_cleanup wpa_supplicant "$(uci -q -P /var/state get wireless._${phy}.splist)"
+				mac80211_vap_cleanup none "$(uci -q -P /var/state get wireless._${phy}.umlist)"
+				sleep 2
+				mac80211_iw_interface_add "$phy" "${NEWAPLIST%% *}" __ap
+				for_each_interface "sta adhoc mesh monitor" mac80211_prepare_vif
+			fi
 		fi
-		if [ "$no_reload" != "0" ]; then
+		if [ "$no_reload" != "0" ] && [ "$separate_hostapd" -gt 0 ]; then
+			add_ap=1
+			mac80211_hostapd_start "$phy" || {
+				wireless_setup_failed HOSTAPD_START_FAILED
+				return
+			}
+		elif [ "$no_reload" != "0" ]; then
 			add_ap=1
 			ubus wait_for hostapd
 			local hostapd_res="$(ubus call hostapd config_add "{\"iface\":\"$primary_ap\", \"config\":\"${hostapd_conf_file}\"}")"
@@ -1262,6 +1387,7 @@ drv_mac80211_setup() {
 	}
 	uci -q -P /var/state set wireless._${phy}.aplist="${NEWAPLIST}"
 	uci -q -P /var/state set wireless._${phy}.md5="${NEW_MD5}"
+	uci -q -P /var/state set wireless._${phy}.separate_hostapd="${separate_hostapd}"
 
 	[ "${add_ap}" = 1 ] && sleep 1
 	for_each_interface "ap" mac80211_setup_vif
@@ -1314,6 +1440,7 @@ drv_mac80211_teardown() {
 		return 1
 	}
 
+	mac80211_hostapd_stop "$phy"
 	mac80211_interface_cleanup "$phy"
 	uci -q -P /var/state revert wireless._${phy}
 }
@@ -37,11 +37,16 @@ hostapd_append_wep_key() {
 	esac
 }
 
+hostapd_ssid_md5() {
+	[ -n "$ssid_md5" ] || ssid_md5="$(echo "$ssid" | md5sum)"
+}
+
 hostapd_append_wpa_key_mgmt() {
-	local auth_type_l="$(echo $auth_type | tr 'a-z' 'A-Z')"
+	local auth_type_l
 
 	case "$auth_type" in
 		psk|eap)
+			[ "$auth_type" = psk ] && auth_type_l=PSK || auth_type_l=EAP
 			append wpa_key_mgmt "WPA-$auth_type_l"
 			[ "${ieee80211r:-0}" -gt 0 ] && append wpa_key_mgmt "FT-${auth_type_l}"
 			[ "${ieee80211w:-0}" -gt 0 ] && append wpa_key_mgmt "WPA-${auth_type_l}-SHA256"
@@ -548,7 +553,7 @@ hostapd_set_bss_options() {
 
 	wireless_vif_parse_encryption
 
-	local bss_conf bss_md5sum ft_key
+	local bss_conf beacon_conf bss_md5sum ft_key ssid_md5
 	local wep_rekey wpa_group_rekey wpa_pair_rekey wpa_master_rekey wpa_key_mgmt
 
 	json_get_vars \
@@ -613,9 +618,9 @@ hostapd_set_bss_options() {
 	append bss_conf "skip_inactivity_poll=$skip_inactivity_poll" "$N"
 	append bss_conf "preamble=$short_preamble" "$N"
 	append bss_conf "wmm_enabled=$wmm" "$N"
-	append bss_conf "ignore_broadcast_ssid=$hidden" "$N"
+	append beacon_conf "ignore_broadcast_ssid=$hidden" "$N"
 	append bss_conf "uapsd_advertisement_enabled=$uapsd" "$N"
-	append bss_conf "utf8_ssid=$utf8_ssid" "$N"
+	append beacon_conf "utf8_ssid=$utf8_ssid" "$N"
 	append bss_conf "multi_ap=$multi_ap" "$N"
 	[ -n "$vendor_elements" ] && append bss_conf "vendor_elements=$vendor_elements" "$N"
 
@@ -716,7 +721,10 @@ hostapd_set_bss_options() {
 
 			[ "$fils" -gt 0 ] && {
 				set_default erp_domain "$mobility_domain"
-				set_default erp_domain "$(echo "$ssid" | md5sum | head -c 8)"
+				[ -n "$erp_domain" ] || {
+					hostapd_ssid_md5
+					erp_domain="${ssid_md5:0:8}"
+				}
 				set_default fils_realm "$erp_domain"
 
 				append bss_conf "erp_send_reauth_start=1" "$N"
@@ -899,7 +907,10 @@ hostapd_set_bss_options() {
 		if [ "$ieee80211r" -gt "0" ]; then
 			json_get_vars mobility_domain ft_psk_generate_local ft_over_ds reassociation_deadline
 
-			set_default mobility_domain "$(echo "$ssid" | md5sum | head -c 4)"
+			[ -n "$mobility_domain" ] || {
+				hostapd_ssid_md5
+				mobility_domain="${ssid_md5:0:4}"
+			}
 			set_default ft_over_ds 0
 			set_default reassociation_deadline 1000
 
@@ -947,7 +958,10 @@ hostapd_set_bss_options() {
 		fi
 		if [ "$fils" -gt 0 ]; then
 			json_get_vars fils_realm
-			set_default fils_realm "$(echo "$ssid" | md5sum | head -c 8)"
+			[ -n "$fils_realm" ] || {
+				hostapd_ssid_md5
+				fils_realm="${ssid_md5:0:8}"
+			}
 		fi
 
 		append bss_conf "wpa_disable_eapol_key_retries=$wpa_disable_eapol_key_retries" "$N"
@@ -1159,8 +1173,11 @@ hostapd_set_bss_options() {
 		append bss_conf "$val" "$N"
 	done
 
-	bss_md5sum="$(echo $bss_conf | md5sum | cut -d" " -f1)"
+	bss_md5sum="$(echo $bss_conf | md5sum)"
+	bss_md5sum="${bss_md5sum%% *}"
 	append bss_conf "config_id=$bss_md5sum" "$N"
+	# only change the beacon, a reload applies them without restarting the BSS
+	append bss_conf "$beacon_conf" "$N"
 
 	append "$var" "$bss_conf" "$N"
 	return 0
@@ -1490,7 +1507,7 @@ wpa_supplicant_add_network() {
 							phase2proto=""
 						;;
 						"EAP-"*)
-							auth="$(echo $auth | cut -b 5- )"
+							auth="${auth:4}"
 							[ "$eap_type" = "ttls" ] &&
 								phase2proto="autheap="
 							json_get_vars subject_match2
@@ -1527,7 +1544,15 @@ wpa_supplicant_add_network() {
 					append network_data "phase2=\"$phase2proto$auth\"" "$N$T"
 				;;
 			esac
-			append network_data "eap=$(echo $eap_type | tr 'a-z' 'A-Z')" "$N$T"
+			local eap_type_u
+			case "$eap_type" in
+				tls) eap_type_u=TLS;;
+				ttls) eap_type_u=TTLS;;
+				peap) eap_type_u=PEAP;;
+				fast) eap_type_u=FAST;;
+				*) eap_type_u="$(echo $eap_type | tr 'a-z' 'A-Z')";;
+			esac
+			append network_data "eap=$eap_type_u" "$N$T"
 		;;
 	esac
 
@@ -0,0 +1,210 @@
+/*
+ * hostapd / shared memory statistics
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Layout of the station statistics that hostapd publishes in
+ * /dev/shm/hostapd-<ifname> once enabled with the "stats_export" ubus
+ * method, the helpers hostapd writes them with, and a reader for them that
+ * needs no system calls once the file is mapped.
+ *
+ * The file starts with struct hostapd_stats_header, followed by
+ * HOSTAPD_STATS_SLOTS slots of slot_size bytes. Each update is written to
+ * the slot after the one in head, which is then advanced to it. Every slot
+ * is protected by its own sequence counter, which is odd while the slot is
+ * being written. With several slots, a reader only has to retry if it is
+ * slower than HOSTAPD_STATS_SLOTS - 1 updates.
+ */
+#ifndef __HOSTAPD_STATS_H
+#define __HOSTAPD_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HOSTAPD_STATS_PATH	"/dev/shm/hostapd-%s"
+#define HOSTAPD_STATS_MAGIC	0x68737461 /* "hsta" */
+#define HOSTAPD_STATS_VERSION	1
+#define HOSTAPD_STATS_SLOTS	4
+
+struct hostapd_stats_sta {
+	uint8_t addr[6];
+	uint16_t aid;
+	uint32_t flags; /* WLAN_STA_* */
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+	uint64_t rx_packets;
+	uint64_t tx_packets;
+	uint64_t rx_airtime; /* usec */
+	uint64_t tx_airtime; /* usec */
+	uint32_t rx_rate; /* kbit/s */
+	uint32_t tx_rate; /* kbit/s */
+	int32_t signal; /* dBm */
+	uint32_t reserved;
+};
+
+struct hostapd_stats_bss {
+	uint64_t timestamp; /* CLOCK_MONOTONIC, msec */
+	uint32_t freq;
+	uint32_t num_sta; /* stations of the BSS, can be more than n_sta */
+	uint32_t n_sta; /* entries in sta[] */
+	uint32_t reserved;
+};
+
+struct hostapd_stats_slot {
+	uint32_t seq;
+	uint32_t reserved;
+	struct hostapd_stats_bss bss;
+	struct hostapd_stats_sta sta[];
+};
+
+struct hostapd_stats_header {
+	uint32_t magic; /* 0 once hostapd stopped updating the file */
+	uint32_t version;
+	uint32_t max_sta;
+	uint32_t slot_size;
+	uint32_t head; /* slot with the latest update */
+	uint32_t reserved[3];
+};
+
+static inline struct hostapd_stats_slot *
+hostapd_stats_slot(const struct hostapd_stats_header *hdr, unsigned int idx)
+{
+	return (struct hostapd_stats_slot *)
+		((char *) hdr + sizeof(*hdr) + (size_t) idx * hdr->slot_size);
+}
+
+static inline size_t
+hostapd_stats_size(unsigned int max_sta)
+{
+	return sizeof(struct hostapd_stats_header) + HOSTAPD_STATS_SLOTS *
+		(sizeof(struct hostapd_stats_slot) +
+		 (size_t) max_sta * sizeof(struct hostapd_stats_sta));
+}
+
+/*
+ * Write side, there must only be one writer: fill the slot returned by
+ * hostapd_stats_begin(), then publish it with hostapd_stats_commit().
+ */
+static inline struct hostapd_stats_slot *
+hostapd_stats_begin(struct hostapd_stats_header *hdr)
+{
+	struct hostapd_stats_slot *slot;
+
+	slot = hostapd_stats_slot(hdr, (hdr->head + 1) % HOSTAPD_STATS_SLOTS);
+
+	/* seqlock write side: odd while the slot is inconsistent */
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return slot;
+}
+
+static inline void
+hostapd_stats_commit(struct hostapd_stats_header *hdr,
+		     struct hostapd_stats_slot *slot)
+{
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&hdr->head, (hdr->head + 1) % HOSTAPD_STATS_SLOTS,
+			 __ATOMIC_RELEASE);
+}
+
+struct hostapd_stats_map {
+	const struct hostapd_stats_header *hdr;
+	size_t size;
+};
+
+/* Maps the statistics of a BSS. Returns 0 on success, -1 on failure. */
+static inline int
+hostapd_stats_open(struct hostapd_stats_map *map, const char *ifname)
+{
+	const struct hostapd_stats_header *hdr;
+	char path[64];
+	struct stat st;
+	void *data;
+	int fd;
+
+	snprintf(path, sizeof(path), HOSTAPD_STATS_PATH, ifname);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+
+	hdr = data;
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != HOSTAPD_STATS_MAGIC ||
+	    hdr->version != HOSTAPD_STATS_VERSION ||
+	    hostapd_stats_size(hdr->max_sta) > (size_t) st.st_size) {
+		munmap(data, st.st_size);
+		return -1;
+	}
+
+	map->hdr = hdr;
+	map->size = st.st_size;
+	return 0;
+}
+
+static inline void
+hostapd_stats_close(struct hostapd_stats_map *map)
+{
+	if (map->hdr)
+		munmap((void *) map->hdr, map->size);
+	map->hdr = NULL;
+}
+
+/*
+ * Copies the latest update into bss and up to max_sta entries into sta.
+ * Returns the number of stations copied, or -1 if no consistent update
+ * could be read or hostapd stopped updating the file; it then has to be
+ * closed and opened again.
+ */
+static inline int
+hostapd_stats_read(const struct hostapd_stats_map *map,
+		   struct hostapd_stats_bss *bss,
+		   struct hostapd_stats_sta *sta, unsigned int max_sta)
+{
+	const struct hostapd_stats_header *hdr = map->hdr;
+	const struct hostapd_stats_slot *slot;
+	uint32_t seq, n;
+	int retry;
+
+	for (retry = 0; retry < 16; retry++) {
+		if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != HOSTAPD_STATS_MAGIC)
+			return -1;
+
+		slot = hostapd_stats_slot(hdr, __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) %
+					  HOSTAPD_STATS_SLOTS);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		memcpy(bss, &slot->bss, sizeof(*bss));
+		n = bss->n_sta;
+		if (n > hdr->max_sta)
+			n = hdr->max_sta;
+		if (n > max_sta)
+			n = max_sta;
+		memcpy(sta, slot->sta, n * sizeof(*sta));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return n;
+	}
+
+	return -1;
+}
+
+#endif /* __HOSTAPD_STATS_H */
@@ -7,6 +7,12 @@
  */
 
 #include "utils/includes.h"
+#include <net/if.h>
+#ifdef CONFIG_DRIVER_NL80211
+#include <netlink/genl/genl.h>
+#include <netlink/genl/ctrl.h>
+#endif
+
 #include "utils/common.h"
 #include "utils/eloop.h"
 #include "utils/wpabuf.h"
@@ -17,6 +23,8 @@
 #include "wps_hostapd.h"
 #include "sta_info.h"
 #include "ubus.h"
+#include "hostapd_stats.h"
+#include "ieee802_11.h"
 #include "ap_drv_ops.h"
 #include "beacon.h"
 #include "rrm.h"
@@ -24,10 +32,17 @@
 #include "taxonomy.h"
 #include "airtime_policy.h"
 #include "hw_features.h"
+#ifdef CONFIG_DRIVER_NL80211
+#include "drivers/nl80211_copy.h"
+#endif
 
 static struct ubus_context *ctx;
 static struct blob_buf b;
 static int ctx_ref;
+#ifdef CONFIG_DRIVER_NL80211
+static struct nl_sock *nl80211_sock;
+static int nl80211_id;
+#endif
 
 static inline struct hapd_interfaces *get_hapd_interfaces_from_object(struct ubus_object *obj)
 {
@@ -39,9 +54,128 @@ static inline struct hostapd_data *get_hapd_from_object(struct ubus_object *obj)
 	return container_of(obj, struct hostapd_data, ubus.obj);
 }
 
+static int avl_compare_macaddr(const void *k1, const void *k2, void *ptr)
+{
+	return memcmp(k1, k2, ETH_ALEN);
+}
+
+/*
+ * Banned clients are kept in a hash table and expire through a timer wheel
+ * of HOSTAPD_UBUS_BAN_SLOTS slots of HOSTAPD_UBUS_BAN_TICK ms each, driven
+ * by a single eloop timeout per BSS. Adding or removing a ban does not touch
+ * the eloop timeout list, which is kept sorted.
+ */
+#define HOSTAPD_UBUS_BAN_HASH	256
+#define HOSTAPD_UBUS_BAN_SLOTS	256
+#define HOSTAPD_UBUS_BAN_TICK	100
+
 struct ubus_banned_client {
+	struct dl_list hash;
+	struct dl_list wheel;
+	u8 addr[ETH_ALEN];
+	u64 expire; /* msec */
+};
+
+struct hostapd_ubus_bans {
+	struct dl_list hash[HOSTAPD_UBUS_BAN_HASH];
+	struct dl_list wheel[HOSTAPD_UBUS_BAN_SLOTS];
+	u64 tick; /* next wheel tick to process */
+	int n_bans;
+};
+
+/* time in ms to wait for the subscribers to answer a notification */
+#define HOSTAPD_UBUS_RESPONSE_TIMEOUT	100
+/* default time in ms for which an answer is reused for further frames */
+#define HOSTAPD_UBUS_VERDICT_TIMEOUT	1000
+#define HOSTAPD_UBUS_VERDICT_PURGE	10
+/* held answers of clients without requests for this many seconds are forgotten */
+#define HOSTAPD_UBUS_VERDICT_HELD_EXPIRE	60
+#define HOSTAPD_UBUS_MAX_VERDICTS	1024
+#define HOSTAPD_UBUS_MAX_PENDING	64
+/* clients without probe requests for this many seconds are forgotten */
+#define HOSTAPD_UBUS_PROBE_EXPIRE	60
+#define HOSTAPD_UBUS_MAX_PROBE_CLIENTS	1024
+#define HOSTAPD_UBUS_STATS_MAX_STA	1024
+/* minimum stats_export interval in ms, each update polls the driver */
+#define HOSTAPD_UBUS_STATS_MIN_INTERVAL	100
+/* removed stations remembered for the get_clients cursor */
+#define HOSTAPD_UBUS_MAX_REMOVED	256
+
+enum {
+	HOSTAPD_UBUS_VERDICT_NONE,
+	HOSTAPD_UBUS_VERDICT_CACHED,
+	HOSTAPD_UBUS_VERDICT_HELD,
+};
+
+static const char * const event_types[HOSTAPD_UBUS_TYPE_MAX] = {
+	[HOSTAPD_UBUS_PROBE_REQ] = "probe",
+	[HOSTAPD_UBUS_AUTH_REQ] = "auth",
+	[HOSTAPD_UBUS_ASSOC_REQ] = "assoc",
+};
+
+struct ubus_client_verdict {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	struct {
+		struct os_reltime expire;
+		int status;
+		/* kept until the subscribers answer differently, or it expires */
+		bool held;
+	} type[HOSTAPD_UBUS_TYPE_MAX];
+};
+
+/*
+ * Probe requests of a client, summarized in one "probe-summary" notification
+ * per coalescing interval. The capabilities are only included when their
+ * hash differs from the one last sent.
+ */
+struct ubus_probe_client {
 	struct avl_node avl;
 	u8 addr[ETH_ALEN];
+	struct os_reltime last_seen;
+	unsigned int count;
+	int signal_min;
+	int signal_max;
+	int signal;
+	u32 caps_hash;
+	u32 sent_hash;
+	bool has_ht;
+	bool has_vht;
+	struct ieee80211_ht_capabilities ht;
+	struct ieee80211_vht_capabilities vht;
+};
+
+/*
+ * State of a station as last seen by get_clients. gen is the value of the
+ * cursor at which the station was added, removed or last changed.
+ */
+struct ubus_client_state {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u32 hash;
+	u32 gen;
+	bool removed;
+	bool seen;
+};
+
+/*
+ * A notification waiting for the answers of the subscribers. For auth and
+ * assoc requests, the frame is kept and processed again when the answers
+ * are in, so that the eloop does not have to wait for them.
+ */
+struct hostapd_ubus_pending {
+	struct dl_list list;
+	struct ubus_notify_request nreq;
+	struct hostapd_data *hapd;
+	void (*done)(struct hostapd_ubus_pending *p);
+	enum hostapd_ubus_event_type type;
+	u8 addr[ETH_ALEN];
+	bool complete;
+	int resp;
+	int ssi_signal;
+	u8 dialog_token;
+	size_t len;
+	u8 frame[];
 };
 
 static void ubus_receive(int sock, void *eloop_ctx, void *sock_ctx)
@@ -97,6 +231,12 @@ static void hostapd_ubus_ref_dec(void)
 	eloop_unregister_read_sock(ctx->sock.fd);
 	ubus_free(ctx);
 	ctx = NULL;
+
+#ifdef CONFIG_DRIVER_NL80211
+	if (nl80211_sock)
+		nl_socket_free(nl80211_sock);
+	nl80211_sock = NULL;
+#endif
 }
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface)
@@ -115,7 +255,7 @@ static void hostapd_notify_ubus(struct ubus_object *obj, char *bssname, char *ev
 {
 	char *event_type;
 
-	if (!ctx || !obj)
+	if (!ctx || !obj || !obj->id)
 		return;
 
 	if (asprintf(&event_type, "bss.%s", event) < 0)
@@ -159,42 +299,451 @@ static void hostapd_send_shared_event(struct ubus_object *obj, char *bssname, ch
 	hostapd_notify_ubus(obj, bssname, event);
 }
 
-static void
-hostapd_bss_del_ban(void *eloop_data, void *user_ctx)
+static u64
+hostapd_ubus_time_ms(void)
+{
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	return (u64) now.sec * 1000 + now.usec / 1000;
+}
+
+static unsigned int
+hostapd_bss_ban_hash(const u8 *addr)
 {
-	struct ubus_banned_client *ban = eloop_data;
-	struct hostapd_data *hapd = user_ctx;
+	/* the last octets differ the most, also for randomized addresses */
+	return (addr[3] ^ (addr[4] << 3) ^ (addr[5] << 5) ^ addr[0]) %
+	       HOSTAPD_UBUS_BAN_HASH;
+}
+
+static struct ubus_banned_client *
+hostapd_bss_find_ban(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct hostapd_ubus_bans *bans = hapd->ubus.bans;
+	struct ubus_banned_client *ban;
+
+	if (!bans || !bans->n_bans)
+		return NULL;
 
-	avl_delete(&hapd->ubus.banned, &ban->avl);
-	free(ban);
+	dl_list_for_each(ban, &bans->hash[hostapd_bss_ban_hash(addr)],
+			 struct ubus_banned_client, hash)
+		if (!memcmp(ban->addr, addr, ETH_ALEN))
+			return ban;
+
+	return NULL;
+}
+
+/* a ban that expired since the last tick of the wheel no longer applies */
+static bool
+hostapd_bss_is_banned(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct ubus_banned_client *ban;
+
+	ban = hostapd_bss_find_ban(hapd, addr);
+
+	return ban && ban->expire > hostapd_ubus_time_ms();
+}
+
+static void
+hostapd_bss_del_ban(struct hostapd_data *hapd, struct ubus_banned_client *ban)
+{
+	dl_list_del(&ban->hash);
+	dl_list_del(&ban->wheel);
+	hapd->ubus.bans->n_bans--;
+	os_free(ban);
 }
 
 static void
-hostapd_bss_ban_client(struct hostapd_data *hapd, u8 *addr, int time)
+hostapd_bss_ban_tick(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct hostapd_ubus_bans *bans = hapd->ubus.bans;
+	struct ubus_banned_client *ban, *tmp;
+	u64 now = hostapd_ubus_time_ms() / HOSTAPD_UBUS_BAN_TICK;
+	int i;
+
+	/* after a long stall, a single pass over the wheel is enough */
+	for (i = 0; bans->tick <= now && i < HOSTAPD_UBUS_BAN_SLOTS; i++) {
+		dl_list_for_each_safe(ban, tmp,
+				      &bans->wheel[bans->tick % HOSTAPD_UBUS_BAN_SLOTS],
+				      struct ubus_banned_client, wheel)
+			if (ban->expire <= now * HOSTAPD_UBUS_BAN_TICK)
+				hostapd_bss_del_ban(hapd, ban);
+
+		bans->tick++;
+	}
+	if (bans->tick <= now)
+		bans->tick = now + 1;
+
+	if (bans->n_bans)
+		eloop_register_timeout(0, HOSTAPD_UBUS_BAN_TICK * 1000,
+				       hostapd_bss_ban_tick, hapd, NULL);
+}
+
+static int
+hostapd_bss_ban_client(struct hostapd_data *hapd, const u8 *addr, int time)
 {
+	struct hostapd_ubus_bans *bans = hapd->ubus.bans;
 	struct ubus_banned_client *ban;
+	u64 now, tick;
+	int i;
 
 	if (time < 0)
 		time = 0;
 
-	ban = avl_find_element(&hapd->ubus.banned, addr, ban, avl);
-	if (!ban) {
-		if (!time)
-			return;
+	ban = hostapd_bss_find_ban(hapd, addr);
+	if (ban && !time) {
+		hostapd_bss_del_ban(hapd, ban);
+		/* the tick is registered again by the next ban */
+		if (!bans->n_bans)
+			eloop_cancel_timeout(hostapd_bss_ban_tick, hapd, NULL);
+		return 0;
+	}
+
+	if (!time)
+		return 0;
+
+	if (!bans) {
+		bans = os_zalloc(sizeof(*bans));
+		if (!bans)
+			return -1;
+
+		for (i = 0; i < HOSTAPD_UBUS_BAN_HASH; i++)
+			dl_list_init(&bans->hash[i]);
+		for (i = 0; i < HOSTAPD_UBUS_BAN_SLOTS; i++)
+			dl_list_init(&bans->wheel[i]);
+		hapd->ubus.bans = bans;
+	}
 
+	now = hostapd_ubus_time_ms();
+	if (!bans->n_bans) {
+		bans->tick = now / HOSTAPD_UBUS_BAN_TICK;
+		eloop_register_timeout(0, HOSTAPD_UBUS_BAN_TICK * 1000,
+				       hostapd_bss_ban_tick, hapd, NULL);
+	}
+
+	if (!ban) {
 		ban = os_zalloc(sizeof(*ban));
+		if (!ban)
+			return -1;
+
 		memcpy(ban->addr, addr, sizeof(ban->addr));
-		ban->avl.key = ban->addr;
-		avl_insert(&hapd->ubus.banned, &ban->avl);
+		dl_list_add(&bans->hash[hostapd_bss_ban_hash(addr)], &ban->hash);
+		bans->n_bans++;
 	} else {
-		eloop_cancel_timeout(hostapd_bss_del_ban, ban, hapd);
-		if (!time) {
-			hostapd_bss_del_ban(ban, hapd);
+		dl_list_del(&ban->wheel);
+	}
+
+	/* removed by the first tick at or after the expiry */
+	ban->expire = now + time;
+	tick = (ban->expire + HOSTAPD_UBUS_BAN_TICK - 1) / HOSTAPD_UBUS_BAN_TICK;
+	dl_list_add(&bans->wheel[tick % HOSTAPD_UBUS_BAN_SLOTS], &ban->wheel);
+
+	return 0;
+}
+
+static void
+hostapd_bss_free_bans(struct hostapd_data *hapd)
+{
+	struct hostapd_ubus_bans *bans = hapd->ubus.bans;
+	struct ubus_banned_client *ban, *tmp;
+	int i;
+
+	if (!bans)
+		return;
+
+	eloop_cancel_timeout(hostapd_bss_ban_tick, hapd, NULL);
+	for (i = 0; i < HOSTAPD_UBUS_BAN_HASH; i++)
+		dl_list_for_each_safe(ban, tmp, &bans->hash[i],
+				      struct ubus_banned_client, hash)
+			hostapd_bss_del_ban(hapd, ban);
+
+	os_free(bans);
+	hapd->ubus.bans = NULL;
+}
+
+static void
+hostapd_bss_purge_verdicts(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct ubus_client_verdict *v, *tmp;
+	struct os_reltime now;
+	int i;
+
+	os_get_reltime(&now);
+	avl_for_each_element_safe(&hapd->ubus.verdicts, v, avl, tmp) {
+		for (i = 0; i < HOSTAPD_UBUS_TYPE_MAX; i++)
+			if (os_reltime_before(&now, &v->type[i].expire))
+				break;
+
+		if (i < HOSTAPD_UBUS_TYPE_MAX)
+			continue;
+
+		avl_delete(&hapd->ubus.verdicts, &v->avl);
+		hapd->ubus.n_verdicts--;
+		free(v);
+	}
+
+	if (!avl_is_empty(&hapd->ubus.verdicts))
+		eloop_register_timeout(HOSTAPD_UBUS_VERDICT_PURGE, 0,
+				       hostapd_bss_purge_verdicts, hapd, NULL);
+}
+
+/*
+ * A negative timeout keeps the verdict until it is replaced or has not been
+ * used for HOSTAPD_UBUS_VERDICT_HELD_EXPIRE seconds.
+ */
+static void
+hostapd_bss_set_verdict(struct hostapd_data *hapd, const u8 *addr,
+			unsigned int types, int status, int timeout)
+{
+	struct ubus_client_verdict *v;
+	struct os_reltime expire;
+	int i;
+
+	v = avl_find_element(&hapd->ubus.verdicts, addr, v, avl);
+	if (!v) {
+		if (!timeout || hapd->ubus.n_verdicts >= HOSTAPD_UBUS_MAX_VERDICTS)
 			return;
+
+		v = os_zalloc(sizeof(*v));
+		if (!v)
+			return;
+
+		if (avl_is_empty(&hapd->ubus.verdicts))
+			eloop_register_timeout(HOSTAPD_UBUS_VERDICT_PURGE, 0,
+					       hostapd_bss_purge_verdicts, hapd, NULL);
+
+		memcpy(v->addr, addr, sizeof(v->addr));
+		v->avl.key = v->addr;
+		avl_insert(&hapd->ubus.verdicts, &v->avl);
+		hapd->ubus.n_verdicts++;
+	}
+
+	os_get_reltime(&expire);
+	if (timeout < 0) {
+		expire.sec += HOSTAPD_UBUS_VERDICT_HELD_EXPIRE;
+	} else if (timeout > 0) {
+		expire.sec += timeout / 1000;
+		expire.usec += (timeout % 1000) * 1000;
+		if (expire.usec >= 1000000) {
+			expire.sec++;
+			expire.usec -= 1000000;
 		}
 	}
 
-	eloop_register_timeout(0, time * 1000, hostapd_bss_del_ban, ban, hapd);
+	for (i = 0; i < HOSTAPD_UBUS_TYPE_MAX; i++) {
+		if (!(types & BIT(i)))
+			continue;
+
+		v->type[i].expire = expire;
+		v->type[i].status = status;
+		v->type[i].held = timeout < 0;
+	}
+}
+
+static u32
+hostapd_ubus_hash(u32 hash, const void *data, size_t len)
+{
+	const u8 *pos = data;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *pos++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+static void
+hostapd_ubus_add_capabilities(const struct ieee80211_ht_capabilities *ht_capabilities,
+			      const struct ieee80211_vht_capabilities *vht_capabilities)
+{
+	if (ht_capabilities) {
+		void *ht_cap, *ht_cap_mcs_set, *mcs_set;
+
+		ht_cap = blobmsg_open_table(&b, "ht_capabilities");
+		blobmsg_add_u16(&b, "ht_capabilities_info", ht_capabilities->ht_capabilities_info);
+		ht_cap_mcs_set = blobmsg_open_table(&b, "supported_mcs_set");
+		blobmsg_add_u16(&b, "a_mpdu_params", ht_capabilities->a_mpdu_params);
+		blobmsg_add_u16(&b, "ht_extended_capabilities", ht_capabilities->ht_extended_capabilities);
+		blobmsg_add_u32(&b, "tx_bf_capability_info", ht_capabilities->tx_bf_capability_info);
+		blobmsg_add_u16(&b, "asel_capabilities", ht_capabilities->asel_capabilities);
+		mcs_set = blobmsg_open_array(&b, "supported_mcs_set");
+		for (int i = 0; i < 16; i++) {
+			blobmsg_add_u16(&b, NULL, (u16) ht_capabilities->supported_mcs_set[i]);
+		}
+		blobmsg_close_array(&b, mcs_set);
+		blobmsg_close_table(&b, ht_cap_mcs_set);
+		blobmsg_close_table(&b, ht_cap);
+	}
+	if (vht_capabilities) {
+		void *vht_cap, *vht_cap_mcs_set;
+
+		vht_cap = blobmsg_open_table(&b, "vht_capabilities");
+		blobmsg_add_u32(&b, "vht_capabilities_info", vht_capabilities->vht_capabilities_info);
+		vht_cap_mcs_set = blobmsg_open_table(&b, "vht_supported_mcs_set");
+		blobmsg_add_u16(&b, "rx_map", vht_capabilities->vht_supported_mcs_set.rx_map);
+		blobmsg_add_u16(&b, "rx_highest", vht_capabilities->vht_supported_mcs_set.rx_highest);
+		blobmsg_add_u16(&b, "tx_map", vht_capabilities->vht_supported_mcs_set.tx_map);
+		blobmsg_add_u16(&b, "tx_highest", vht_capabilities->vht_supported_mcs_set.tx_highest);
+		blobmsg_close_table(&b, vht_cap_mcs_set);
+		blobmsg_close_table(&b, vht_cap);
+	}
+}
+
+static void
+hostapd_ubus_probe_flush(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct ubus_probe_client *pc, *tmp;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	avl_for_each_element_safe(&hapd->ubus.probes, pc, avl, tmp) {
+		if (!pc->count) {
+			if (os_reltime_expired(&now, &pc->last_seen,
+					       HOSTAPD_UBUS_PROBE_EXPIRE)) {
+				avl_delete(&hapd->ubus.probes, &pc->avl);
+				hapd->ubus.n_probes--;
+				os_free(pc);
+			}
+			continue;
+		}
+
+		if (hapd->ubus.obj.has_subscribers) {
+			blob_buf_init(&b, 0);
+			blobmsg_add_macaddr(&b, "address", pc->addr);
+			blobmsg_add_u32(&b, "freq", hapd->iface->freq);
+			blobmsg_add_u32(&b, "count", pc->count);
+			if (pc->signal) {
+				blobmsg_add_u32(&b, "signal", pc->signal);
+				blobmsg_add_u32(&b, "signal_min", pc->signal_min);
+				blobmsg_add_u32(&b, "signal_max", pc->signal_max);
+			}
+			blobmsg_add_u32(&b, "capabilities_hash", pc->caps_hash);
+			if (pc->caps_hash != pc->sent_hash) {
+				hostapd_ubus_add_capabilities(pc->has_ht ? &pc->ht : NULL,
+							      pc->has_vht ? &pc->vht : NULL);
+				pc->sent_hash = pc->caps_hash;
+			}
+			ubus_notify(ctx, &hapd->ubus.obj, "probe-summary", b.head, -1);
+		}
+
+		pc->count = 0;
+		pc->signal = 0;
+	}
+
+	if (hapd->ubus.probe_coalesce > 0 && !avl_is_empty(&hapd->ubus.probes))
+		eloop_register_timeout(hapd->ubus.probe_coalesce / 1000,
+				       (hapd->ubus.probe_coalesce % 1000) * 1000,
+				       hostapd_ubus_probe_flush, hapd, NULL);
+}
+
+static void
+hostapd_ubus_probe_clear(struct hostapd_data *hapd)
+{
+	struct ubus_probe_client *pc, *tmp;
+
+	eloop_cancel_timeout(hostapd_ubus_probe_flush, hapd, NULL);
+	avl_remove_all_elements(&hapd->ubus.probes, pc, avl, tmp)
+		os_free(pc);
+	hapd->ubus.n_probes = 0;
+}
+
+/*
+ * Adds a probe request to the summary of its sender. Returns -1 if the
+ * client cannot be tracked and the request has to be notified by itself.
+ */
+static int
+hostapd_ubus_probe_coalesce(struct hostapd_data *hapd, const u8 *addr,
+			    struct hostapd_ubus_request *req)
+{
+	const struct ieee802_11_elems *elems = req->elems;
+	struct ubus_probe_client *pc;
+	u32 hash = 2166136261;
+
+	pc = avl_find_element(&hapd->ubus.probes, addr, pc, avl);
+	if (!pc) {
+		if (hapd->ubus.n_probes >= HOSTAPD_UBUS_MAX_PROBE_CLIENTS)
+			return -1;
+
+		pc = os_zalloc(sizeof(*pc));
+		if (!pc)
+			return -1;
+
+		if (avl_is_empty(&hapd->ubus.probes))
+			eloop_register_timeout(hapd->ubus.probe_coalesce / 1000,
+					       (hapd->ubus.probe_coalesce % 1000) * 1000,
+					       hostapd_ubus_probe_flush, hapd, NULL);
+
+		memcpy(pc->addr, addr, sizeof(pc->addr));
+		pc->avl.key = pc->addr;
+		avl_insert(&hapd->ubus.probes, &pc->avl);
+		hapd->ubus.n_probes++;
+	}
+
+	os_get_reltime(&pc->last_seen);
+	if (req->ssi_signal) {
+		if (!pc->signal || req->ssi_signal < pc->signal_min)
+			pc->signal_min = req->ssi_signal;
+		if (!pc->signal || req->ssi_signal > pc->signal_max)
+			pc->signal_max = req->ssi_signal;
+		pc->signal = req->ssi_signal;
+	}
+	pc->count++;
+
+	pc->has_ht = elems && elems->ht_capabilities;
+	pc->has_vht = elems && elems->vht_capabilities;
+	if (pc->has_ht)
+		memcpy(&pc->ht, elems->ht_capabilities, sizeof(pc->ht));
+	if (pc->has_vht)
+		memcpy(&pc->vht, elems->vht_capabilities, sizeof(pc->vht));
+
+	hash = hostapd_ubus_hash(hash, &pc->has_ht, sizeof(pc->has_ht));
+	if (pc->has_ht)
+		hash = hostapd_ubus_hash(hash, &pc->ht, sizeof(pc->ht));
+	hash = hostapd_ubus_hash(hash, &pc->has_vht, sizeof(pc->has_vht));
+	if (pc->has_vht)
+		hash = hostapd_ubus_hash(hash, &pc->vht, sizeof(pc->vht));
+	pc->caps_hash = hash;
+
+	return 0;
+}
+
+/*
+ * Returns HOSTAPD_UBUS_VERDICT_CACHED if the request can be answered
+ * without asking the subscribers, HOSTAPD_UBUS_VERDICT_HELD if the answer
+ * still has to be asked for, but status applies until it arrives.
+ */
+static int
+hostapd_bss_get_verdict(struct hostapd_data *hapd, const u8 *addr,
+			enum hostapd_ubus_event_type type, int *status)
+{
+	struct ubus_client_verdict *v;
+	struct os_reltime now;
+
+	if (type >= HOSTAPD_UBUS_TYPE_MAX)
+		return HOSTAPD_UBUS_VERDICT_NONE;
+
+	v = avl_find_element(&hapd->ubus.verdicts, addr, v, avl);
+	if (!v)
+		return HOSTAPD_UBUS_VERDICT_NONE;
+
+	os_get_reltime(&now);
+	if (!os_reltime_before(&now, &v->type[type].expire))
+		return HOSTAPD_UBUS_VERDICT_NONE;
+
+	*status = v->type[type].status;
+	if (v->type[type].held) {
+		/* expires once the client stops sending requests */
+		v->type[type].expire = now;
+		v->type[type].expire.sec += HOSTAPD_UBUS_VERDICT_HELD_EXPIRE;
+		return HOSTAPD_UBUS_VERDICT_HELD;
+	}
+
+	return HOSTAPD_UBUS_VERDICT_CACHED;
 }
 
 static int
@@ -278,16 +827,307 @@ hostapd_parse_capab_blobmsg(struct sta_info *sta)
 	blobmsg_close_table(&b, v);
 }
 
+struct ubus_sta_data {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	struct hostap_sta_driver_data data;
+};
+
+#ifdef CONFIG_DRIVER_NL80211
 static int
-hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
-			struct ubus_request_data *req, const char *method,
-			struct blob_attr *msg)
+hostapd_nl80211_sta_dump_cb(struct nl_msg *msg, void *arg)
+{
+	static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
+		[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_PACKETS] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_PACKETS] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_TX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
+		[NL80211_STA_INFO_RX_DURATION] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_TX_DURATION] = { .type = NLA_U64 },
+	};
+	static struct nla_policy rate_policy[NL80211_RATE_INFO_MAX + 1] = {
+		[NL80211_RATE_INFO_BITRATE] = { .type = NLA_U16 },
+		[NL80211_RATE_INFO_BITRATE32] = { .type = NLA_U32 },
+	};
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *stats[NL80211_STA_INFO_MAX + 1];
+	struct nlattr *rate[NL80211_RATE_INFO_MAX + 1];
+	struct avl_tree *tree = arg;
+	struct ubus_sta_data *sd;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+	if (!tb[NL80211_ATTR_MAC] || !tb[NL80211_ATTR_STA_INFO] ||
+	    nla_parse_nested(stats, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], stats_policy))
+		return NL_SKIP;
+
+	sd = os_zalloc(sizeof(*sd));
+	if (!sd)
+		return NL_SKIP;
+
+	memcpy(sd->addr, nla_data(tb[NL80211_ATTR_MAC]), ETH_ALEN);
+	sd->avl.key = sd->addr;
+	if (avl_insert(tree, &sd->avl)) {
+		os_free(sd);
+		return NL_SKIP;
+	}
+
+	if (stats[NL80211_STA_INFO_RX_BYTES64])
+		sd->data.rx_bytes = nla_get_u64(stats[NL80211_STA_INFO_RX_BYTES64]);
+	else if (stats[NL80211_STA_INFO_RX_BYTES])
+		sd->data.rx_bytes = nla_get_u32(stats[NL80211_STA_INFO_RX_BYTES]);
+	if (stats[NL80211_STA_INFO_TX_BYTES64])
+		sd->data.tx_bytes = nla_get_u64(stats[NL80211_STA_INFO_TX_BYTES64]);
+	else if (stats[NL80211_STA_INFO_TX_BYTES])
+		sd->data.tx_bytes = nla_get_u32(stats[NL80211_STA_INFO_TX_BYTES]);
+	if (stats[NL80211_STA_INFO_RX_PACKETS])
+		sd->data.rx_packets = nla_get_u32(stats[NL80211_STA_INFO_RX_PACKETS]);
+	if (stats[NL80211_STA_INFO_TX_PACKETS])
+		sd->data.tx_packets = nla_get_u32(stats[NL80211_STA_INFO_TX_PACKETS]);
+	if (stats[NL80211_STA_INFO_RX_DURATION])
+		sd->data.rx_airtime = nla_get_u64(stats[NL80211_STA_INFO_RX_DURATION]);
+	if (stats[NL80211_STA_INFO_TX_DURATION])
+		sd->data.tx_airtime = nla_get_u64(stats[NL80211_STA_INFO_TX_DURATION]);
+	if (stats[NL80211_STA_INFO_SIGNAL])
+		sd->data.signal = (s8) nla_get_u8(stats[NL80211_STA_INFO_SIGNAL]);
+
+	/* rates in units of 100 kbit/s, as with read_sta_data() */
+	if (stats[NL80211_STA_INFO_TX_BITRATE] &&
+	    !nla_parse_nested(rate, NL80211_RATE_INFO_MAX,
+			      stats[NL80211_STA_INFO_TX_BITRATE], rate_policy)) {
+		if (rate[NL80211_RATE_INFO_BITRATE32])
+			sd->data.current_tx_rate = nla_get_u32(rate[NL80211_RATE_INFO_BITRATE32]);
+		else if (rate[NL80211_RATE_INFO_BITRATE])
+			sd->data.current_tx_rate = nla_get_u16(rate[NL80211_RATE_INFO_BITRATE]);
+	}
+	if (stats[NL80211_STA_INFO_RX_BITRATE] &&
+	    !nla_parse_nested(rate, NL80211_RATE_INFO_MAX,
+			      stats[NL80211_STA_INFO_RX_BITRATE], rate_policy)) {
+		if (rate[NL80211_RATE_INFO_BITRATE32])
+			sd->data.current_rx_rate = nla_get_u32(rate[NL80211_RATE_INFO_BITRATE32]);
+		else if (rate[NL80211_RATE_INFO_BITRATE])
+			sd->data.current_rx_rate = nla_get_u16(rate[NL80211_RATE_INFO_BITRATE]);
+	}
+
+	return NL_SKIP;
+}
+
+static int
+hostapd_nl80211_finish_cb(struct nl_msg *msg, void *arg)
 {
-	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
-	struct hostap_sta_driver_data sta_driver_data;
+	int *ret = arg;
+
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int
+hostapd_nl80211_error_cb(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg)
+{
+	int *ret = arg;
+
+	*ret = err->error;
+	return NL_STOP;
+}
+#endif
+
+/*
+ * Fetches the driver data of all stations of the BSS with a single nl80211
+ * station dump, instead of one request per station. Stations on AP_VLAN
+ * interfaces (dynamic VLAN, WDS) are not part of the dump and have to be
+ * read one by one.
+ */
+static int
+hostapd_ubus_read_sta_data_all(struct hostapd_data *hapd, struct avl_tree *tree)
+{
+#ifdef CONFIG_DRIVER_NL80211
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int ifindex, ret;
+
+	if (!hapd->driver || !hapd->driver->name ||
+	    os_strcmp(hapd->driver->name, "nl80211") != 0)
+		return -1;
+
+	ifindex = if_nametoindex(hapd->conf->iface);
+	if (!ifindex)
+		return -1;
+
+	if (!nl80211_sock) {
+		nl80211_sock = nl_socket_alloc();
+		if (!nl80211_sock)
+			return -1;
+
+		if (genl_connect(nl80211_sock) ||
+		    (nl80211_id = genl_ctrl_resolve(nl80211_sock, "nl80211")) < 0) {
+			nl_socket_free(nl80211_sock);
+			nl80211_sock = NULL;
+			return -1;
+		}
+	}
+
+	msg = nlmsg_alloc();
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!msg || !cb)
+		goto error;
+
+	genlmsg_put(msg, 0, 0, nl80211_id, 0, NLM_F_DUMP, NL80211_CMD_GET_STATION, 0);
+	if (nla_put_u32(msg, NL80211_ATTR_IFINDEX, ifindex) ||
+	    nl_send_auto_complete(nl80211_sock, msg) < 0)
+		goto error;
+
+	ret = 1;
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, hostapd_nl80211_sta_dump_cb, tree);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, hostapd_nl80211_finish_cb, &ret);
+	nl_cb_err(cb, NL_CB_CUSTOM, hostapd_nl80211_error_cb, &ret);
+	while (ret > 0)
+		if (nl_recvmsgs(nl80211_sock, cb) < 0)
+			break;
+
+	nlmsg_free(msg);
+	nl_cb_put(cb);
+
+	if (ret) {
+		/*
+		 * the rest of the dump can still be queued on the socket and
+		 * would be taken as the answer to the next request
+		 */
+		nl_socket_free(nl80211_sock);
+		nl80211_sock = NULL;
+		return -1;
+	}
+
+	return 0;
+
+error:
+	if (msg)
+		nlmsg_free(msg);
+	if (cb)
+		nl_cb_put(cb);
+#endif
+	return -1;
+}
+
+static u32
+hostapd_ubus_client_hash(struct sta_info *sta)
+{
+	u32 hash = 2166136261;
+
+	hash = hostapd_ubus_hash(hash, &sta->flags, sizeof(sta->flags));
+	hash = hostapd_ubus_hash(hash, &sta->aid, sizeof(sta->aid));
+	hash = hostapd_ubus_hash(hash, sta->rrm_enabled_capa,
+				 sizeof(sta->rrm_enabled_capa));
+#ifdef CONFIG_MBO
+	hash = hostapd_ubus_hash(hash, &sta->cell_capa, sizeof(sta->cell_capa));
+#endif
+	if (sta->ext_capability)
+		hash = hostapd_ubus_hash(hash, sta->ext_capability,
+					 1 + sta->ext_capability[0]);
+	if (sta->vht_capabilities)
+		hash = hostapd_ubus_hash(hash, sta->vht_capabilities,
+					 sizeof(*sta->vht_capabilities));
+
+	return hash;
+}
+
+/*
+ * Brings the station states used by the "since" cursor of get_clients up to
+ * date. Every station that was added, removed or changed since the last
+ * call gets the next cursor value.
+ */
+static void
+hostapd_ubus_clients_update(struct hostapd_data *hapd)
+{
+	struct ubus_client_state *cs, *oldest;
 	struct sta_info *sta;
-	void *list, *c;
+	u32 hash;
+
+	avl_for_each_element(&hapd->ubus.clients, cs, avl)
+		cs->seen = false;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		hash = hostapd_ubus_client_hash(sta);
+
+		cs = avl_find_element(&hapd->ubus.clients, sta->addr, cs, avl);
+		if (!cs) {
+			cs = os_zalloc(sizeof(*cs));
+			if (!cs)
+				continue;
+
+			memcpy(cs->addr, sta->addr, sizeof(cs->addr));
+			cs->avl.key = cs->addr;
+			avl_insert(&hapd->ubus.clients, &cs->avl);
+			cs->gen = ++hapd->ubus.client_gen;
+		} else if (cs->removed || cs->hash != hash) {
+			if (cs->removed)
+				hapd->ubus.n_removed--;
+			cs->removed = false;
+			cs->gen = ++hapd->ubus.client_gen;
+		}
+
+		cs->hash = hash;
+		cs->seen = true;
+	}
+
+	avl_for_each_element(&hapd->ubus.clients, cs, avl) {
+		if (cs->seen || cs->removed)
+			continue;
+
+		cs->removed = true;
+		cs->gen = ++hapd->ubus.client_gen;
+		hapd->ubus.n_removed++;
+	}
+
+	while (hapd->ubus.n_removed > HOSTAPD_UBUS_MAX_REMOVED) {
+		oldest = NULL;
+		avl_for_each_element(&hapd->ubus.clients, cs, avl)
+			if (cs->removed && (!oldest || cs->gen < oldest->gen))
+				oldest = cs;
+
+		/* callers with an older cursor get the full list again */
+		hapd->ubus.client_purged = oldest->gen;
+		avl_delete(&hapd->ubus.clients, &oldest->avl);
+		os_free(oldest);
+		hapd->ubus.n_removed--;
+	}
+}
+
+enum {
+	CLIENT_FIELD_FLAGS,
+	CLIENT_FIELD_RRM,
+	CLIENT_FIELD_EXT_CAPA,
+	CLIENT_FIELD_AID,
+	CLIENT_FIELD_SIGNATURE,
+	CLIENT_FIELD_DRIVER,
+	CLIENT_FIELD_CAPABILITIES,
+	__CLIENT_FIELD_MAX
+};
+
+static const char * const client_fields[__CLIENT_FIELD_MAX] = {
+	[CLIENT_FIELD_FLAGS] = "flags",
+	[CLIENT_FIELD_RRM] = "rrm",
+	[CLIENT_FIELD_EXT_CAPA] = "extended_capabilities",
+	[CLIENT_FIELD_AID] = "aid",
+	[CLIENT_FIELD_SIGNATURE] = "signature",
+	[CLIENT_FIELD_DRIVER] = "driver",
+	[CLIENT_FIELD_CAPABILITIES] = "capabilities",
+};
+
+static void
+hostapd_bss_add_client(struct hostapd_data *hapd, struct sta_info *sta,
+		       unsigned int fields, struct avl_tree *sta_data)
+{
+	struct hostap_sta_driver_data sta_driver_data;
+	struct hostap_sta_driver_data *data = NULL;
+	struct ubus_sta_data *sd;
+	void *c, *r;
 	char mac_buf[20];
+	int i;
 	static const struct {
 		const char *name;
 		uint32_t flag;
@@ -305,15 +1145,9 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		{ "mfp", WLAN_STA_MFP },
 	};
 
-	blob_buf_init(&b, 0);
-	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
-	list = blobmsg_open_table(&b, "clients");
-	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		void *r;
-		int i;
-
-		sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
-		c = blobmsg_open_table(&b, mac_buf);
+	sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
+	c = blobmsg_open_table(&b, mac_buf);
+	if (fields & BIT(CLIENT_FIELD_FLAGS)) {
 		for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
 			blobmsg_add_u8(&b, sta_flags[i].name,
 				       !!(sta->flags & sta_flags[i].flag));
@@ -321,58 +1155,389 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 #ifdef CONFIG_MBO
 		blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
 #endif
+	}
 
+	if (fields & BIT(CLIENT_FIELD_RRM)) {
 		r = blobmsg_open_array(&b, "rrm");
 		for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
 			blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
 		blobmsg_close_array(&b, r);
+	}
+
+	if (fields & BIT(CLIENT_FIELD_EXT_CAPA)) {
+		r = blobmsg_open_array(&b, "extended_capabilities");
+		/* Check if client advertises extended capabilities */
+		if (sta->ext_capability && sta->ext_capability[0] > 0) {
+			for (i = 0; i < sta->ext_capability[0]; i++) {
+				blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
+			}
+		}
+		blobmsg_close_array(&b, r);
+	}
+
+	if (fields & BIT(CLIENT_FIELD_AID))
+		blobmsg_add_u32(&b, "aid", sta->aid);
+#ifdef CONFIG_TAXONOMY
+	if (fields & BIT(CLIENT_FIELD_SIGNATURE)) {
+		r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
+		if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
+			blobmsg_add_string_buffer(&b);
+	}
+#endif
+
+	/* Driver information, from the station dump if the station is in it */
+	if (fields & BIT(CLIENT_FIELD_DRIVER)) {
+		if (sta_data) {
+			sd = avl_find_element(sta_data, sta->addr, sd, avl);
+			if (sd)
+				data = &sd->data;
+		}
+		if (!data &&
+		    hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0)
+			data = &sta_driver_data;
+	}
+
+	if (data) {
+		r = blobmsg_open_table(&b, "bytes");
+		blobmsg_add_u64(&b, "rx", data->rx_bytes);
+		blobmsg_add_u64(&b, "tx", data->tx_bytes);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "airtime");
+		blobmsg_add_u64(&b, "rx", data->rx_airtime);
+		blobmsg_add_u64(&b, "tx", data->tx_airtime);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "packets");
+		blobmsg_add_u32(&b, "rx", data->rx_packets);
+		blobmsg_add_u32(&b, "tx", data->tx_packets);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "rate");
+		/* Rate in kbits */
+		blobmsg_add_u32(&b, "rx", data->current_rx_rate * 100);
+		blobmsg_add_u32(&b, "tx", data->current_tx_rate * 100);
+		blobmsg_close_table(&b, r);
+		blobmsg_add_u32(&b, "signal", data->signal);
+	}
+
+	if (fields & BIT(CLIENT_FIELD_CAPABILITIES))
+		hostapd_parse_capab_blobmsg(sta);
+
+	blobmsg_close_table(&b, c);
+}
+
+enum {
+	CLIENTS_ADDR,
+	CLIENTS_FIELDS,
+	CLIENTS_SINCE,
+	__CLIENTS_MAX
+};
+
+static const struct blobmsg_policy clients_policy[__CLIENTS_MAX] = {
+	[CLIENTS_ADDR] = { "addr", BLOBMSG_TYPE_ARRAY },
+	[CLIENTS_FIELDS] = { "fields", BLOBMSG_TYPE_ARRAY },
+	[CLIENTS_SINCE] = { "since", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
+	struct blob_attr *tb[__CLIENTS_MAX];
+	struct ubus_client_state *cs;
+	struct ubus_sta_data *sd, *tmp;
+	struct avl_tree sta_data;
+	struct blob_attr *cur;
+	struct sta_info *sta;
+	unsigned int fields = 0;
+	int n_addr = -1;
+	bool use_dump = false;
+	bool full = true;
+	u32 since = 0;
+	u8 addr[ETH_ALEN];
+	void *list;
+	int i, rem;
+
+	blobmsg_parse(clients_policy, __CLIENTS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (tb[CLIENTS_ADDR]) {
+		n_addr = blobmsg_check_array(tb[CLIENTS_ADDR], BLOBMSG_TYPE_STRING);
+		if (n_addr < 0)
+			return UBUS_STATUS_INVALID_ARGUMENT;
+	}
+
+	if (tb[CLIENTS_FIELDS]) {
+		if (blobmsg_check_array(tb[CLIENTS_FIELDS], BLOBMSG_TYPE_STRING) < 0)
+			return UBUS_STATUS_INVALID_ARGUMENT;
+
+		blobmsg_for_each_attr(cur, tb[CLIENTS_FIELDS], rem) {
+			for (i = 0; i < __CLIENT_FIELD_MAX; i++)
+				if (!strcmp(blobmsg_get_string(cur), client_fields[i]))
+					break;
+
+			if (i == __CLIENT_FIELD_MAX)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			fields |= BIT(i);
+		}
+	} else {
+		fields = BIT(__CLIENT_FIELD_MAX) - 1;
+	}
+
+	hostapd_ubus_clients_update(hapd);
+
+	/*
+	 * A cursor older than the oldest removal still known, or one of an
+	 * earlier hostapd instance, gets the full list.
+	 */
+	if (tb[CLIENTS_SINCE]) {
+		since = blobmsg_get_u32(tb[CLIENTS_SINCE]);
+		full = since < hapd->ubus.client_purged ||
+		       since > hapd->ubus.client_gen;
+	}
+
+	/* a single station needs no dump */
+	avl_init(&sta_data, avl_compare_macaddr, false, NULL);
+	if ((fields & BIT(CLIENT_FIELD_DRIVER)) && hapd->num_sta > 1 && n_addr != 1)
+		use_dump = !hostapd_ubus_read_sta_data_all(hapd, &sta_data);
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
+	blobmsg_add_u32(&b, "cursor", hapd->ubus.client_gen);
+	if (tb[CLIENTS_SINCE])
+		blobmsg_add_u8(&b, "full", full);
+
+	list = blobmsg_open_table(&b, "clients");
+	if (tb[CLIENTS_ADDR]) {
+		blobmsg_for_each_attr(cur, tb[CLIENTS_ADDR], rem) {
+			if (hwaddr_aton(blobmsg_get_string(cur), addr))
+				continue;
+
+			sta = ap_get_sta(hapd, addr);
+			if (!sta)
+				continue;
+
+			cs = avl_find_element(&hapd->ubus.clients, sta->addr, cs, avl);
+			if (!full && cs && cs->gen <= since)
+				continue;
+
+			hostapd_bss_add_client(hapd, sta, fields, use_dump ? &sta_data : NULL);
+		}
+	} else {
+		for (sta = hapd->sta_list; sta; sta = sta->next) {
+			cs = avl_find_element(&hapd->ubus.clients, sta->addr, cs, avl);
+			if (!full && cs && cs->gen <= since)
+				continue;
+
+			hostapd_bss_add_client(hapd, sta, fields, use_dump ? &sta_data : NULL);
+		}
+	}
+	blobmsg_close_table(&b, list);
+
+	if (!full) {
+		list = blobmsg_open_array(&b, "removed");
+		avl_for_each_element(&hapd->ubus.clients, cs, avl)
+			if (cs->removed && cs->gen > since)
+				blobmsg_printf(&b, NULL, MACSTR, MAC2STR(cs->addr));
+		blobmsg_close_array(&b, list);
+	}
+
+	ubus_send_reply(ctx, req, b.head);
+
+	avl_remove_all_elements(&sta_data, sd, avl, tmp)
+		os_free(sd);
+
+	return 0;
+}
+
+static void
+hostapd_ubus_stats_update(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct hostapd_stats_header *hdr = hapd->ubus.stats;
+	struct hostapd_stats_slot *slot;
+	struct hostapd_stats_sta *st;
+	struct hostap_sta_driver_data sta_driver_data;
+	struct hostap_sta_driver_data *data;
+	struct ubus_sta_data *sd, *tmp;
+	struct avl_tree sta_data;
+	struct sta_info *sta;
+	struct timespec ts;
+	bool use_dump;
+	u32 n = 0;
+
+	avl_init(&sta_data, avl_compare_macaddr, false, NULL);
+	use_dump = hapd->num_sta > 1 &&
+		   !hostapd_ubus_read_sta_data_all(hapd, &sta_data);
+
+	slot = hostapd_stats_begin(hdr);
+	for (sta = hapd->sta_list; sta && n < hdr->max_sta; sta = sta->next) {
+		data = NULL;
+		if (use_dump) {
+			sd = avl_find_element(&sta_data, sta->addr, sd, avl);
+			if (sd)
+				data = &sd->data;
+		}
+		/* AP_VLAN stations are not in the dump */
+		if (!data &&
+		    hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0)
+			data = &sta_driver_data;
+
+		st = &slot->sta[n++];
+		memset(st, 0, sizeof(*st));
+		memcpy(st->addr, sta->addr, ETH_ALEN);
+		st->aid = sta->aid;
+		st->flags = sta->flags;
+		if (!data)
+			continue;
+
+		st->rx_bytes = data->rx_bytes;
+		st->tx_bytes = data->tx_bytes;
+		st->rx_packets = data->rx_packets;
+		st->tx_packets = data->tx_packets;
+		st->rx_airtime = data->rx_airtime;
+		st->tx_airtime = data->tx_airtime;
+		/* Rate in kbits */
+		st->rx_rate = data->current_rx_rate * 100;
+		st->tx_rate = data->current_tx_rate * 100;
+		st->signal = data->signal;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	slot->bss.timestamp = (u64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	slot->bss.freq = hapd->iface->freq;
+	slot->bss.num_sta = hapd->num_sta;
+	slot->bss.n_sta = n;
+
+	hostapd_stats_commit(hdr, slot);
+
+	avl_remove_all_elements(&sta_data, sd, avl, tmp)
+		os_free(sd);
+
+	eloop_register_timeout(hapd->ubus.stats_interval / 1000,
+			       (hapd->ubus.stats_interval % 1000) * 1000,
+			       hostapd_ubus_stats_update, hapd, NULL);
+}
+
+static void
+hostapd_ubus_stats_stop(struct hostapd_data *hapd)
+{
+	char path[64];
+
+	if (!hapd->ubus.stats)
+		return;
+
+	eloop_cancel_timeout(hostapd_ubus_stats_update, hapd, NULL);
+
+	/* tell readers that still have the file mapped to let go of it */
+	__atomic_store_n(&hapd->ubus.stats->magic, 0, __ATOMIC_RELEASE);
+	munmap(hapd->ubus.stats, hapd->ubus.stats_size);
+	hapd->ubus.stats = NULL;
+
+	snprintf(path, sizeof(path), HOSTAPD_STATS_PATH, hapd->conf->iface);
+	unlink(path);
+}
+
+static int
+hostapd_ubus_stats_start(struct hostapd_data *hapd)
+{
+	struct hostapd_stats_header *hdr;
+	unsigned int max_sta;
+	char path[64], tmp[70];
+	size_t size;
+	void *data;
+	int fd;
+
+	max_sta = hapd->conf->max_num_sta;
+	if (max_sta > HOSTAPD_UBUS_STATS_MAX_STA)
+		max_sta = HOSTAPD_UBUS_STATS_MAX_STA;
+	size = hostapd_stats_size(max_sta);
+
+	/* set up under a temporary name, so that readers never see a partial header */
+	snprintf(path, sizeof(path), HOSTAPD_STATS_PATH, hapd->conf->iface);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		unlink(tmp);
+		return -1;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		unlink(tmp);
+		return -1;
+	}
+
+	hdr = data;
+	hdr->version = HOSTAPD_STATS_VERSION;
+	hdr->max_sta = max_sta;
+	hdr->slot_size = sizeof(struct hostapd_stats_slot) +
+			 max_sta * sizeof(struct hostapd_stats_sta);
+	hdr->head = 0;
+	__atomic_store_n(&hdr->magic, HOSTAPD_STATS_MAGIC, __ATOMIC_RELEASE);
+
+	if (rename(tmp, path) < 0) {
+		munmap(data, size);
+		unlink(tmp);
+		return -1;
+	}
+
+	hapd->ubus.stats = hdr;
+	hapd->ubus.stats_size = size;
+	hostapd_ubus_stats_update(hapd, NULL);
+
+	return 0;
+}
+
+enum {
+	STATS_EXPORT_INTERVAL,
+	__STATS_EXPORT_MAX
+};
+
+static const struct blobmsg_policy stats_export_policy[__STATS_EXPORT_MAX] = {
+	[STATS_EXPORT_INTERVAL] = { "interval", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_stats_export(struct ubus_context *ctx, struct ubus_object *obj,
+			 struct ubus_request_data *req, const char *method,
+			 struct blob_attr *msg)
+{
+	struct blob_attr *tb[__STATS_EXPORT_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	int interval;
 
-		r = blobmsg_open_array(&b, "extended_capabilities");
-		/* Check if client advertises extended capabilities */
-		if (sta->ext_capability && sta->ext_capability[0] > 0) {
-			for (i = 0; i < sta->ext_capability[0]; i++) {
-				blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
-			}
-		}
-		blobmsg_close_array(&b, r);
+	blobmsg_parse(stats_export_policy, __STATS_EXPORT_MAX, tb, blob_data(msg), blob_len(msg));
 
-		blobmsg_add_u32(&b, "aid", sta->aid);
-#ifdef CONFIG_TAXONOMY
-		r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
-		if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
-			blobmsg_add_string_buffer(&b);
-#endif
+	if (!tb[STATS_EXPORT_INTERVAL])
+		return UBUS_STATUS_INVALID_ARGUMENT;
 
-		/* Driver information */
-		if (hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0) {
-			r = blobmsg_open_table(&b, "bytes");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_bytes);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_bytes);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "airtime");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_airtime);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_airtime);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "packets");
-			blobmsg_add_u32(&b, "rx", sta_driver_data.rx_packets);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.tx_packets);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "rate");
-			/* Rate in kbits */
-			blobmsg_add_u32(&b, "rx", sta_driver_data.current_rx_rate * 100);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.current_tx_rate * 100);
-			blobmsg_close_table(&b, r);
-			blobmsg_add_u32(&b, "signal", sta_driver_data.signal);
-		}
+	interval = blobmsg_get_u32(tb[STATS_EXPORT_INTERVAL]);
+	if (interval < 0 ||
+	    (interval && interval < HOSTAPD_UBUS_STATS_MIN_INTERVAL))
+		return UBUS_STATUS_INVALID_ARGUMENT;
 
-		hostapd_parse_capab_blobmsg(sta);
+	hapd->ubus.stats_interval = interval;
+	if (!interval) {
+		hostapd_ubus_stats_stop(hapd);
+		return UBUS_STATUS_OK;
+	}
 
-		blobmsg_close_table(&b, c);
+	if (hapd->ubus.stats) {
+		eloop_cancel_timeout(hostapd_ubus_stats_update, hapd, NULL);
+		hostapd_ubus_stats_update(hapd, NULL);
+		return UBUS_STATUS_OK;
 	}
-	blobmsg_close_array(&b, list);
-	ubus_send_reply(ctx, req, b.head);
 
-	return 0;
+	if (hostapd_ubus_stats_start(hapd))
+		return UBUS_STATUS_UNKNOWN_ERROR;
+
+	return UBUS_STATUS_OK;
 }
 
 static int
@@ -468,11 +1633,15 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 
 enum {
 	NOTIFY_RESPONSE,
+	NOTIFY_VERDICT_TIMEOUT,
+	NOTIFY_ASYNC,
 	__NOTIFY_MAX
 };
 
 static const struct blobmsg_policy notify_policy[__NOTIFY_MAX] = {
 	[NOTIFY_RESPONSE] = { "notify_response", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_VERDICT_TIMEOUT] = { "verdict_timeout", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_ASYNC] = { "async", BLOBMSG_TYPE_BOOL },
 };
 
 static int
@@ -493,6 +1662,118 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 		return UBUS_STATUS_INVALID_ARGUMENT;
 
 	hapd->ubus.notify_response = blobmsg_get_u32(tb[NOTIFY_RESPONSE]);
+	hapd->ubus.notify_async = tb[NOTIFY_ASYNC] && blobmsg_get_bool(tb[NOTIFY_ASYNC]);
+	if (tb[NOTIFY_VERDICT_TIMEOUT])
+		hapd->ubus.verdict_timeout = blobmsg_get_u32(tb[NOTIFY_VERDICT_TIMEOUT]);
+	else if (hapd->ubus.notify_async)
+		hapd->ubus.verdict_timeout = HOSTAPD_UBUS_VERDICT_TIMEOUT;
+	else
+		hapd->ubus.verdict_timeout = 0;
+
+	return UBUS_STATUS_OK;
+}
+
+enum {
+	PROBE_COALESCE_INTERVAL,
+	__PROBE_COALESCE_MAX
+};
+
+static const struct blobmsg_policy probe_coalesce_policy[__PROBE_COALESCE_MAX] = {
+	[PROBE_COALESCE_INTERVAL] = { "interval", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_probe_coalesce(struct ubus_context *ctx, struct ubus_object *obj,
+			   struct ubus_request_data *req, const char *method,
+			   struct blob_attr *msg)
+{
+	struct blob_attr *tb[__PROBE_COALESCE_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	int interval;
+
+	blobmsg_parse(probe_coalesce_policy, __PROBE_COALESCE_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (!tb[PROBE_COALESCE_INTERVAL])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	interval = blobmsg_get_u32(tb[PROBE_COALESCE_INTERVAL]);
+	if (interval < 0)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	/* send what was collected so far, the new interval starts now */
+	eloop_cancel_timeout(hostapd_ubus_probe_flush, hapd, NULL);
+	hapd->ubus.probe_coalesce = interval;
+	hostapd_ubus_probe_flush(hapd, NULL);
+	if (!interval)
+		hostapd_ubus_probe_clear(hapd);
+
+	return UBUS_STATUS_OK;
+}
+
+enum {
+	VERDICT_ADDR,
+	VERDICT_STATUS,
+	VERDICT_TIMEOUT,
+	VERDICT_EVENTS,
+	__VERDICT_MAX
+};
+
+static const struct blobmsg_policy verdict_policy[__VERDICT_MAX] = {
+	[VERDICT_ADDR] = { "addr", BLOBMSG_TYPE_STRING },
+	[VERDICT_STATUS] = { "status", BLOBMSG_TYPE_INT32 },
+	[VERDICT_TIMEOUT] = { "timeout", BLOBMSG_TYPE_INT32 },
+	[VERDICT_EVENTS] = { "events", BLOBMSG_TYPE_ARRAY },
+};
+
+static int
+hostapd_bss_client_verdict(struct ubus_context *ctx, struct ubus_object *obj,
+			   struct ubus_request_data *req, const char *method,
+			   struct blob_attr *msg)
+{
+	struct blob_attr *tb[__VERDICT_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct blob_attr *cur;
+	unsigned int types = 0;
+	int status, timeout, i, rem;
+	u8 addr[ETH_ALEN];
+
+	blobmsg_parse(verdict_policy, __VERDICT_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (!tb[VERDICT_ADDR] || !tb[VERDICT_STATUS])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	if (hwaddr_aton(blobmsg_data(tb[VERDICT_ADDR]), addr))
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	status = blobmsg_get_u32(tb[VERDICT_STATUS]);
+	if (status < 0)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	timeout = hapd->ubus.verdict_timeout;
+	if (timeout <= 0)
+		timeout = HOSTAPD_UBUS_VERDICT_TIMEOUT;
+	if (tb[VERDICT_TIMEOUT])
+		timeout = blobmsg_get_u32(tb[VERDICT_TIMEOUT]);
+
+	if (tb[VERDICT_EVENTS]) {
+		if (blobmsg_check_array(tb[VERDICT_EVENTS], BLOBMSG_TYPE_STRING) < 0)
+			return UBUS_STATUS_INVALID_ARGUMENT;
+
+		blobmsg_for_each_attr(cur, tb[VERDICT_EVENTS], rem) {
+			for (i = 0; i < HOSTAPD_UBUS_TYPE_MAX; i++)
+				if (!strcmp(blobmsg_get_string(cur), event_types[i]))
+					break;
+
+			if (i == HOSTAPD_UBUS_TYPE_MAX)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			types |= BIT(i);
+		}
+	} else {
+		types = BIT(HOSTAPD_UBUS_TYPE_MAX) - 1;
+	}
+
+	hostapd_bss_set_verdict(hapd, addr, types, status, timeout);
 
 	return UBUS_STATUS_OK;
 }
@@ -571,19 +1852,80 @@ hostapd_bss_list_bans(struct ubus_context *ctx, struct ubus_object *obj,
 		      struct blob_attr *msg)
 {
 	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
+	struct hostapd_ubus_bans *bans = hapd->ubus.bans;
 	struct ubus_banned_client *ban;
+	u64 now = hostapd_ubus_time_ms();
 	void *c;
+	int i;
 
 	blob_buf_init(&b, 0);
 	c = blobmsg_open_array(&b, "clients");
-	avl_for_each_element(&hapd->ubus.banned, ban, avl)
-		blobmsg_add_macaddr(&b, NULL, ban->addr);
+	for (i = 0; bans && i < HOSTAPD_UBUS_BAN_HASH; i++)
+		dl_list_for_each(ban, &bans->hash[i], struct ubus_banned_client, hash)
+			if (ban->expire > now)
+				blobmsg_add_macaddr(&b, NULL, ban->addr);
 	blobmsg_close_array(&b, c);
 	ubus_send_reply(ctx, req, b.head);
 
 	return 0;
 }
 
+enum {
+	BAN_CLIENTS_ADDR,
+	BAN_CLIENTS_TIME,
+	__BAN_CLIENTS_MAX
+};
+
+static const struct blobmsg_policy ban_clients_policy[__BAN_CLIENTS_MAX] = {
+	[BAN_CLIENTS_ADDR] = { "addr", BLOBMSG_TYPE_ARRAY },
+	[BAN_CLIENTS_TIME] = { "ban_time", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_ban_clients(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct blob_attr *tb[__BAN_CLIENTS_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct blob_attr *cur;
+	u8 addr[ETH_ALEN];
+	int time = 0;
+	int rem;
+
+	blobmsg_parse(ban_clients_policy, __BAN_CLIENTS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (!tb[BAN_CLIENTS_ADDR]) {
+		if (strcmp(method, "unban_clients") != 0)
+			return UBUS_STATUS_INVALID_ARGUMENT;
+
+		hostapd_bss_free_bans(hapd);
+		return UBUS_STATUS_OK;
+	}
+
+	if (blobmsg_check_array(tb[BAN_CLIENTS_ADDR], BLOBMSG_TYPE_STRING) < 0)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	if (!strcmp(method, "ban_clients")) {
+		if (!tb[BAN_CLIENTS_TIME])
+			return UBUS_STATUS_INVALID_ARGUMENT;
+
+		time = blobmsg_get_u32(tb[BAN_CLIENTS_TIME]);
+	}
+
+	blobmsg_for_each_attr(cur, tb[BAN_CLIENTS_ADDR], rem)
+		if (hwaddr_aton(blobmsg_data(cur), addr))
+			return UBUS_STATUS_INVALID_ARGUMENT;
+
+	blobmsg_for_each_attr(cur, tb[BAN_CLIENTS_ADDR], rem) {
+		hwaddr_aton(blobmsg_data(cur), addr);
+		if (hostapd_bss_ban_client(hapd, addr, time))
+			return UBUS_STATUS_UNKNOWN_ERROR;
+	}
+
+	return UBUS_STATUS_OK;
+}
+
 #ifdef CONFIG_WPS
 static int
 hostapd_bss_wps_start(struct ubus_context *ctx, struct ubus_object *obj,
@@ -1672,13 +3014,15 @@ hostapd_bss_update_airtime(struct ubus_context *ctx, struct ubus_object *obj,
 
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", hostapd_bss_reload),
-	UBUS_METHOD_NOARG("get_clients", hostapd_bss_get_clients),
+	UBUS_METHOD("get_clients", hostapd_bss_get_clients, clients_policy),
 	UBUS_METHOD_NOARG("get_status", hostapd_bss_get_status),
 	UBUS_METHOD("del_client", hostapd_bss_del_client, del_policy),
 #ifdef CONFIG_AIRTIME_POLICY
 	UBUS_METHOD("update_airtime", hostapd_bss_update_airtime, airtime_policy),
 #endif
 	UBUS_METHOD_NOARG("list_bans", hostapd_bss_list_bans),
+	UBUS_METHOD("ban_clients", hostapd_bss_ban_clients, ban_clients_policy),
+	UBUS_METHOD("unban_clients", hostapd_bss_ban_clients, ban_clients_policy),
 #ifdef CONFIG_WPS
 	UBUS_METHOD_NOARG("wps_start", hostapd_bss_wps_start),
 	UBUS_METHOD_NOARG("wps_status", hostapd_bss_wps_status),
@@ -1691,6 +3035,9 @@ static const struct ubus_method bss_methods[] = {
 #endif
 	UBUS_METHOD("set_vendor_elements", hostapd_vendor_elements, ve_policy),
 	UBUS_METHOD("notify_response", hostapd_notify_response, notify_policy),
+	UBUS_METHOD("client_verdict", hostapd_bss_client_verdict, verdict_policy),
+	UBUS_METHOD("probe_coalesce", hostapd_bss_probe_coalesce, probe_coalesce_policy),
+	UBUS_METHOD("stats_export", hostapd_bss_stats_export, stats_export_policy),
 	UBUS_METHOD("bss_mgmt_enable", hostapd_bss_mgmt_enable, bss_mgmt_enable_policy),
 	UBUS_METHOD_NOARG("rrm_nr_get_own", hostapd_rrm_nr_get_own),
 	UBUS_METHOD_NOARG("rrm_nr_list", hostapd_rrm_nr_list),
@@ -1705,9 +3052,152 @@ static const struct ubus_method bss_methods[] = {
 static struct ubus_object_type bss_object_type =
 	UBUS_OBJECT_TYPE("hostapd_bss", bss_methods);
 
-static int avl_compare_macaddr(const void *k1, const void *k2, void *ptr)
+struct ubus_event_req {
+	struct ubus_notify_request nreq;
+	int resp;
+};
+
+static void
+ubus_event_cb(struct ubus_notify_request *req, int idx, int ret)
 {
-	return memcmp(k1, k2, ETH_ALEN);
+	struct ubus_event_req *ureq = container_of(req, struct ubus_event_req, nreq);
+
+	/* a refusal by any of the subscribers wins */
+	if (ret)
+		ureq->resp = ret;
+}
+
+/* sends the message in b to the subscribers and waits for their answer */
+static int
+hostapd_ubus_notify_wait(struct hostapd_data *hapd, const char *type)
+{
+	struct ubus_event_req ureq = {};
+
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
+		return 0;
+
+	ureq.nreq.status_cb = ubus_event_cb;
+	ubus_complete_request(ctx, &ureq.nreq.req, HOSTAPD_UBUS_RESPONSE_TIMEOUT);
+
+	return ureq.resp;
+}
+
+static void hostapd_ubus_pending_timeout(void *eloop_data, void *user_ctx);
+static void hostapd_ubus_pending_finish(void *eloop_data, void *user_ctx);
+
+static void
+hostapd_ubus_pending_free(struct hostapd_ubus_pending *p)
+{
+	eloop_cancel_timeout(hostapd_ubus_pending_timeout, p, NULL);
+	eloop_cancel_timeout(hostapd_ubus_pending_finish, p, NULL);
+	if (!p->complete)
+		ubus_abort_request(ctx, &p->nreq.req);
+
+	dl_list_del(&p->list);
+	p->hapd->ubus.n_pending--;
+	os_free(p);
+}
+
+static void
+hostapd_ubus_pending_finish(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_ubus_pending *p = eloop_data;
+
+	p->done(p);
+	hostapd_ubus_pending_free(p);
+}
+
+static void
+hostapd_ubus_pending_timeout(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_ubus_pending *p = eloop_data;
+
+	ubus_abort_request(ctx, &p->nreq.req);
+	p->complete = true;
+	hostapd_ubus_pending_finish(p, NULL);
+}
+
+static void
+hostapd_ubus_pending_status(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct hostapd_ubus_pending *p = container_of(req, struct hostapd_ubus_pending, nreq);
+
+	/* a refusal by any of the subscribers wins */
+	if (ret)
+		p->resp = ret;
+}
+
+static void
+hostapd_ubus_pending_complete(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct hostapd_ubus_pending *p = container_of(req, struct hostapd_ubus_pending, nreq);
+
+	/* the request is still referenced by libubus until this returns */
+	p->complete = true;
+	eloop_cancel_timeout(hostapd_ubus_pending_timeout, p, NULL);
+	eloop_register_timeout(0, 0, hostapd_ubus_pending_finish, p, NULL);
+}
+
+static struct hostapd_ubus_pending *
+hostapd_ubus_pending_find(struct hostapd_data *hapd, const u8 *addr,
+			  enum hostapd_ubus_event_type type)
+{
+	struct hostapd_ubus_pending *p;
+
+	dl_list_for_each(p, &hapd->ubus.pending, struct hostapd_ubus_pending, list)
+		if (p->type == type && !memcmp(p->addr, addr, ETH_ALEN))
+			return p;
+
+	return NULL;
+}
+
+static struct hostapd_ubus_pending *
+hostapd_ubus_pending_add(struct hostapd_data *hapd, const u8 *addr,
+			 enum hostapd_ubus_event_type type,
+			 const u8 *frame, size_t len)
+{
+	struct hostapd_ubus_pending *p;
+
+	if (hapd->ubus.n_pending >= HOSTAPD_UBUS_MAX_PENDING)
+		return NULL;
+
+	p = os_zalloc(sizeof(*p) + len);
+	if (!p)
+		return NULL;
+
+	p->hapd = hapd;
+	p->type = type;
+	p->complete = true;
+	memcpy(p->addr, addr, ETH_ALEN);
+	if (len)
+		memcpy(p->frame, frame, len);
+	p->len = len;
+
+	dl_list_add_tail(&hapd->ubus.pending, &p->list);
+	hapd->ubus.n_pending++;
+
+	return p;
+}
+
+/* sends the message in b to the subscribers without waiting for them */
+static int
+hostapd_ubus_pending_send(struct hostapd_ubus_pending *p, const char *type)
+{
+	struct hostapd_data *hapd = p->hapd;
+
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &p->nreq)) {
+		hostapd_ubus_pending_free(p);
+		return -1;
+	}
+
+	p->complete = false;
+	p->nreq.status_cb = hostapd_ubus_pending_status;
+	p->nreq.complete_cb = hostapd_ubus_pending_complete;
+	ubus_complete_request_async(ctx, &p->nreq.req);
+	eloop_register_timeout(0, HOSTAPD_UBUS_RESPONSE_TIMEOUT * 1000,
+			       hostapd_ubus_pending_timeout, p, NULL);
+
+	return 0;
 }
 
 void hostapd_ubus_add_bss(struct hostapd_data *hapd)
@@ -1727,7 +3217,10 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 	if (asprintf(&name, "hostapd.%s", hapd->conf->iface) < 0)
 		return;
 
-	avl_init(&hapd->ubus.banned, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.verdicts, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.probes, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.clients, avl_compare_macaddr, false, NULL);
+	dl_list_init(&hapd->ubus.pending);
 	obj->name = name;
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
@@ -1754,6 +3247,26 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 	hostapd_send_shared_event(&hapd->iface->interfaces->ubus, hapd->conf->iface, "remove");
 
 	if (obj->id) {
+		struct hostapd_ubus_pending *p, *tmp_p;
+		struct ubus_client_verdict *v, *tmp_v;
+		struct ubus_client_state *cs, *tmp_cs;
+
+		dl_list_for_each_safe(p, tmp_p, &hapd->ubus.pending,
+				      struct hostapd_ubus_pending, list)
+			hostapd_ubus_pending_free(p);
+
+		eloop_cancel_timeout(hostapd_bss_purge_verdicts, hapd, NULL);
+		avl_remove_all_elements(&hapd->ubus.verdicts, v, avl, tmp_v)
+			free(v);
+		hapd->ubus.n_verdicts = 0;
+
+		hostapd_ubus_probe_clear(hapd);
+		hostapd_ubus_stats_stop(hapd);
+		hostapd_bss_free_bans(hapd);
+
+		avl_remove_all_elements(&hapd->ubus.clients, cs, avl, tmp_cs)
+			os_free(cs);
+
 		ubus_remove_object(ctx, obj);
 		hostapd_ubus_ref_dec();
 	}
@@ -1811,6 +3324,13 @@ void hostapd_ubus_add(struct hapd_interfaces *interfaces)
 	struct ubus_object *obj = &interfaces->ubus;
 	int ret;
 
+	/*
+	 * A process started with -U for the APs of a single radio must not
+	 * take over the "hostapd" object of the shared instance.
+	 */
+	if (interfaces->ubus_no_daemon_obj)
+		return;
+
 	if (!hostapd_ubus_init())
 		return;
 
@@ -1839,45 +3359,114 @@ void hostapd_ubus_free(struct hapd_interfaces *interfaces)
 	free(name);
 }
 
-struct ubus_event_req {
-	struct ubus_notify_request nreq;
-	int resp;
-};
+static void
+hostapd_ubus_event_verdict(struct hostapd_data *hapd, const u8 *addr,
+			   enum hostapd_ubus_event_type type, int resp)
+{
+	/*
+	 * Without waiting, a probe request cannot be refused after the fact,
+	 * so the refusal applies to the following ones until the subscribers
+	 * answer differently.
+	 */
+	if (hapd->ubus.notify_async && type == HOSTAPD_UBUS_PROBE_REQ && resp)
+		hostapd_bss_set_verdict(hapd, addr, BIT(type), resp, -1);
+	else
+		hostapd_bss_set_verdict(hapd, addr, BIT(type), resp,
+					hapd->ubus.verdict_timeout);
+}
 
 static void
-ubus_event_cb(struct ubus_notify_request *req, int idx, int ret)
+hostapd_ubus_event_done(struct hostapd_ubus_pending *p)
 {
-	struct ubus_event_req *ureq = container_of(req, struct ubus_event_req, nreq);
+	struct hostapd_data *hapd = p->hapd;
+	struct hostapd_frame_info fi = {};
+	struct sta_info *sta;
+
+	hostapd_ubus_event_verdict(hapd, p->addr, p->type, p->resp);
+
+	if (!p->len)
+		return;
+
+	/* the frame was dropped before, it must not be taken for a retry */
+	sta = ap_get_sta(hapd, p->addr);
+	if (sta)
+		sta->last_seq_ctrl = WLAN_INVALID_MGMT_SEQ;
+
+	fi.freq = hapd->iface->freq;
+	fi.ssi_signal = p->ssi_signal;
+
+	hapd->ubus.replay = p;
+	ieee802_11_mgmt(hapd, p->frame, p->len, &fi);
+	hapd->ubus.replay = NULL;
+}
+
+static bool
+hostapd_ubus_event_deferrable(struct hostapd_data *hapd,
+			      struct hostapd_ubus_request *req)
+{
+	if (!req->mgmt_frame || !req->frame_len)
+		return false;
+
+	if (req->type != HOSTAPD_UBUS_AUTH_REQ &&
+	    req->type != HOSTAPD_UBUS_ASSOC_REQ)
+		return false;
+
+#ifdef CONFIG_FILS
+	struct sta_info *sta;
+
+	/* the FILS key confirmation of an assoc request cannot be repeated */
+	sta = ap_get_sta(hapd, req->mgmt_frame->sa);
+	if (req->type == HOSTAPD_UBUS_ASSOC_REQ && sta &&
+	    (sta->auth_alg == WLAN_AUTH_FILS_SK ||
+	     sta->auth_alg == WLAN_AUTH_FILS_SK_PFS ||
+	     sta->auth_alg == WLAN_AUTH_FILS_PK))
+		return false;
+#endif
 
-	ureq->resp = ret;
+	return true;
 }
 
 int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req)
 {
-	struct ubus_banned_client *ban;
-	const char *types[HOSTAPD_UBUS_TYPE_MAX] = {
-		[HOSTAPD_UBUS_PROBE_REQ] = "probe",
-		[HOSTAPD_UBUS_AUTH_REQ] = "auth",
-		[HOSTAPD_UBUS_ASSOC_REQ] = "assoc",
-	};
+	struct hostapd_ubus_pending *p;
 	const char *type = "mgmt";
-	struct ubus_event_req ureq = {};
+	const u8 *frame = NULL;
 	const u8 *addr;
+	size_t len = 0;
+	int verdict;
+	int status;
 
 	if (req->mgmt_frame)
 		addr = req->mgmt_frame->sa;
 	else
 		addr = req->addr;
 
-	ban = avl_find_element(&hapd->ubus.banned, addr, ban, avl);
-	if (ban)
+	if (hostapd_bss_is_banned(hapd, addr))
 		return WLAN_STATUS_AP_UNABLE_TO_HANDLE_NEW_STA;
 
+	/* a deferred frame being processed again, with the answer it waited for */
+	p = hapd->ubus.replay;
+	if (p && p->type == req->type && !memcmp(p->addr, addr, ETH_ALEN))
+		return p->resp;
+
+	verdict = hostapd_bss_get_verdict(hapd, addr, req->type, &status);
+	/* a held answer only applies while the subscribers can change it */
+	if (verdict == HOSTAPD_UBUS_VERDICT_HELD &&
+	    (!hapd->ubus.obj.has_subscribers || !hapd->ubus.notify_response ||
+	     !hapd->ubus.notify_async || hapd->ubus.probe_coalesce > 0))
+		verdict = HOSTAPD_UBUS_VERDICT_NONE;
+	if (verdict == HOSTAPD_UBUS_VERDICT_NONE)
+		status = WLAN_STATUS_SUCCESS;
+
 	if (!hapd->ubus.obj.has_subscribers)
-		return WLAN_STATUS_SUCCESS;
+		return status;
+
+	if (req->type < ARRAY_SIZE(event_types))
+		type = event_types[req->type];
 
-	if (req->type < ARRAY_SIZE(types))
-		type = types[req->type];
+	if (req->type == HOSTAPD_UBUS_PROBE_REQ && hapd->ubus.probe_coalesce > 0 &&
+	    !hostapd_ubus_probe_coalesce(hapd, addr, req))
+		return status;
 
 	blob_buf_init(&b, 0);
 	blobmsg_add_macaddr(&b, "address", addr);
@@ -1887,62 +3476,52 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 		blobmsg_add_u32(&b, "signal", req->ssi_signal);
 	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
 
-	if (req->elems) {
-		if(req->elems->ht_capabilities)
-		{
-			struct ieee80211_ht_capabilities *ht_capabilities;
-			void *ht_cap, *ht_cap_mcs_set, *mcs_set;
-
-
-			ht_capabilities = (struct ieee80211_ht_capabilities*) req->elems->ht_capabilities;
-			ht_cap = blobmsg_open_table(&b, "ht_capabilities");
-			blobmsg_add_u16(&b, "ht_capabilities_info", ht_capabilities->ht_capabilities_info);
-			ht_cap_mcs_set = blobmsg_open_table(&b, "supported_mcs_set");
-			blobmsg_add_u16(&b, "a_mpdu_params", ht_capabilities->a_mpdu_params);
-			blobmsg_add_u16(&b, "ht_extended_capabilities", ht_capabilities->ht_extended_capabilities);
-			blobmsg_add_u32(&b, "tx_bf_capability_info", ht_capabilities->tx_bf_capability_info);
-			blobmsg_add_u16(&b, "asel_capabilities", ht_capabilities->asel_capabilities);
-			mcs_set = blobmsg_open_array(&b, "supported_mcs_set");
-			for (int i = 0; i < 16; i++) {
-				blobmsg_add_u16(&b, NULL, (u16) ht_capabilities->supported_mcs_set[i]);
-			}
-			blobmsg_close_array(&b, mcs_set);
-			blobmsg_close_table(&b, ht_cap_mcs_set);
-			blobmsg_close_table(&b, ht_cap);
-		}
-		if(req->elems->vht_capabilities)
-		{
-			struct ieee80211_vht_capabilities *vht_capabilities;
-			void *vht_cap, *vht_cap_mcs_set;
-
-			vht_capabilities = (struct ieee80211_vht_capabilities*) req->elems->vht_capabilities;
-			vht_cap = blobmsg_open_table(&b, "vht_capabilities");
-			blobmsg_add_u32(&b, "vht_capabilities_info", vht_capabilities->vht_capabilities_info);
-			vht_cap_mcs_set = blobmsg_open_table(&b, "vht_supported_mcs_set");
-			blobmsg_add_u16(&b, "rx_map", vht_capabilities->vht_supported_mcs_set.rx_map);
-			blobmsg_add_u16(&b, "rx_highest", vht_capabilities->vht_supported_mcs_set.rx_highest);
-			blobmsg_add_u16(&b, "tx_map", vht_capabilities->vht_supported_mcs_set.tx_map);
-			blobmsg_add_u16(&b, "tx_highest", vht_capabilities->vht_supported_mcs_set.tx_highest);
-			blobmsg_close_table(&b, vht_cap_mcs_set);
-			blobmsg_close_table(&b, vht_cap);
-		}
-	}
+	if (req->elems)
+		hostapd_ubus_add_capabilities(
+			(const struct ieee80211_ht_capabilities *) req->elems->ht_capabilities,
+			(const struct ieee80211_vht_capabilities *) req->elems->vht_capabilities);
 
-	if (!hapd->ubus.notify_response) {
-		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
-		return WLAN_STATUS_SUCCESS;
-	}
-
-	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
-		return WLAN_STATUS_SUCCESS;
+	if (verdict == HOSTAPD_UBUS_VERDICT_CACHED || !hapd->ubus.notify_response)
+		goto out;
 
-	ureq.nreq.status_cb = ubus_event_cb;
-	ubus_complete_request(ctx, &ureq.nreq.req, 100);
+	if (!hapd->ubus.notify_async)
+		goto wait;
 
-	if (ureq.resp)
-		return ureq.resp;
+	if (hostapd_ubus_event_deferrable(hapd, req)) {
+		frame = (const u8 *) req->mgmt_frame;
+		len = req->frame_len;
+	}
 
-	return WLAN_STATUS_SUCCESS;
+	/* the answer for an earlier frame of this client is still outstanding */
+	p = hostapd_ubus_pending_find(hapd, addr, req->type);
+	if (p)
+		return p->len ? HOSTAPD_UBUS_PENDING : status;
+
+	/*
+	 * Frames that cannot be processed again later, like probe requests,
+	 * are answered right away. The answer of the subscribers is only
+	 * used for the frames that follow. With too many answers outstanding,
+	 * hostapd waits for this one.
+	 */
+	p = hostapd_ubus_pending_add(hapd, addr, req->type, frame, len);
+	if (!p)
+		goto wait;
+
+	p->ssi_signal = req->ssi_signal;
+	p->done = hostapd_ubus_event_done;
+	if (hostapd_ubus_pending_send(p, type))
+		return status;
+
+	return len ? HOSTAPD_UBUS_PENDING : status;
+
+wait:
+	status = hostapd_ubus_notify_wait(hapd, type);
+	hostapd_ubus_event_verdict(hapd, addr, req->type, status);
+	return status;
+
+out:
+	ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
+	return status;
 }
 
 void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *addr)
@@ -2064,14 +3643,31 @@ void hostapd_ubus_notify_bss_transition_response(
 #endif
 }
 
+#ifdef CONFIG_WNM_AP
+static void
+hostapd_ubus_bss_transition_done(struct hostapd_ubus_pending *p)
+{
+	struct sta_info *sta;
+
+	if (p->resp)
+		return;
+
+	sta = ap_get_sta(p->hapd, p->addr);
+	if (!sta)
+		return;
+
+	/* same as ieee802_11_send_bss_trans_mgmt_request() */
+	wnm_send_bss_tm_req(p->hapd, sta, 0, 0, 1, NULL, p->dialog_token,
+			    NULL, NULL, 0, NULL, 0);
+}
+#endif
+
 int hostapd_ubus_notify_bss_transition_query(
 	struct hostapd_data *hapd, const u8 *addr, u8 dialog_token, u8 reason,
 	const u8 *candidate_list, u16 candidate_list_len)
 {
 #ifdef CONFIG_WNM_AP
-	struct ubus_event_req ureq = {};
-	char *cl_str;
-	u16 i;
+	struct hostapd_ubus_pending *p;
 
 	if (!hapd->ubus.obj.has_subscribers)
 		return 0;
@@ -2090,12 +3686,19 @@ int hostapd_ubus_notify_bss_transition_query(
 		return 0;
 	}
 
-	if (ubus_notify_async(ctx, &hapd->ubus.obj, "bss-transition-query", b.head, &ureq.nreq))
-		return 0;
+	if (!hapd->ubus.notify_async)
+		return hostapd_ubus_notify_wait(hapd, "bss-transition-query");
 
-	ureq.nreq.status_cb = ubus_event_cb;
-	ubus_complete_request(ctx, &ureq.nreq.req, 100);
+	p = hostapd_ubus_pending_add(hapd, addr, HOSTAPD_UBUS_TYPE_MAX, NULL, 0);
+	if (!p)
+		return hostapd_ubus_notify_wait(hapd, "bss-transition-query");
 
-	return ureq.resp;
+	p->dialog_token = dialog_token;
+	p->done = hostapd_ubus_bss_transition_done;
+	if (hostapd_ubus_pending_send(p, "bss-transition-query"))
+		return 0;
+
+	/* the default response is sent once the subscribers have declined */
+	return 1;
 #endif
 }
@@ -15,9 +15,17 @@ enum hostapd_ubus_event_type {
 	HOSTAPD_UBUS_TYPE_MAX
 };
 
+/*
+ * Returned by hostapd_ubus_handle_event() for an auth or assoc frame that
+ * was handed to the ubus subscribers. The frame must be dropped without a
+ * response; it is processed again once they have answered.
+ */
+#define HOSTAPD_UBUS_PENDING	-2
+
 struct hostapd_ubus_request {
 	enum hostapd_ubus_event_type type;
 	const struct ieee80211_mgmt *mgmt_frame;
+	size_t frame_len;
 	const struct ieee802_11_elems *elems;
 	int ssi_signal; /* dBm */
 	const u8 *addr;
@@ -33,10 +41,31 @@ struct rrm_measurement_beacon_report;
 #include <libubox/avl.h>
 #include <libubus.h>
 
+struct hostapd_ubus_pending;
+struct hostapd_ubus_bans;
+struct hostapd_stats_header;
+
 struct hostapd_ubus_bss {
 	struct ubus_object obj;
-	struct avl_tree banned;
+	struct hostapd_ubus_bans *bans;
+	struct avl_tree verdicts;
+	struct avl_tree probes;
+	struct avl_tree clients;
+	struct dl_list pending;
+	struct hostapd_ubus_pending *replay;
+	int n_pending;
+	int n_verdicts;
+	int n_probes;
+	int n_removed;
+	u32 client_gen;
+	u32 client_purged;
 	int notify_response;
+	int notify_async;
+	int verdict_timeout;
+	int probe_coalesce;
+	struct hostapd_stats_header *stats;
+	size_t stats_size;
+	int stats_interval;
 };
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface);
@@ -14,6 +14,8 @@
 #include "common/ieee802_11_defs.h"
 #include "wpa_supplicant_i.h"
 #include "wps_supplicant.h"
+#include "driver_i.h"
+#include "bss.h"
 #include "ubus.h"
 
 static struct ubus_context *ctx;
@@ -113,6 +115,181 @@ wpas_bss_reload(struct ubus_context *ctx, struct ubus_object *obj,
 		return 0;
 }
 
+static const char *
+wpas_ubus_mode_txt(struct wpa_ssid *ssid)
+{
+	switch (ssid->mode) {
+	case WPAS_MODE_INFRA:
+		return "sta";
+	case WPAS_MODE_IBSS:
+		return "adhoc";
+	case WPAS_MODE_MESH:
+		return "mesh";
+	default:
+		return "ap";
+	}
+}
+
+/* link polls the driver, leave it out where the caller must not block */
+static void
+wpas_ubus_add_status(struct wpa_supplicant *wpa_s, bool link)
+{
+	struct wpa_ssid *ssid = wpa_s->current_ssid;
+	struct wpa_signal_info si;
+	void *t;
+
+	blobmsg_add_string(&b, "state", wpa_supplicant_state_txt(wpa_s->wpa_state));
+	if (wpa_s->wpa_state < WPA_ASSOCIATED || !ssid)
+		return;
+
+	blobmsg_add_string(&b, "mode", wpas_ubus_mode_txt(ssid));
+	blobmsg_printf(&b, "bssid", MACSTR, MAC2STR(wpa_s->bssid));
+	blobmsg_add_string(&b, "ssid", wpa_ssid_txt(ssid->ssid, ssid->ssid_len));
+	blobmsg_add_u32(&b, "freq", wpa_s->assoc_freq);
+
+	if (!link || wpa_drv_signal_poll(wpa_s, &si))
+		return;
+
+	t = blobmsg_open_table(&b, "link");
+	blobmsg_add_u32(&b, "signal", si.data.signal);
+	if (si.data.avg_signal)
+		blobmsg_add_u32(&b, "avg_signal", si.data.avg_signal);
+	if (si.data.avg_beacon_signal)
+		blobmsg_add_u32(&b, "avg_beacon_signal", si.data.avg_beacon_signal);
+	if (si.current_noise != WPA_INVALID_NOISE)
+		blobmsg_add_u32(&b, "noise", si.current_noise);
+	blobmsg_add_u32(&b, "tx_rate", si.data.current_tx_rate);
+	blobmsg_close_table(&b, t);
+}
+
+/* with last_scan set, only the BSSes seen by the last scan are listed */
+static void
+wpas_ubus_add_bss_list(struct wpa_supplicant *wpa_s, bool last_scan)
+{
+	struct os_reltime now, age;
+	struct wpa_bss *bss;
+	void *a, *t;
+
+	os_get_reltime(&now);
+	a = blobmsg_open_array(&b, "bss");
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (last_scan && bss->last_update_idx != wpa_s->bss_update_idx)
+			continue;
+
+		t = blobmsg_open_table(&b, NULL);
+		blobmsg_printf(&b, "bssid", MACSTR, MAC2STR(bss->bssid));
+		blobmsg_add_string(&b, "ssid", wpa_ssid_txt(bss->ssid, bss->ssid_len));
+		blobmsg_add_u32(&b, "freq", bss->freq);
+		blobmsg_add_u32(&b, "signal", bss->level);
+		blobmsg_add_u32(&b, "snr", bss->snr);
+		blobmsg_add_u32(&b, "est_throughput", bss->est_throughput);
+		if (wpa_bss_get_ie(bss, WLAN_EID_MESH_ID))
+			blobmsg_add_u8(&b, "mesh", true);
+		if (!last_scan) {
+			os_reltime_sub(&now, &bss->last_update, &age);
+			blobmsg_add_u32(&b, "age", age.sec * 1000 + age.usec / 1000);
+		}
+		blobmsg_close_table(&b, t);
+	}
+	blobmsg_close_array(&b, a);
+}
+
+static int
+wpas_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
+		    struct ubus_request_data *req, const char *method,
+		    struct blob_attr *msg)
+{
+	struct wpa_supplicant *wpa_s = get_wpas_from_object(obj);
+
+	blob_buf_init(&b, 0);
+	wpas_ubus_add_status(wpa_s, true);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static int
+wpas_bss_get_scan_results(struct ubus_context *ctx, struct ubus_object *obj,
+			  struct ubus_request_data *req, const char *method,
+			  struct blob_attr *msg)
+{
+	struct wpa_supplicant *wpa_s = get_wpas_from_object(obj);
+
+	blob_buf_init(&b, 0);
+	wpas_ubus_add_bss_list(wpa_s, false);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static void wpas_ubus_status_timeout(void *eloop_data, void *user_ctx)
+{
+	struct wpa_supplicant *wpa_s = eloop_data;
+	int interval = wpa_s->ubus.status_interval;
+
+	if (!ctx || !interval || !wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	wpas_ubus_add_status(wpa_s, true);
+	ubus_notify(ctx, &wpa_s->ubus.obj, "status", b.head, -1);
+
+	eloop_register_timeout(interval / 1000, (interval % 1000) * 1000,
+			       wpas_ubus_status_timeout, wpa_s, NULL);
+}
+
+/* status notifications are only sent while the object has subscribers */
+static void wpas_ubus_status_schedule(struct wpa_supplicant *wpa_s)
+{
+	int interval = wpa_s->ubus.status_interval;
+
+	eloop_cancel_timeout(wpas_ubus_status_timeout, wpa_s, NULL);
+	if (!interval || !wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	eloop_register_timeout(interval / 1000, (interval % 1000) * 1000,
+			       wpas_ubus_status_timeout, wpa_s, NULL);
+}
+
+static void
+wpas_ubus_subscribe_cb(struct ubus_context *ctx, struct ubus_object *obj)
+{
+	wpas_ubus_status_schedule(get_wpas_from_object(obj));
+}
+
+enum {
+	STATUS_NOTIFY_INTERVAL,
+	__STATUS_NOTIFY_MAX
+};
+
+static const struct blobmsg_policy status_notify_policy[__STATUS_NOTIFY_MAX] = {
+	[STATUS_NOTIFY_INTERVAL] = { "interval", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+wpas_bss_status_notify(struct ubus_context *ctx, struct ubus_object *obj,
+		       struct ubus_request_data *req, const char *method,
+		       struct blob_attr *msg)
+{
+	struct wpa_supplicant *wpa_s = get_wpas_from_object(obj);
+	struct blob_attr *tb[__STATUS_NOTIFY_MAX];
+	int interval;
+
+	blobmsg_parse(status_notify_policy, __STATUS_NOTIFY_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (!tb[STATUS_NOTIFY_INTERVAL])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	interval = blobmsg_get_u32(tb[STATUS_NOTIFY_INTERVAL]);
+	if (interval && interval < 100)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	wpa_s->ubus.status_interval = interval;
+	wpas_ubus_status_schedule(wpa_s);
+
+	return 0;
+}
+
 #ifdef CONFIG_WPS
 enum {
 	WPS_START_MULTI_AP,
@@ -166,6 +343,9 @@ wpas_bss_wps_cancel(struct ubus_context *ctx, struct ubus_object *obj,
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", wpas_bss_reload),
 	UBUS_METHOD_NOARG("get_features", wpas_bss_get_features),
+	UBUS_METHOD_NOARG("get_status", wpas_bss_get_status),
+	UBUS_METHOD_NOARG("get_scan_results", wpas_bss_get_scan_results),
+	UBUS_METHOD("status_notify", wpas_bss_status_notify, status_notify_policy),
 #ifdef CONFIG_WPS
 	UBUS_METHOD_NOARG("wps_start", wpas_bss_wps_start),
 	UBUS_METHOD_NOARG("wps_cancel", wpas_bss_wps_cancel),
@@ -191,6 +371,7 @@ void wpas_ubus_add_bss(struct wpa_supplicant *wpa_s)
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
 	obj->n_methods = bss_object_type.n_methods;
+	obj->subscribe_cb = wpas_ubus_subscribe_cb;
 	ret = ubus_add_object(ctx, obj);
 	wpas_ubus_ref_inc();
 }
@@ -200,6 +381,8 @@ void wpas_ubus_free_bss(struct wpa_supplicant *wpa_s)
 	struct ubus_object *obj = &wpa_s->ubus.obj;
 	char *name = (char *) obj->name;
 
+	eloop_cancel_timeout(wpas_ubus_status_timeout, wpa_s, NULL);
+
 	if (!ctx)
 		return;
 
@@ -356,6 +539,28 @@ void wpas_ubus_free(struct wpa_global *global)
 	free(name);
 }
 
+void wpas_ubus_notify_scan_results(struct wpa_supplicant *wpa_s)
+{
+	if (!ctx || !wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	wpas_ubus_add_bss_list(wpa_s, true);
+	ubus_notify(ctx, &wpa_s->ubus.obj, "scan-results", b.head, -1);
+}
+
+void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+			    enum wpa_states new_state,
+			    enum wpa_states old_state)
+{
+	if (!ctx || !wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_string(&b, "old_state", wpa_supplicant_state_txt(old_state));
+	wpas_ubus_add_status(wpa_s, false);
+	ubus_notify(ctx, &wpa_s->ubus.obj, "state", b.head, -1);
+}
 
 #ifdef CONFIG_WPS
 void wpas_ubus_notify(struct wpa_supplicant *wpa_s, const struct wps_credential *cred)
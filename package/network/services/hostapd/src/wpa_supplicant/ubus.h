@@ -12,6 +12,7 @@
 struct wpa_supplicant;
 struct wpa_global;
 
+#include "common/defs.h"
 #include "wps_supplicant.h"
 
 #ifdef UBUS_SUPPORT
@@ -19,11 +20,17 @@ struct wpa_global;
 
 struct wpas_ubus_bss {
 	struct ubus_object obj;
+	int status_interval;
 };
 
 void wpas_ubus_add_bss(struct wpa_supplicant *wpa_s);
 void wpas_ubus_free_bss(struct wpa_supplicant *wpa_s);
 
+void wpas_ubus_notify_scan_results(struct wpa_supplicant *wpa_s);
+void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+			    enum wpa_states new_state,
+			    enum wpa_states old_state);
+
 void wpas_ubus_add(struct wpa_global *global);
 void wpas_ubus_free(struct wpa_global *global);
 
@@ -50,6 +57,16 @@ static inline void wpas_ubus_free_bss(struct wpa_supplicant *wpa_s)
 {
 }
 
+static inline void wpas_ubus_notify_scan_results(struct wpa_supplicant *wpa_s)
+{
+}
+
+static inline void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+					  enum wpa_states new_state,
+					  enum wpa_states old_state)
+{
+}
+
 static inline void wpas_ubus_notify(struct wpa_supplicant *wpa_s, struct wps_credential *cred)
 {
 }
@@ -0,0 +1,246 @@
+/*
+ * Checks the ubus ban table of src/src/ap/ubus.c against a simulated eloop
+ * and compares its cost with one eloop timeout per ban, as used before.
+ *
+ *   ban-bench [bans] [operations]
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "eloop-sim.h"
+#include "bans.inc"
+
+/* one eloop timeout per ban, as before the timer wheel */
+struct legacy_ban {
+	struct dl_list hash;
+	u8 addr[ETH_ALEN];
+};
+
+static struct dl_list legacy_hash[HOSTAPD_UBUS_BAN_HASH];
+
+static struct legacy_ban *
+legacy_find_ban(const u8 *addr)
+{
+	struct legacy_ban *ban;
+
+	dl_list_for_each(ban, &legacy_hash[hostapd_bss_ban_hash(addr)],
+			 struct legacy_ban, hash)
+		if (!memcmp(ban->addr, addr, ETH_ALEN))
+			return ban;
+
+	return NULL;
+}
+
+static void
+legacy_del_ban(void *eloop_data, void *user_ctx)
+{
+	struct legacy_ban *ban = eloop_data;
+
+	dl_list_del(&ban->hash);
+	free(ban);
+}
+
+static void
+legacy_ban_client(struct hostapd_data *hapd, const u8 *addr, int time)
+{
+	struct legacy_ban *ban;
+
+	ban = legacy_find_ban(addr);
+	if (!ban) {
+		if (!time)
+			return;
+
+		ban = calloc(1, sizeof(*ban));
+		memcpy(ban->addr, addr, sizeof(ban->addr));
+		dl_list_add(&legacy_hash[hostapd_bss_ban_hash(addr)], &ban->hash);
+	} else {
+		eloop_cancel_timeout(legacy_del_ban, ban, hapd);
+		if (!time) {
+			legacy_del_ban(ban, hapd);
+			return;
+		}
+	}
+
+	eloop_register_timeout(0, time * 1000, legacy_del_ban, ban, hapd);
+}
+
+static unsigned int rnd_state = 1;
+
+static unsigned int
+rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return rnd_state >> 8;
+}
+
+static void
+make_addr(u8 *addr, unsigned int i)
+{
+	addr[0] = 0x02;
+	addr[1] = 0x00;
+	addr[2] = i >> 24;
+	addr[3] = i >> 16;
+	addr[4] = i >> 8;
+	addr[5] = i;
+}
+
+static double
+elapsed_ms(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e3 +
+	       (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static int errors;
+
+#define check(cond, ...) do {					\
+	if (!(cond)) {						\
+		fprintf(stderr, "FAIL: " __VA_ARGS__);		\
+		fputc('\n', stderr);				\
+		errors++;					\
+	}							\
+} while (0)
+
+static void
+test_expiry(struct hostapd_data *hapd)
+{
+	u8 addr[ETH_ALEN];
+	u64 start = sim_now;
+	unsigned int i;
+	int step;
+
+	for (i = 0; i < 1000; i++) {
+		make_addr(addr, i);
+		hostapd_bss_ban_client(hapd, addr, 50 + i * 37);
+	}
+
+	for (step = 0; step < 500; step++) {
+		sim_run(sim_now + 97);
+		for (i = 0; i < 1000; i++) {
+			struct ubus_banned_client *ban;
+			u64 expire = start + 50 + i * 37;
+
+			make_addr(addr, i);
+			check(hostapd_bss_is_banned(hapd, addr) == (expire > sim_now),
+			      "ban %u at %llu", i, (unsigned long long) sim_now);
+			ban = hostapd_bss_find_ban(hapd, addr);
+			check(!ban || sim_now < expire + 2 * HOSTAPD_UBUS_BAN_TICK,
+			      "ban %u not removed", i);
+		}
+		check(sim_count_timeouts(hostapd_bss_ban_tick) ==
+		      !!hapd->ubus.bans->n_bans, "tick count at %d", step);
+	}
+
+	check(!hapd->ubus.bans->n_bans, "%d bans left", hapd->ubus.bans->n_bans);
+}
+
+/* ban, unban and ban again must not leave a second tick behind */
+static void
+test_reban(struct hostapd_data *hapd)
+{
+	u8 addr[ETH_ALEN];
+	int i;
+
+	make_addr(addr, 1);
+	for (i = 0; i < 100; i++) {
+		hostapd_bss_ban_client(hapd, addr, 1000);
+		hostapd_bss_ban_client(hapd, addr, 0);
+		check(!sim_count_timeouts(hostapd_bss_ban_tick),
+		      "tick left after unban");
+		hostapd_bss_ban_client(hapd, addr, 1000);
+		check(sim_count_timeouts(hostapd_bss_ban_tick) == 1,
+		      "%d ticks registered",
+		      sim_count_timeouts(hostapd_bss_ban_tick));
+		sim_run(sim_now + 30);
+		hostapd_bss_ban_client(hapd, addr, 0);
+	}
+	check(!hostapd_bss_is_banned(hapd, addr), "still banned");
+
+	hostapd_bss_ban_client(hapd, addr, 100000);
+	sim_run(sim_now + 10000000);
+	check(!hapd->ubus.bans->n_bans, "ban survived a long stall");
+	check(!sim_count_timeouts(hostapd_bss_ban_tick), "tick left after stall");
+}
+
+struct bench {
+	unsigned long steps;
+	double ms;
+};
+
+static void
+run_bench(struct hostapd_data *hapd, bool legacy, int n_bans, int n_ops,
+	  struct bench *res)
+{
+	struct timespec start;
+	u8 addr[ETH_ALEN];
+	unsigned long steps;
+	int i;
+
+	rnd_state = 1;
+	sim_now = 1000000;
+	for (i = 0; i < n_bans; i++) {
+		make_addr(addr, i);
+		if (legacy)
+			legacy_ban_client(hapd, addr, 30000 + rnd() % 30000);
+		else
+			hostapd_bss_ban_client(hapd, addr, 30000 + rnd() % 30000);
+	}
+
+	/* ban, extend and unban random clients, 2 ms of eloop time apart */
+	steps = sim_steps;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n_ops; i++) {
+		int time = rnd() % 4 ? 30000 + rnd() % 30000 : 0;
+
+		make_addr(addr, rnd() % (2 * n_bans));
+		if (legacy)
+			legacy_ban_client(hapd, addr, time);
+		else
+			hostapd_bss_ban_client(hapd, addr, time);
+		sim_run(sim_now + 2);
+	}
+	res->ms = elapsed_ms(&start);
+	res->steps = sim_steps - steps;
+
+	/* let everything expire */
+	sim_run(sim_now + 120000);
+	if (!legacy)
+		hostapd_bss_free_bans(hapd);
+}
+
+int main(int argc, char **argv)
+{
+	struct hostapd_data hapd = {};
+	struct bench wheel, legacy;
+	int n_bans = argc > 1 ? atoi(argv[1]) : 1000;
+	int n_ops = argc > 2 ? atoi(argv[2]) : 100000;
+	int i;
+
+	for (i = 0; i < HOSTAPD_UBUS_BAN_HASH; i++)
+		dl_list_init(&legacy_hash[i]);
+
+	sim_now = 123456;
+	test_expiry(&hapd);
+	test_reban(&hapd);
+	hostapd_bss_free_bans(&hapd);
+	check(!hapd.ubus.bans, "bans not freed");
+	check(!sim_n_timeouts, "%d timeouts left", sim_n_timeouts);
+	if (errors) {
+		fprintf(stderr, "%d errors\n", errors);
+		return 1;
+	}
+
+	run_bench(&hapd, false, n_bans, n_ops, &wheel);
+	run_bench(&hapd, true, n_bans, n_ops, &legacy);
+	check(!sim_n_timeouts, "%d timeouts left", sim_n_timeouts);
+
+	printf("%d bans, %d operations\n", n_bans, n_ops);
+	printf("%-14s %14s %10s\n", "", "eloop steps", "ms");
+	printf("%-14s %14lu %10.1f\n", "timer wheel", wheel.steps, wheel.ms);
+	printf("%-14s %14lu %10.1f\n", "timeout/ban", legacy.steps, legacy.ms);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#!/bin/sh
+#
+# Check that a config reload leaves the stations of unchanged BSSes
+# connected.
+#
+#   bss-reload.sh
+#
+# Runs on a device or VM with kmod-mac80211-hwsim, hostapd, hostapd_cli,
+# wpa_supplicant and wpa_cli, with the wireless config stopped ("wifi
+# down"). One radio runs two BSSes, "keep" and "change", with a station
+# connected to each. The config is then rewritten the way hostapd.sh
+# does it: the key of "change" and with it its config_id changes, "keep"
+# only gets hidden, which stays out of its config_id. After hostapd is
+# told to reload (SIGHUP), the station of "keep" must still be connected
+# without a new association, the one of "change" must be disconnected,
+# and a scan must no longer show the SSID of "keep".
+
+dir=/tmp/bss-reload
+wait_time=5
+failed=
+
+cleanup() {
+	for pid in $(cat "$dir"/*.pid 2>/dev/null); do
+		kill "$pid" 2>/dev/null
+	done
+	sleep 1
+	rmmod mac80211_hwsim 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT INT TERM
+
+rm -rf "$dir"
+mkdir -p "$dir"
+
+before="$(ls /sys/class/ieee80211)"
+modprobe mac80211_hwsim radios=4 || exit 1
+sleep 1
+phys=
+for phy in $(ls /sys/class/ieee80211); do
+	case " $before " in
+		*" $phy "*) ;;
+		*) phys="$phys $phy";;
+	esac
+done
+set -- $phys
+[ $# -eq 4 ] || {
+	echo "expected 4 hwsim radios, found $#" >&2
+	exit 1
+}
+
+ap_conf() {
+	local change_key="$1" hidden="$2"
+
+	cat > "$dir/ap.conf" <<EOF
+interface=ap0
+driver=nl80211
+ctrl_interface=$dir/hostapd
+hw_mode=g
+channel=1
+radio_config_id=radio-1
+ssid=keep
+wpa=2
+wpa_key_mgmt=WPA-PSK
+rsn_pairwise=CCMP
+wpa_passphrase=keep-password
+config_id=keep-1
+ignore_broadcast_ssid=$hidden
+
+bss=ap0-1
+bssid=02:00:00:aa:00:01
+ctrl_interface=$dir/hostapd
+ssid=change
+wpa=2
+wpa_key_mgmt=WPA-PSK
+rsn_pairwise=CCMP
+wpa_passphrase=$change_key
+config_id=change-$change_key
+ignore_broadcast_ssid=0
+EOF
+}
+
+sta_conf() {
+	local sta="$1" ssid="$2" key="$3"
+
+	cat > "$dir/$sta.conf" <<EOF
+ctrl_interface=$dir/wpa_supplicant
+network={
+	ssid="$ssid"
+	key_mgmt=WPA-PSK
+	psk="$key"
+	scan_freq=2412
+}
+EOF
+}
+
+iw phy "$1" interface add ap0 type managed || exit 1
+iw phy "$2" interface add sta0 type managed || exit 1
+iw phy "$3" interface add sta1 type managed || exit 1
+iw phy "$4" interface add sta2 type managed || exit 1
+ip link set sta2 up || exit 1
+
+ap_conf old-password 0
+hostapd -B -P "$dir/hostapd.pid" "$dir/ap.conf" || exit 1
+sleep 2
+
+sta_conf sta0 keep keep-password
+sta_conf sta1 change old-password
+for sta in sta0 sta1; do
+	wpa_supplicant -B -i "$sta" -c "$dir/$sta.conf" -P "$dir/$sta.pid" || exit 1
+done
+sleep "$wait_time"
+
+sta_state() {
+	wpa_cli -p "$dir/wpa_supplicant" -i "$1" status | sed -n 's/^wpa_state=//p'
+}
+
+# seconds the AP has this station associated, empty if it has not
+connected_time() {
+	local iface="$1" sta="$2" addr
+
+	addr="$(cat "/sys/class/net/$sta/address")"
+	hostapd_cli -p "$dir/hostapd" -i "$iface" sta "$addr" | \
+		sed -n 's/^connected_time=//p'
+}
+
+check() {
+	if eval "$2"; then
+		echo "ok      $1"
+	else
+		echo "FAILED  $1"
+		failed=1
+	fi
+}
+
+for sta in sta0 sta1; do
+	[ "$(sta_state "$sta")" = COMPLETED ] || {
+		echo "$sta did not connect" >&2
+		exit 1
+	}
+done
+keep_time="$(connected_time ap0 sta0)"
+
+ap_conf new-password 1
+kill -HUP "$(cat "$dir/hostapd.pid")"
+sleep "$wait_time"
+
+new_time="$(connected_time ap0 sta0)"
+check "station of the unchanged BSS stays connected" \
+	'[ "$(sta_state sta0)" = COMPLETED ]'
+check "station of the unchanged BSS was not associated again" \
+	'[ -n "$new_time" ] && [ "$new_time" -ge $((keep_time + wait_time)) ]'
+check "station of the changed BSS was disconnected" \
+	'[ -z "$(connected_time ap0-1 sta1)" ]'
+check "beacon of the unchanged BSS hides its SSID" \
+	'! iw dev sta2 scan flush freq 2412 | grep -q "SSID: keep\$"'
+
+[ -z "$failed" ]
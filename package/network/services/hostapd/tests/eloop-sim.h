@@ -0,0 +1,207 @@
+/*
+ * Host-side stand-ins for the parts of hostapd used by the extracted ubus
+ * code. The eloop timeouts are kept in a list sorted by expiry, like in
+ * src/utils/eloop.c, and every list node that is visited is counted, so
+ * that the cost of the eloop side can be compared independent of the host.
+ */
+#ifndef ELOOP_SIM_H
+#define ELOOP_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint64_t u64;
+typedef uint32_t u32;
+typedef uint8_t u8;
+typedef long os_time_t;
+
+#define ETH_ALEN 6
+
+#define os_zalloc(size) calloc(1, size)
+#define os_free free
+
+struct dl_list {
+	struct dl_list *next;
+	struct dl_list *prev;
+};
+
+static inline void dl_list_init(struct dl_list *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void dl_list_add(struct dl_list *list, struct dl_list *item)
+{
+	item->next = list->next;
+	item->prev = list;
+	list->next->prev = item;
+	list->next = item;
+}
+
+static inline void dl_list_add_tail(struct dl_list *list, struct dl_list *item)
+{
+	dl_list_add(list->prev, item);
+}
+
+static inline void dl_list_del(struct dl_list *item)
+{
+	item->next->prev = item->prev;
+	item->prev->next = item->next;
+	item->next = NULL;
+	item->prev = NULL;
+}
+
+static inline int dl_list_empty(struct dl_list *list)
+{
+	return list->next == list;
+}
+
+#define dl_list_entry(item, type, member) \
+	((type *) ((char *) item - offsetof(type, member)))
+
+#define dl_list_for_each(item, list, type, member) \
+	for (item = dl_list_entry((list)->next, type, member); \
+	     &item->member != (list); \
+	     item = dl_list_entry(item->member.next, type, member))
+
+#define dl_list_for_each_safe(item, n, list, type, member) \
+	for (item = dl_list_entry((list)->next, type, member), \
+		     n = dl_list_entry(item->member.next, type, member); \
+	     &item->member != (list); \
+	     item = n, n = dl_list_entry(n->member.next, type, member))
+
+struct os_reltime {
+	os_time_t sec;
+	os_time_t usec;
+};
+
+/* simulated monotonic clock in ms */
+static u64 sim_now;
+
+static inline void os_get_reltime(struct os_reltime *t)
+{
+	t->sec = sim_now / 1000;
+	t->usec = (sim_now % 1000) * 1000;
+}
+
+struct hostapd_ubus_bans;
+
+struct hostapd_data {
+	struct {
+		struct hostapd_ubus_bans *bans;
+	} ubus;
+};
+
+typedef void (*eloop_timeout_handler)(void *eloop_data, void *user_ctx);
+
+struct sim_timeout {
+	struct dl_list list;
+	u64 expire;
+	eloop_timeout_handler handler;
+	void *eloop_data;
+	void *user_data;
+};
+
+static struct dl_list sim_timeouts = { &sim_timeouts, &sim_timeouts };
+static unsigned long sim_steps;
+static int sim_n_timeouts;
+
+static inline int eloop_register_timeout(unsigned int secs, unsigned int usecs,
+					 eloop_timeout_handler handler,
+					 void *eloop_data, void *user_data)
+{
+	struct sim_timeout *t, *tmp;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return -1;
+
+	t->expire = sim_now + secs * 1000 + usecs / 1000;
+	t->handler = handler;
+	t->eloop_data = eloop_data;
+	t->user_data = user_data;
+	sim_n_timeouts++;
+
+	dl_list_for_each(tmp, &sim_timeouts, struct sim_timeout, list) {
+		sim_steps++;
+		if (t->expire < tmp->expire) {
+			dl_list_add(tmp->list.prev, &t->list);
+			return 0;
+		}
+	}
+	dl_list_add_tail(&sim_timeouts, &t->list);
+
+	return 0;
+}
+
+static inline int eloop_cancel_timeout(eloop_timeout_handler handler,
+				       void *eloop_data, void *user_data)
+{
+	struct sim_timeout *t, *tmp;
+	int removed = 0;
+
+	dl_list_for_each_safe(t, tmp, &sim_timeouts, struct sim_timeout, list) {
+		sim_steps++;
+		if (t->handler == handler && t->eloop_data == eloop_data &&
+		    t->user_data == user_data) {
+			dl_list_del(&t->list);
+			free(t);
+			sim_n_timeouts--;
+			removed++;
+		}
+	}
+
+	return removed;
+}
+
+static inline int eloop_is_timeout_registered(eloop_timeout_handler handler,
+					      void *eloop_data, void *user_data)
+{
+	struct sim_timeout *t;
+
+	dl_list_for_each(t, &sim_timeouts, struct sim_timeout, list)
+		if (t->handler == handler && t->eloop_data == eloop_data &&
+		    t->user_data == user_data)
+			return 1;
+
+	return 0;
+}
+
+/* count the registered timeouts of one handler */
+static inline int sim_count_timeouts(eloop_timeout_handler handler)
+{
+	struct sim_timeout *t;
+	int n = 0;
+
+	dl_list_for_each(t, &sim_timeouts, struct sim_timeout, list)
+		if (t->handler == handler)
+			n++;
+
+	return n;
+}
+
+/* advance the clock, running all timeouts that expire on the way */
+static inline void sim_run(u64 until)
+{
+	struct sim_timeout *t;
+
+	while (!dl_list_empty(&sim_timeouts)) {
+		t = dl_list_entry(sim_timeouts.next, struct sim_timeout, list);
+		if (t->expire > until)
+			break;
+
+		if (t->expire > sim_now)
+			sim_now = t->expire;
+		dl_list_del(&t->list);
+		sim_n_timeouts--;
+		t->handler(t->eloop_data, t->user_data);
+		free(t);
+	}
+	sim_now = until;
+}
+
+#endif /* ELOOP_SIM_H */
@@ -0,0 +1,41 @@
+# Copy definitions out of a C file so that they can be built on the host
+# without the rest of hostapd.
+#
+#   awk -v defines="PREFIX_" -v structs="a b" -v funcs="c d" -f extract.awk file.c
+#
+# Macros are matched by prefix, structs and functions by name. Functions
+# have to use the "static type\nname(" layout of the ubus code.
+
+BEGIN {
+	n = split(structs, list, " ")
+	for (i = 1; i <= n; i++)
+		want_struct[list[i]] = 1
+	n = split(funcs, list, " ")
+	for (i = 1; i <= n; i++)
+		want_func[list[i]] = 1
+}
+
+!copy && defines != "" && /^#define / && index($2, defines) == 1 {
+	print
+}
+
+!copy && /^struct [a-z0-9_]+ \{$/ && ($2 in want_struct) {
+	copy = 1
+}
+
+!copy && /^[a-z0-9_]+\(/ && (substr($0, 1, index($0, "(") - 1) in want_func) {
+	print prev
+	copy = 1
+}
+
+copy {
+	print
+	if (/^}/) {
+		print ""
+		copy = 0
+	}
+}
+
+{
+	prev = $0
+}
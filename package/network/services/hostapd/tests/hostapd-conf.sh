@@ -0,0 +1,231 @@
+#!/usr/bin/env bash
+#
+# Run the config generators of files/hostapd.sh for the cases in
+# hostapd-conf/ and compare the result with the golden *.conf files.
+#
+#   hostapd-conf.sh [-u] [-b <runs>] [hostapd.sh]
+#
+#   -u         update the golden files instead of comparing
+#   -b <runs>  also time <runs> runs of every case
+#
+# A case is a shell snippet setting the globals of the generator (ifname,
+# macaddr, ...) and the wireless config with "cfg <name> <value>...", where
+# more than one value makes a list. Cases named sta-* run
+# wpa_supplicant_add_network, the others hostapd_set_bss_options.
+#
+# The generator runs under bash with stand-ins for jshn and the netifd
+# helpers. Paths written by the generator must be pointed at /dev/null by
+# the case.
+
+dir="$(cd "$(dirname "$0")" && pwd)"
+update=
+runs=0
+
+while getopts "ub:" opt; do
+	case "$opt" in
+		u) update=1;;
+		b) runs="$OPTARG";;
+		*) exit 2;;
+	esac
+done
+shift $((OPTIND - 1))
+script="${1:-$dir/../files/hostapd.sh}"
+functions="$dir/../../../../base-files/files/lib/functions.sh"
+
+cfg() {
+	local name="$1"; shift
+	cfg_names="$cfg_names $name"
+	eval "cfg_n_$name=$#"
+	local i=0
+	for val in "$@"; do
+		i=$((i + 1))
+		eval "cfg_${name}_$i=\"\$val\""
+	done
+}
+
+json_get_var() {
+	local n
+	eval "n=\"\$cfg_n_$2\""
+	if [ -n "$n" ]; then
+		eval "$1=\"\$cfg_$2_1\""
+	else
+		eval "$1=\"\$3\""
+	fi
+}
+
+json_get_vars() {
+	local var def
+	for var in "$@"; do
+		def="${var#*:}"
+		[ "$def" = "$var" ] && def=
+		json_get_var "${var%%:*}" "${var%%:*}" "$def"
+	done
+}
+
+json_get_values() {
+	local n i val ret=
+	eval "n=\"\${cfg_n_$2:-0}\""
+	i=0
+	while [ $i -lt $n ]; do
+		i=$((i + 1))
+		eval "val=\"\$cfg_$2_$i\""
+		ret="${ret:+$ret }$val"
+	done
+	eval "$1=\"\$ret\""
+}
+
+json_for_each_item() {
+	local fn="$1" name="$2" n i val
+	shift 2
+	eval "n=\"\${cfg_n_$name:-0}\""
+	i=0
+	while [ $i -lt $n ]; do
+		i=$((i + 1))
+		eval "val=\"\$cfg_${name}_$i\""
+		"$fn" "$val" "$i" "$@"
+	done
+}
+
+set_default() {
+	eval "export -- \"$1=\${$1:-\$2}\""
+}
+
+prepare_key_wep() {
+	echo "$1"
+}
+
+wireless_setup_vif_failed() {
+	echo "vif failed: $1"
+}
+
+/usr/sbin/hostapd() {
+	return 0
+}
+
+# from netifd-wireless.sh
+wireless_vif_parse_encryption() {
+	json_get_vars encryption
+	set_default encryption none
+
+	auth_mode_open=1
+	auth_mode_shared=0
+	auth_type=none
+
+	if [ "$hwmode" = "ad" ]; then
+		wpa_cipher="GCMP"
+	else
+		wpa_cipher="CCMP"
+	fi
+
+	case "$encryption" in
+		*tkip+aes|*tkip+ccmp|*aes+tkip|*ccmp+tkip) wpa_cipher="CCMP TKIP";;
+		*ccmp256) wpa_cipher="CCMP-256";;
+		*aes|*ccmp) wpa_cipher="CCMP";;
+		*tkip) wpa_cipher="TKIP";;
+		*gcmp256) wpa_cipher="GCMP-256";;
+		*gcmp) wpa_cipher="GCMP";;
+	esac
+
+	case "$encryption" in
+		wpa2*|wpa3*|*psk2*|psk3*|sae*|owe*)
+			wpa=2
+		;;
+		wpa*mixed*|*psk*mixed*)
+			wpa=3
+		;;
+		wpa*|*psk*)
+			wpa=1
+		;;
+		*)
+			wpa=0
+			wpa_cipher=
+		;;
+	esac
+	wpa_pairwise="$wpa_cipher"
+
+	case "$encryption" in
+		owe*)
+			auth_type=owe
+		;;
+		wpa3-mixed*)
+			auth_type=eap-eap2
+		;;
+		wpa3-192*)
+			auth_type=eap192
+		;;
+		wpa3*)
+			auth_type=eap2
+		;;
+		psk3-mixed*|sae-mixed*)
+			auth_type=psk-sae
+		;;
+		psk3*|sae*)
+			auth_type=sae
+		;;
+		*psk*)
+			auth_type=psk
+		;;
+		*wpa*|*8021x*)
+			auth_type=eap
+		;;
+		*wep*)
+			auth_type=wep
+		;;
+	esac
+}
+
+. "$functions"
+. <(sed -e '/^\. \/lib\//d' "$script")
+
+_wpa_supplicant_common() {
+	_rpath=/dev/null
+	_config=/dev/stdout
+}
+
+run_case() {
+	local name="$1" out
+
+	(
+		cfg_names=
+		. "$dir/hostapd-conf/$name.case"
+		case "$name" in
+			sta-*)
+				wpa_supplicant_add_network "$ifname" "$freq" "$htmode" "$noscan"
+			;;
+			*)
+				hostapd_set_bss_options out "$phy" "$vif"
+				echo "$out"
+			;;
+		esac
+	)
+}
+
+# the generator expands unquoted config lines, keep globs from matching
+empty="$(mktemp -d)"
+trap 'rmdir "$empty"' EXIT
+cd "$empty" || exit 1
+
+ret=0
+for case in "$dir"/hostapd-conf/*.case; do
+	name="$(basename "$case" .case)"
+	golden="$dir/hostapd-conf/$name.conf"
+
+	if [ -n "$update" ]; then
+		run_case "$name" > "$golden"
+	elif ! run_case "$name" | diff -u "$golden" - > /dev/null; then
+		echo "FAIL: $name"
+		run_case "$name" | diff -u "$golden" -
+		ret=1
+		continue
+	fi
+
+	[ "$runs" -gt 0 ] || continue
+	start=$(date +%s%N)
+	for i in $(seq 1 $runs); do
+		run_case "$name" > /dev/null
+	done
+	end=$(date +%s%N)
+	printf "%-20s %8d us/run\n" "$name" $(((end - start) / 1000 / runs))
+done
+
+exit $ret
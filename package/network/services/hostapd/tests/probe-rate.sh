@@ -0,0 +1,144 @@
+#!/bin/sh
+#
+# Measure how notify_response affects hostapd while its subscriber stalls
+# and stations keep sending probe requests.
+#
+#   probe-rate.sh [-n <stations>] [-t <seconds>]
+#
+#   -n  number of scanning stations (default 8)
+#   -t  duration of each mode (default 20)
+#
+# Runs on a device or VM with kmod-mac80211-hwsim, ubusd, the ubus cli,
+# hostapd with ubus support and hostapd_cli, with the wireless config
+# stopped ("wifi down"). The modes are notify_response disabled, enabled
+# (hostapd waits for the answers) and enabled with "async". The subscriber
+# is a "ubus subscribe" stopped with SIGSTOP, so no notification is ever
+# answered. For each mode, the script reports the round trip time of
+# "hostapd_cli ping", which is answered from the event loop, and how many
+# of the scans of the stations found the AP.
+
+stations=8
+duration=20
+dir=/tmp/probe-rate
+ssid=probe-rate
+
+while getopts "n:t:" opt; do
+	case "$opt" in
+		n) stations="$OPTARG";;
+		t) duration="$OPTARG";;
+		*) exit 2;;
+	esac
+done
+
+cleanup() {
+	for pid in $(cat "$dir"/*.pid 2>/dev/null); do
+		kill -CONT "$pid" 2>/dev/null
+		kill "$pid" 2>/dev/null
+	done
+	sleep 1
+	rmmod mac80211_hwsim 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT INT TERM
+
+rm -rf "$dir"
+mkdir -p "$dir"
+
+before="$(ls /sys/class/ieee80211)"
+modprobe mac80211_hwsim radios=$((stations + 1)) || exit 1
+sleep 1
+phys=
+for phy in $(ls /sys/class/ieee80211); do
+	case " $before " in
+		*" $phy "*) ;;
+		*) phys="$phys $phy";;
+	esac
+done
+set -- $phys
+[ $# -eq $((stations + 1)) ] || {
+	echo "expected $((stations + 1)) hwsim radios, found $#" >&2
+	exit 1
+}
+
+iw phy "$1" interface add ap0 type managed || exit 1
+shift
+cat > "$dir/ap0.conf" <<EOF
+interface=ap0
+driver=nl80211
+ctrl_interface=$dir/hostapd
+hw_mode=g
+channel=1
+ssid=$ssid
+EOF
+
+hostapd -B -P "$dir/hostapd.pid" "$dir/ap0.conf" || exit 1
+sleep 2
+ubus -t 5 wait_for hostapd.ap0 || exit 1
+
+i=0
+for phy in "$@"; do
+	iw phy "$phy" interface add "sta$i" type managed || exit 1
+	ip link set "sta$i" up || exit 1
+	i=$((i + 1))
+done
+
+ubus subscribe hostapd.ap0 > /dev/null &
+echo $! > "$dir/subscriber.pid"
+sleep 1
+kill -STOP "$(cat "$dir/subscriber.pid")"
+
+ping_ms() {
+	local start end
+
+	start=$(date +%s%N)
+	hostapd_cli -p "$dir/hostapd" -i ap0 ping > /dev/null || return 1
+	end=$(date +%s%N)
+	echo $(((end - start) / 1000000))
+}
+
+scan_loop() {
+	local sta="$1" end="$2" scans=0 found=0
+
+	while [ "$(date +%s)" -lt "$end" ]; do
+		scans=$((scans + 1))
+		iw dev "$sta" scan flush freq 2412 ssid "$ssid" 2>/dev/null | \
+			grep -q "SSID: $ssid\$" && found=$((found + 1))
+	done
+	echo "$scans $found" > "$dir/$sta.scans"
+}
+
+measure() {
+	local label="$1" n=0 sum=0 max=0 ms end i s f file pids= scans=0 found=0
+
+	end=$(($(date +%s) + duration))
+	i=0
+	while [ "$i" -lt "$stations" ]; do
+		scan_loop "sta$i" "$end" &
+		pids="$pids $!"
+		i=$((i + 1))
+	done
+	while [ "$(date +%s)" -lt "$end" ]; do
+		ms="$(ping_ms)" || continue
+		n=$((n + 1))
+		sum=$((sum + ms))
+		[ "$ms" -gt "$max" ] && max="$ms"
+		sleep 0.1
+	done
+	wait $pids
+	for file in "$dir"/sta*.scans; do
+		read s f < "$file"
+		scans=$((scans + s))
+		found=$((found + f))
+	done
+	[ "$n" -gt 0 ] || n=1
+	printf "%-8s %5d pings, avg %4d ms, max %5d ms, %5d/%d scans found the AP\n" \
+		"$label" "$n" $((sum / n)) "$max" "$found" "$scans"
+}
+
+echo "$stations scanning stations, stalled subscriber"
+ubus call hostapd.ap0 notify_response '{ "notify_response": 0 }'
+measure off
+ubus call hostapd.ap0 notify_response '{ "notify_response": 1 }'
+measure blocking
+ubus call hostapd.ap0 notify_response '{ "notify_response": 1, "async": true }'
+measure async
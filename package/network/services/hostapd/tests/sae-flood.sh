@@ -0,0 +1,160 @@
+#!/bin/sh
+#
+# Measure how much an SAE flood on one radio delays the APs of another
+# radio, with both radios in one hostapd process or in one process each
+# (-U, as started by mac80211.sh for separate_hostapd).
+#
+#   sae-flood.sh [-s] [-n <stations>] [-t <seconds>]
+#
+#   -s  run each radio in a hostapd process of its own
+#   -n  number of flooding stations (default 16)
+#   -t  duration of the flood (default 30)
+#
+# Runs on a device or VM with kmod-mac80211-hwsim, hostapd, wpa_supplicant
+# and hostapd_cli, with the wireless config stopped ("wifi down"). The
+# flooding stations use a wrong SAE password, so every attempt makes
+# hostapd compute the SAE commit and confirm. They are reconfigured every
+# second, so that the back-off after failed attempts does not slow them
+# down. The delay of the other radio is measured as the round trip time
+# of "hostapd_cli ping", which is answered from the event loop of the
+# process running it.
+
+separate=
+stations=16
+duration=30
+dir=/tmp/sae-flood
+
+while getopts "sn:t:" opt; do
+	case "$opt" in
+		s) separate=1;;
+		n) stations="$OPTARG";;
+		t) duration="$OPTARG";;
+		*) exit 2;;
+	esac
+done
+
+cleanup() {
+	for pid in $(cat "$dir"/*.pid 2>/dev/null); do
+		kill "$pid" 2>/dev/null
+	done
+	sleep 1
+	rmmod mac80211_hwsim 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT INT TERM
+
+rm -rf "$dir"
+mkdir -p "$dir"
+
+before="$(ls /sys/class/ieee80211)"
+modprobe mac80211_hwsim radios=$((stations + 2)) || exit 1
+sleep 1
+phys=
+for phy in $(ls /sys/class/ieee80211); do
+	case " $before " in
+		*" $phy "*) ;;
+		*) phys="$phys $phy";;
+	esac
+done
+set -- $phys
+[ $# -eq $((stations + 2)) ] || {
+	echo "expected $((stations + 2)) hwsim radios, found $#" >&2
+	exit 1
+}
+
+ap_conf() {
+	local iface="$1" ssid="$2"
+
+	cat > "$dir/$iface.conf" <<EOF
+interface=$iface
+driver=nl80211
+ctrl_interface=$dir/hostapd
+hw_mode=g
+channel=1
+ssid=$ssid
+wpa=2
+wpa_key_mgmt=SAE
+rsn_pairwise=CCMP
+ieee80211w=2
+sae_password=correct-password
+sae_anti_clogging_threshold=1000
+EOF
+}
+
+ap_phy0="$1"
+ap_phy1="$2"
+shift 2
+
+iw phy "$ap_phy0" interface add flood0 type managed || exit 1
+iw phy "$ap_phy1" interface add probe0 type managed || exit 1
+ap_conf flood0 sae-flood
+ap_conf probe0 sae-probe
+
+if [ -n "$separate" ]; then
+	hostapd -U -B -P "$dir/hostapd0.pid" "$dir/flood0.conf" || exit 1
+	hostapd -U -B -P "$dir/hostapd1.pid" "$dir/probe0.conf" || exit 1
+else
+	hostapd -B -P "$dir/hostapd0.pid" "$dir/flood0.conf" "$dir/probe0.conf" || exit 1
+fi
+sleep 2
+
+i=0
+for phy in "$@"; do
+	iw phy "$phy" interface add "sta$i" type managed || exit 1
+	cat > "$dir/sta$i.conf" <<EOF
+ctrl_interface=$dir/wpa_supplicant
+sae_groups=19
+network={
+	ssid="sae-flood"
+	key_mgmt=SAE
+	ieee80211w=2
+	sae_password="wrong-password-$i"
+}
+EOF
+	i=$((i + 1))
+done
+
+ping_ms() {
+	local start end
+
+	start=$(date +%s%N)
+	hostapd_cli -p "$dir/hostapd" -i probe0 ping > /dev/null || return 1
+	end=$(date +%s%N)
+	echo $(((end - start) / 1000000))
+}
+
+measure() {
+	local label="$1" n=0 sum=0 max=0 ms end
+
+	end=$(($(date +%s) + $2))
+	while [ "$(date +%s)" -lt "$end" ]; do
+		ms="$(ping_ms)" || continue
+		n=$((n + 1))
+		sum=$((sum + ms))
+		[ "$ms" -gt "$max" ] && max="$ms"
+		sleep 0.1
+	done
+	[ "$n" -gt 0 ] || n=1
+	printf "%-8s %5d pings, avg %4d ms, max %5d ms\n" "$label" "$n" $((sum / n)) "$max"
+}
+
+mode=shared
+[ -n "$separate" ] && mode=separate
+echo "$mode hostapd, $stations flooding stations"
+measure idle 10
+
+i=0
+while [ "$i" -lt "$stations" ]; do
+	wpa_supplicant -B -i "sta$i" -c "$dir/sta$i.conf" -P "$dir/sta$i.pid" || exit 1
+	i=$((i + 1))
+done
+(
+	while :; do
+		sleep 1
+		for sta in $(ls "$dir/wpa_supplicant"); do
+			wpa_cli -p "$dir/wpa_supplicant" -i "$sta" reconfigure > /dev/null
+		done
+	done
+) &
+echo $! > "$dir/reconfigure.pid"
+measure flood "$duration"
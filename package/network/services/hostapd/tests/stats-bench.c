@@ -0,0 +1,194 @@
+/*
+ * Checks the shared memory statistics of src/src/ap/hostapd_stats.h with a
+ * writer thread that publishes updates as fast as it can and a reader that
+ * verifies every update it gets, then measures the cost of a read.
+ *
+ *   stats-bench [stations] [reads]
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/src/ap/hostapd_stats.h"
+
+static struct hostapd_stats_header *hdr;
+static volatile bool stop;
+
+static int errors;
+
+#define check(cond, ...) do {					\
+	if (!(cond)) {						\
+		fprintf(stderr, "FAIL: " __VA_ARGS__);		\
+		fputc('\n', stderr);				\
+		errors++;					\
+	}							\
+} while (0)
+
+static double
+elapsed_ms(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e3 +
+	       (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* update <n>: n % max_sta + 1 stations, all counters set to n */
+static void
+write_update(uint64_t n)
+{
+	struct hostapd_stats_slot *slot;
+	uint32_t i, n_sta = n % hdr->max_sta + 1;
+
+	slot = hostapd_stats_begin(hdr);
+	for (i = 0; i < n_sta; i++) {
+		memset(&slot->sta[i], 0, sizeof(slot->sta[i]));
+		slot->sta[i].aid = i + 1;
+		slot->sta[i].rx_bytes = n;
+		slot->sta[i].tx_bytes = n;
+		slot->sta[i].rx_packets = n;
+	}
+	slot->bss.timestamp = n;
+	slot->bss.num_sta = n_sta;
+	slot->bss.n_sta = n_sta;
+	hostapd_stats_commit(hdr, slot);
+}
+
+static uint64_t updates;
+
+static void *
+writer(void *arg)
+{
+	while (!stop)
+		write_update(++updates);
+
+	return NULL;
+}
+
+/* set up like hostapd_ubus_stats_start() */
+static size_t
+stats_create(const char *ifname, unsigned int max_sta)
+{
+	size_t size = hostapd_stats_size(max_sta);
+	char path[64];
+	void *data;
+	int fd;
+
+	snprintf(path, sizeof(path), HOSTAPD_STATS_PATH, ifname);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0 || ftruncate(fd, size) < 0) {
+		perror(path);
+		exit(1);
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		perror(path);
+		exit(1);
+	}
+
+	hdr = data;
+	hdr->version = HOSTAPD_STATS_VERSION;
+	hdr->max_sta = max_sta;
+	hdr->slot_size = sizeof(struct hostapd_stats_slot) +
+			 max_sta * sizeof(struct hostapd_stats_sta);
+	hdr->head = 0;
+	__atomic_store_n(&hdr->magic, HOSTAPD_STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return size;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int max_sta = argc > 1 ? atoi(argv[1]) : 64;
+	long n_reads = argc > 2 ? atol(argv[2]) : 1000000;
+	struct hostapd_stats_sta *sta;
+	struct hostapd_stats_map map = {};
+	struct hostapd_stats_bss bss;
+	uint64_t last = 0;
+	long i, failed = 0;
+	struct timespec start;
+	double stress_ms, idle_ms;
+	char ifname[32], path[64];
+	pthread_t thread;
+	size_t size;
+	int j, n;
+
+	snprintf(ifname, sizeof(ifname), "stats-bench-%d", (int) getpid());
+	snprintf(path, sizeof(path), HOSTAPD_STATS_PATH, ifname);
+	size = stats_create(ifname, max_sta);
+	sta = calloc(max_sta, sizeof(*sta));
+
+	check(!hostapd_stats_open(&map, ifname), "open failed");
+	if (errors)
+		goto out;
+	check(hostapd_stats_read(&map, &bss, sta, max_sta) == 0,
+	      "stations before the first update");
+
+	/* every read must return one complete update, never an older one */
+	pthread_create(&thread, NULL, writer, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n_reads; i++) {
+		n = hostapd_stats_read(&map, &bss, sta, max_sta);
+		if (n < 0) {
+			failed++;
+			continue;
+		}
+
+		check(bss.timestamp >= last, "update %llu after %llu",
+		      (unsigned long long) bss.timestamp,
+		      (unsigned long long) last);
+		last = bss.timestamp;
+		/* the slots are empty until the first update */
+		check((uint32_t) n == bss.n_sta &&
+		      bss.n_sta == (bss.timestamp ? bss.timestamp % max_sta + 1 : 0),
+		      "update %llu has %d stations",
+		      (unsigned long long) bss.timestamp, n);
+		for (j = 0; j < n; j++)
+			check(sta[j].aid == j + 1 && sta[j].rx_bytes == bss.timestamp &&
+			      sta[j].tx_bytes == bss.timestamp &&
+			      sta[j].rx_packets == bss.timestamp,
+			      "torn station %d in update %llu", j,
+			      (unsigned long long) bss.timestamp);
+		if (errors)
+			break;
+	}
+	stress_ms = elapsed_ms(&start);
+	stop = true;
+	pthread_join(thread, NULL);
+
+	/* without a concurrent update, no read may fail */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n_reads; i++) {
+		n = hostapd_stats_read(&map, &bss, sta, max_sta);
+		if (n < 0 || (uint32_t) n != bss.n_sta)
+			break;
+	}
+	idle_ms = elapsed_ms(&start);
+	check(i == n_reads, "read %ld failed without a writer", i);
+
+	/* a stopped export must make readers let go of the file */
+	__atomic_store_n(&hdr->magic, 0, __ATOMIC_RELEASE);
+	check(hostapd_stats_read(&map, &bss, sta, max_sta) < 0,
+	      "read after the export stopped");
+	hostapd_stats_close(&map);
+
+	printf("%u stations, %ld reads\n", max_sta, n_reads);
+	printf("%-14s %10s %10s %10s\n", "", "updates", "failed", "ns/read");
+	printf("%-14s %10llu %10ld %10.1f\n", "writer busy",
+	       (unsigned long long) updates, failed, stress_ms * 1e6 / n_reads);
+	printf("%-14s %10d %10d %10.1f\n", "writer idle", 0, 0,
+	       idle_ms * 1e6 / n_reads);
+
+out:
+	munmap(hdr, size);
+	unlink(path);
+	free(sta);
+	if (errors)
+		fprintf(stderr, "%d errors\n", errors);
+
+	return errors ? 1 : 0;
+}
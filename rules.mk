@@ -342,6 +342,9 @@ else
     STRIP="$(STRIP)" \
     STRIP_KMOD="$(SCRIPT_DIR)/strip-kmod.sh" \
     PATCHELF="$(STAGING_DIR_HOST)/bin/patchelf" \
+    ELFSCAN="$(STAGING_DIR_HOST)/bin/elfscan" \
+    $(if $(CONFIG_RSTRIP_CACHE),RSTRIP_CACHE="$(TMP_DIR)/.rstrip-cache" \
+      RSTRIP_CACHE_SIZE="$(CONFIG_RSTRIP_CACHE_SIZE)") \
     $(SCRIPT_DIR)/rstrip.sh
 endif
 
@@ -363,6 +366,29 @@ ifeq ($(CONFIG_BUILD_LOG),y)
   BUILD_LOG:=1
 endif
 
+ifeq ($(CONFIG_BUILD_PROFILE),y)
+  BUILD_PROFILE:=1
+endif
+
+# The recipes of the targets named with ProfileStep are run by
+# scripts/profile.pl, which records them in $(BUILD_PROFILE_DIR)/steps.
+# The directory is chosen once per build and passed on to the sub-makes.
+ifneq ($(BUILD_PROFILE),)
+  ifndef BUILD_PROFILE_DIR
+    export BUILD_PROFILE_DIR:=$(BUILD_LOG_DIR)/profile/$(shell date +%Y%m%d-%H%M%S)
+  endif
+  export BUILD_PROFILE_SHELL:=$(SHELL)
+endif
+
+# Name the build step of a target in the build profile. Only the recipe of
+# the targets themselves is run by the profile shell, not the ones of their
+# prerequisites or $(shell ...).
+# $(1) => The targets.
+# $(2) => The step, e.g. compile or ipkg/<package>.
+define ProfileStep
+  $(if $(BUILD_PROFILE),$(1) : private SHELL=$(SCRIPT_DIR)/profile.pl --step=$(BUILD_SUBDIR)$(if $(BUILD_VARIANT),/$(BUILD_VARIANT)):$(2))
+endef
+
 export BISON_PKGDATADIR:=$(STAGING_DIR_HOST)/share/bison
 export HOST_GNULIB_SRCDIR:=$(STAGING_DIR_HOST)/share/gnulib
 export M4:=$(STAGING_DIR_HOST)/bin/m4
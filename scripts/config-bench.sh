@@ -0,0 +1,112 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# config-bench - time "conf --defconfig" on the package configuration tree
+#
+# Usage:
+#   ./scripts/config-bench.sh [-c <defconfig>] [-k] [-n <copies>] [-r <runs>] [<conf binary>...]
+#
+# Needs tmp/.config-package.in, run "make defconfig" once to create it.
+# When not all feeds are installed, -n adds renamed copies of the package
+# menu to get a tree of roughly the size of one with all feeds enabled
+# (about 10 copies of the core packages). Every conf binary (by default
+# scripts/config/conf) is run -r times, the fastest run is printed and the
+# resulting configurations are compared against each other. With -k the
+# runs use a parse cache (KCONFIG_CACHE), which is written by a first run
+# that is not timed.
+
+export LANG=C
+export LC_ALL=C
+
+DEFCONFIG=/dev/null
+COPIES=0
+RUNS=5
+CACHE=
+
+while getopts "c:kn:r:" opt; do
+	case "$opt" in
+		c) DEFCONFIG="$OPTARG" ;;
+		k) CACHE=1 ;;
+		n) COPIES="$OPTARG" ;;
+		r) RUNS="$OPTARG" ;;
+		*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || set -- scripts/config/conf
+
+[ -f tmp/.config-package.in ] || {
+	echo "tmp/.config-package.in not found, run make defconfig first" >&2
+	exit 1
+}
+
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+cp Config.in "$TMP/Config.in"
+[ "$COPIES" -gt 0 ] && perl -e '
+	my ($tmp, $n) = @ARGV;
+	open my $fh, "<", "tmp/.config-package.in" or die;
+	my $in = do { local $/; <$fh> };
+	my %syms;
+	$syms{$1} = 1 while $in =~ /^\s*(?:menu)?config\s+(\S+)/mg;
+	my $re = join "|", map quotemeta, sort { length $b <=> length $a } keys %syms;
+	$re = qr/(?<![\w\-\.\/])($re)(?![\w\-\.\/])/;
+	for my $i (1 .. $n) {
+		(my $copy = $in) =~ s/$re/${1}_COPY$i/g;
+		$copy =~ s/^(\s*menu\s+".*)"/$1 ($i)"/mg;
+		open my $out, ">", "$tmp/package-$i.in" or die;
+		print $out $copy;
+		print $out "\n";
+		close $out;
+		open my $cfg, ">>", "$tmp/Config.in" or die;
+		print $cfg "source \"$tmp/package-$i.in\"\n";
+		close $cfg;
+	}
+' "$TMP" "$COPIES"
+
+now() {
+	perl -MTime::HiRes=time -e 'printf "%.3f\n", time'
+}
+
+printf "%d symbols\n" "$(cat tmp/.config-package.in "$TMP"/package-*.in 2>/dev/null | grep -cE '^\s*(menu)?config ')"
+
+run_conf() {
+	KCONFIG_CONFIG="$TMP/.config" "$conf" --defconfig="$DEFCONFIG" \
+		"$TMP/Config.in" > /dev/null 2>&1
+}
+
+ref=
+n=0
+for conf in "$@"; do
+	n=$((n + 1))
+	unset KCONFIG_CACHE
+	[ -n "$CACHE" ] && {
+		export KCONFIG_CACHE="$TMP/cache-$n"
+		run_conf
+		# the cache is written in the background
+		for i in $(seq 1 300); do
+			[ -f "$KCONFIG_CACHE" ] && break
+			sleep 0.1
+		done
+	}
+
+	best=
+	for i in $(seq 1 "$RUNS"); do
+		rm -f "$TMP/.config"
+		start=$(now)
+		run_conf || {
+			echo "$conf failed" >&2
+			exit 1
+		}
+		end=$(now)
+		best=$(perl -e 'my ($t, $best) = @ARGV;
+			printf "%.3f", ($best eq "" || $t < $best) ? $t : $best' \
+			"$(perl -e "print $end - $start")" "$best")
+	done
+	printf "%-32s %8s s\n" "$conf" "$best"
+
+	sum="$(md5sum < "$TMP/.config")"
+	[ -z "$ref" ] && ref="$sum"
+	[ "$sum" = "$ref" ] || echo "$conf: configuration differs from $1" >&2
+done
@@ -0,0 +1,929 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Cache of the parsed menu and symbol tree
+ *
+ * When KCONFIG_CACHE names a file, conf_parse() stores the finalized menu and
+ * symbol tree in it, as an image that can be mapped back into memory by later
+ * runs instead of parsing all Kconfig files again. The image is laid out for
+ * a fixed base address and only needs its pointers relocated if it can't be
+ * mapped there.
+ *
+ * Along with the image everything the parse depended on is recorded: the
+ * contents of all Kconfig files read, the results of the globs of 'source'
+ * statements, the referenced environment variables and the output of
+ * $(shell,...) calls. The cache is only used if all of these are unchanged
+ * and it was written by the same binary. Messages printed while parsing are
+ * stored as well and printed again when the cache is used.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lkc.h"
+
+#define CACHE_MAGIC	"KCFGCCH1"
+
+/* Preferred address of the image, chosen to be unlikely to be in use */
+#define CACHE_BASE	(sizeof(void *) == 8 ? (uintptr_t)0x3c5a00000000ULL \
+					     : (uintptr_t)0x5a000000UL)
+
+struct cache_header {
+	char magic[8];
+	uint64_t key;		/* binary and arguments, see cache_key() */
+	uint64_t size;		/* of the whole file */
+	uint64_t root;		/* offset of struct cache_root */
+	uint64_t inputs, inputs_len;
+	uint64_t messages, messages_len;
+	uint64_t relocs, relocs_len;	/* bitmap of the pointers to relocate */
+	uint64_t externs, nexterns;
+};
+
+struct cache_root {
+	struct symbol *symbol_hash[SYMBOL_HASHSIZE];
+	struct file *file_list;
+	struct symbol *modules_sym;
+	struct menu rootmenu;
+	int flags[3];
+};
+
+/* Pointers to objects outside of the image, resolved when loading */
+enum {
+	EXT_NONE,
+	EXT_YES,
+	EXT_MOD,
+	EXT_NO,
+	EXT_ROOTMENU,
+};
+
+struct cache_extern {
+	uint32_t offset;
+	uint32_t id;
+};
+
+/*
+ * Records in the inputs section, each a type character followed by
+ * NUL-terminated strings:
+ *   F <path> <hash>                 Kconfig file and hash of its contents
+ *   G <pattern> <file> <matches>    glob of a 'source' statement in <file>,
+ *                                   matches separated by newlines
+ *   E <name> <value>                environment variable
+ *   U <name>                        unset environment variable
+ *   S <command> <output>            $(shell,...) call
+ */
+
+struct cache_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+enum cache_kind {
+	K_STRING,
+	K_FILE,
+	K_SYMBOL,
+	K_PROPERTY,
+	K_MENU,
+	K_EXPR,
+};
+
+struct cache_ptr {
+	const void *ptr;
+	size_t offset;
+};
+
+struct cache_pending {
+	enum cache_kind kind;
+	size_t offset;
+	const void *ptr;
+};
+
+static uint64_t cache_key_val;
+static bool recording, disabled;
+static struct cache_buf inputs, messages;
+static int stderr_fd = -1;
+static FILE *stderr_file;
+
+static struct cache_buf image, relocs, externs;
+static struct cache_ptr *ptr_map;
+static size_t ptr_map_size, ptr_map_count;
+static struct cache_pending *pending;
+static size_t npending, pending_size;
+static bool image_error;
+
+static uint64_t cache_hash(const void *data, size_t len, uint64_t h)
+{
+	const unsigned char *p = data;
+	uint64_t w;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 29;
+	}
+	while (len--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+
+	return h;
+}
+
+static uint64_t cache_hash_str(const char *s, uint64_t h)
+{
+	return cache_hash(s ? s : "", s ? strlen(s) + 1 : 0, h);
+}
+
+static bool cache_hash_file(const char *path, uint64_t *hash)
+{
+	char buf[65536];
+	uint64_t h = 0;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		h = cache_hash(buf, n, h);
+	close(fd);
+	if (n < 0)
+		return false;
+
+	*hash = h;
+	return true;
+}
+
+static size_t buf_reserve(struct cache_buf *b, size_t len)
+{
+	size_t offset = (b->len + 7) & ~(size_t)7;
+
+	if (offset + len > b->size) {
+		b->size = b->size ? b->size : 65536;
+		while (offset + len > b->size)
+			b->size *= 2;
+		b->data = xrealloc(b->data, b->size);
+	}
+	memset(b->data + b->len, 0, offset + len - b->len);
+	b->len = offset + len;
+
+	return offset;
+}
+
+static void buf_add(struct cache_buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		b->size = b->size ? b->size : 65536;
+		while (b->len + len > b->size)
+			b->size *= 2;
+		b->data = xrealloc(b->data, b->size);
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void buf_add_str(struct cache_buf *b, const char *s)
+{
+	buf_add(b, s, strlen(s) + 1);
+}
+
+/*
+ * The binary, the arguments and the working directory the parse depends on.
+ * Without /proc/self/exe there is no reliable way to tell whether the cache
+ * was written by this binary, and the cache is not used.
+ */
+static bool cache_key(const char *name, uint64_t *key)
+{
+	char cwd[PATH_MAX];
+	int params[2] = { recursive_is_error, sizeof(void *) };
+	uint64_t h;
+
+	if (!cache_hash_file("/proc/self/exe", &h) || !getcwd(cwd, sizeof(cwd)))
+		return false;
+
+	h = cache_hash_str(name, h);
+	h = cache_hash_str(cwd, h);
+	h = cache_hash_str(getenv(SRCTREE), h);
+	*key = cache_hash(params, sizeof(params), h);
+
+	return true;
+}
+
+static void cache_release_stderr(void)
+{
+	char buf[4096];
+	size_t n;
+
+	if (stderr_fd < 0)
+		return;
+
+	fflush(stderr);
+	dup2(stderr_fd, STDERR_FILENO);
+	close(stderr_fd);
+	stderr_fd = -1;
+
+	rewind(stderr_file);
+	while ((n = fread(buf, 1, sizeof(buf), stderr_file)) > 0) {
+		buf_add(&messages, buf, n);
+		fwrite(buf, 1, n, stderr);
+	}
+	fclose(stderr_file);
+}
+
+/*
+ * Messages printed while parsing are collected in a temporary file to be
+ * stored in the cache. They are copied to the real stderr when the parse is
+ * done, or when it fails and conf exits.
+ */
+static bool cache_capture_stderr(void)
+{
+	fflush(stderr);
+	stderr_file = tmpfile();
+	if (!stderr_file)
+		return false;
+
+	stderr_fd = dup(STDERR_FILENO);
+	if (stderr_fd < 0 || dup2(fileno(stderr_file), STDERR_FILENO) < 0) {
+		if (stderr_fd >= 0)
+			close(stderr_fd);
+		stderr_fd = -1;
+		fclose(stderr_file);
+		return false;
+	}
+	atexit(cache_release_stderr);
+
+	return true;
+}
+
+void conf_cache_add_file(const char *path)
+{
+	char hash[17];
+	uint64_t h;
+
+	if (!recording)
+		return;
+
+	if (!cache_hash_file(path, &h)) {
+		disabled = true;
+		return;
+	}
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)h);
+	buf_add_str(&inputs, "F");
+	buf_add_str(&inputs, path);
+	buf_add_str(&inputs, hash);
+}
+
+void conf_cache_add_glob(const char *pattern, const char *curname,
+			 size_t count, char **paths)
+{
+	size_t i;
+
+	if (!recording)
+		return;
+
+	buf_add_str(&inputs, "G");
+	buf_add_str(&inputs, pattern);
+	buf_add_str(&inputs, curname);
+	for (i = 0; i < count; i++) {
+		if (i)
+			buf_add(&inputs, "\n", 1);
+		buf_add(&inputs, paths[i], strlen(paths[i]));
+	}
+	buf_add(&inputs, "", 1);
+}
+
+void conf_cache_add_env(const char *name, const char *value)
+{
+	if (!recording)
+		return;
+
+	buf_add_str(&inputs, value ? "E" : "U");
+	buf_add_str(&inputs, name);
+	if (value)
+		buf_add_str(&inputs, value);
+}
+
+void conf_cache_add_shell(const char *cmd, const char *output)
+{
+	if (!recording)
+		return;
+
+	buf_add_str(&inputs, "S");
+	buf_add_str(&inputs, cmd);
+	buf_add_str(&inputs, output);
+}
+
+void conf_cache_disable(void)
+{
+	disabled = true;
+}
+
+/* Iterate over the records in the inputs section */
+static const char *input_next(const char *p, const char *end,
+			      const char **args, int nargs)
+{
+	int i;
+
+	for (i = 0; i < nargs; i++) {
+		if (p >= end)
+			return NULL;
+		args[i] = p;
+		p = memchr(p, 0, end - p);
+		if (!p)
+			return NULL;
+		p++;
+	}
+
+	return p;
+}
+
+static int input_nargs(char type)
+{
+	switch (type) {
+	case 'F':
+	case 'E':
+	case 'S':
+		return 3;
+	case 'G':
+		return 4;
+	case 'U':
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static bool input_check(const char **args)
+{
+	const char *value, *p;
+	char hash[17], *output;
+	uint64_t h;
+	glob_t gl;
+	size_t i, len;
+	bool ret;
+
+	switch (args[0][0]) {
+	case 'F':
+		if (!cache_hash_file(args[1], &h))
+			return false;
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)h);
+		return !strcmp(hash, args[2]);
+	case 'G':
+		if (zconf_glob(args[1], args[2], &gl))
+			return false;
+		p = args[3];
+		ret = true;
+		for (i = 0; ret && i < gl.gl_pathc; i++) {
+			len = strlen(gl.gl_pathv[i]);
+			ret = !strncmp(p, gl.gl_pathv[i], len) &&
+			      p[len] == (i + 1 < gl.gl_pathc ? '\n' : 0);
+			p += len + 1;
+		}
+		ret = ret && (gl.gl_pathc || !*args[3]);
+		globfree(&gl);
+		return ret;
+	case 'E':
+		value = getenv(args[1]);
+		return value && !strcmp(value, args[2]);
+	case 'U':
+		return !getenv(args[1]);
+	case 'S':
+		output = preprocess_shell(args[1]);
+		ret = !strcmp(output, args[2]);
+		free(output);
+		return ret;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Check all inputs, the cheap ones first, so the shell commands only run
+ * when everything else is unchanged.
+ */
+static bool cache_check_inputs(const char *p, size_t len)
+{
+	static const char order[] = "EUGFS";
+	const char *end = p + len, *q, *args[4];
+	int i, nargs;
+
+	for (i = 0; order[i]; i++) {
+		for (q = p; q < end; ) {
+			nargs = input_nargs(*q);
+			if (!nargs)
+				return false;
+			q = input_next(q, end, args, nargs);
+			if (!q)
+				return false;
+			if (args[0][0] == order[i] && !input_check(args))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void cache_restore_env(const char *p, size_t len)
+{
+	const char *end = p + len, *args[3];
+
+	while (p && p < end) {
+		if (*p == 'E') {
+			p = input_next(p, end, args, 3);
+			if (p)
+				env_add(args[1], args[2]);
+		} else {
+			p = input_next(p, end, args, input_nargs(*p));
+		}
+	}
+}
+
+/*
+ * Map the cache and install its menu and symbol tree. Returns false if there
+ * is no usable cache, in which case the inputs of the parse that follows are
+ * recorded for conf_cache_save().
+ */
+bool conf_cache_load(const char *name)
+{
+	const char *path = getenv("KCONFIG_CACHE");
+	struct cache_header *hdr;
+	struct cache_root *root;
+	struct cache_extern *ext;
+	struct stat st;
+	uintptr_t delta, *slot;
+	unsigned char *bits;
+	void *ext_ptr[] = {
+		[EXT_YES] = &symbol_yes,
+		[EXT_MOD] = &symbol_mod,
+		[EXT_NO] = &symbol_no,
+		[EXT_ROOTMENU] = &rootmenu,
+	};
+	char *map;
+	uint64_t i;
+	int j, fd;
+
+	if (!path || !*path || !cache_key(name, &cache_key_val))
+		return false;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		goto record;
+
+	if (fstat(fd, &st) || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		goto record;
+	}
+
+	map = mmap((void *)CACHE_BASE, st.st_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		goto record;
+
+	hdr = (struct cache_header *)map;
+	if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->key != cache_key_val || hdr->size != st.st_size ||
+	    hdr->inputs + hdr->inputs_len > hdr->size ||
+	    hdr->messages + hdr->messages_len > hdr->size ||
+	    hdr->relocs + hdr->relocs_len > hdr->size ||
+	    hdr->relocs_len * 8 * sizeof(void *) > hdr->size ||
+	    hdr->externs + hdr->nexterns * sizeof(*ext) > hdr->size ||
+	    hdr->root + sizeof(*root) > hdr->size ||
+	    !cache_check_inputs(map + hdr->inputs, hdr->inputs_len)) {
+		munmap(map, st.st_size);
+		goto record;
+	}
+
+	delta = (uintptr_t)map - CACHE_BASE;
+	if (delta) {
+		bits = (unsigned char *)(map + hdr->relocs);
+		for (i = 0; i < hdr->relocs_len; i++) {
+			for (j = 0; bits[i] >> j; j++) {
+				if (!(bits[i] & (1 << j)))
+					continue;
+				slot = (uintptr_t *)map + i * 8 + j;
+				*slot += delta;
+			}
+		}
+	}
+
+	ext = (struct cache_extern *)(map + hdr->externs);
+	for (i = 0; i < hdr->nexterns; i++)
+		memcpy(map + ext[i].offset, &ext_ptr[ext[i].id], sizeof(void *));
+
+	root = (struct cache_root *)(map + hdr->root);
+	memcpy(symbol_hash, root->symbol_hash, sizeof(symbol_hash));
+	file_list = root->file_list;
+	modules_sym = root->modules_sym;
+	rootmenu = root->rootmenu;
+	symbol_yes.flags = root->flags[0];
+	symbol_mod.flags = root->flags[1];
+	symbol_no.flags = root->flags[2];
+
+	cache_restore_env(map + hdr->inputs, hdr->inputs_len);
+	fwrite(map + hdr->messages, 1, hdr->messages_len, stderr);
+
+	return true;
+
+record:
+	recording = cache_capture_stderr();
+	return false;
+}
+
+static int image_extern(const void *ptr)
+{
+	if (ptr == &symbol_yes)
+		return EXT_YES;
+	if (ptr == &symbol_mod)
+		return EXT_MOD;
+	if (ptr == &symbol_no)
+		return EXT_NO;
+	if (ptr == &rootmenu)
+		return EXT_ROOTMENU;
+	return EXT_NONE;
+}
+
+static size_t ptr_hash(const void *ptr)
+{
+	return ((uint64_t)(uintptr_t)ptr * 0x9e3779b97f4a7c15ULL) >> 32;
+}
+
+static size_t image_add(const void *ptr, enum cache_kind kind)
+{
+	static const size_t sizes[] = {
+		[K_FILE] = sizeof(struct file),
+		[K_SYMBOL] = sizeof(struct symbol),
+		[K_PROPERTY] = sizeof(struct property),
+		[K_MENU] = sizeof(struct menu),
+		[K_EXPR] = sizeof(struct expr),
+	};
+	struct cache_ptr *old = ptr_map;
+	size_t i, size, offset;
+
+	if (ptr_map_count * 2 >= ptr_map_size) {
+		size = ptr_map_size;
+		ptr_map_size = size ? size * 2 : 65536;
+		ptr_map = xcalloc(ptr_map_size, sizeof(*ptr_map));
+		ptr_map_count = 0;
+		for (i = 0; i < size; i++) {
+			if (!old[i].ptr)
+				continue;
+			offset = ptr_hash(old[i].ptr) & (ptr_map_size - 1);
+			while (ptr_map[offset].ptr)
+				offset = (offset + 1) & (ptr_map_size - 1);
+			ptr_map[offset] = old[i];
+			ptr_map_count++;
+		}
+		free(old);
+	}
+
+	i = ptr_hash(ptr) & (ptr_map_size - 1);
+	for (; ptr_map[i].ptr; i = (i + 1) & (ptr_map_size - 1)) {
+		if (ptr_map[i].ptr == ptr)
+			return ptr_map[i].offset;
+	}
+
+	size = kind == K_STRING ? strlen(ptr) + 1 : sizes[kind];
+	offset = buf_reserve(&image, size);
+	memcpy(image.data + offset, ptr, size);
+	ptr_map[i].ptr = ptr;
+	ptr_map[i].offset = offset;
+	ptr_map_count++;
+
+	if (kind != K_STRING) {
+		if (npending == pending_size) {
+			pending_size = pending_size ? pending_size * 2 : 4096;
+			pending = xrealloc(pending, pending_size * sizeof(*pending));
+		}
+		pending[npending].kind = kind;
+		pending[npending].offset = offset;
+		pending[npending].ptr = ptr;
+		npending++;
+	}
+
+	return offset;
+}
+
+static void image_reloc(size_t slot)
+{
+	size_t bit = slot / sizeof(void *);
+	size_t size = relocs.size;
+
+	if (bit / 8 >= size) {
+		relocs.size = size ? size : 65536;
+		while (bit / 8 >= relocs.size)
+			relocs.size *= 2;
+		relocs.data = xrealloc(relocs.data, relocs.size);
+		memset(relocs.data + size, 0, relocs.size - size);
+	}
+	relocs.data[bit / 8] |= 1 << (bit % 8);
+	if (bit / 8 >= relocs.len)
+		relocs.len = bit / 8 + 1;
+}
+
+/* Store the pointer 'ptr' at 'slot' in the image */
+static void image_ptr(size_t slot, const void *ptr, enum cache_kind kind)
+{
+	struct cache_extern ext = { slot, image_extern(ptr) };
+	uintptr_t val = 0;
+
+	if (ext.id) {
+		buf_add(&externs, &ext, sizeof(ext));
+	} else if (ptr) {
+		val = CACHE_BASE + image_add(ptr, kind);
+		image_reloc(slot);
+	}
+	memcpy(image.data + slot, &val, sizeof(val));
+}
+
+#define IMAGE_PTR(off, type, obj, field, kind) \
+	image_ptr((off) + offsetof(type, field), (obj)->field, kind)
+
+static void image_file(size_t off, const struct file *file)
+{
+	IMAGE_PTR(off, struct file, file, next, K_FILE);
+	IMAGE_PTR(off, struct file, file, parent, K_FILE);
+	IMAGE_PTR(off, struct file, file, name, K_STRING);
+}
+
+static void image_symbol(size_t off, const struct symbol *sym)
+{
+	int i;
+
+	/* values are only calculated after parsing */
+	for (i = 0; i < S_DEF_COUNT; i++)
+		if (sym->def[i].val)
+			image_error = true;
+	if (sym->curr.val || sym->rdeps)
+		image_error = true;
+
+	IMAGE_PTR(off, struct symbol, sym, next, K_SYMBOL);
+	IMAGE_PTR(off, struct symbol, sym, name, K_STRING);
+	IMAGE_PTR(off, struct symbol, sym, prop, K_PROPERTY);
+	IMAGE_PTR(off, struct symbol, sym, dir_dep.expr, K_EXPR);
+	IMAGE_PTR(off, struct symbol, sym, rev_dep.expr, K_EXPR);
+	IMAGE_PTR(off, struct symbol, sym, implied.expr, K_EXPR);
+}
+
+static void image_property(size_t off, const struct property *prop)
+{
+	IMAGE_PTR(off, struct property, prop, next, K_PROPERTY);
+	IMAGE_PTR(off, struct property, prop, text, K_STRING);
+	IMAGE_PTR(off, struct property, prop, visible.expr, K_EXPR);
+	IMAGE_PTR(off, struct property, prop, expr, K_EXPR);
+	IMAGE_PTR(off, struct property, prop, menu, K_MENU);
+	IMAGE_PTR(off, struct property, prop, file, K_FILE);
+}
+
+static void image_menu(size_t off, const struct menu *menu)
+{
+	if (menu->data)
+		image_error = true;
+
+	IMAGE_PTR(off, struct menu, menu, next, K_MENU);
+	IMAGE_PTR(off, struct menu, menu, parent, K_MENU);
+	IMAGE_PTR(off, struct menu, menu, list, K_MENU);
+	IMAGE_PTR(off, struct menu, menu, sym, K_SYMBOL);
+	IMAGE_PTR(off, struct menu, menu, prompt, K_PROPERTY);
+	IMAGE_PTR(off, struct menu, menu, visibility, K_EXPR);
+	IMAGE_PTR(off, struct menu, menu, dep, K_EXPR);
+	IMAGE_PTR(off, struct menu, menu, help, K_STRING);
+	IMAGE_PTR(off, struct menu, menu, file, K_FILE);
+}
+
+static void image_expr(size_t off, const struct expr *e)
+{
+	struct expr *copy = (struct expr *)(image.data + off);
+
+	copy->calc_tri = no;
+	copy->calc_epoch = 0;
+
+	switch (e->type) {
+	case E_OR:
+	case E_AND:
+		IMAGE_PTR(off, struct expr, e, left.expr, K_EXPR);
+		IMAGE_PTR(off, struct expr, e, right.expr, K_EXPR);
+		break;
+	case E_NOT:
+		IMAGE_PTR(off, struct expr, e, left.expr, K_EXPR);
+		break;
+	case E_LIST:
+		IMAGE_PTR(off, struct expr, e, left.expr, K_EXPR);
+		IMAGE_PTR(off, struct expr, e, right.sym, K_SYMBOL);
+		break;
+	case E_SYMBOL:
+	case E_EQUAL:
+	case E_UNEQUAL:
+	case E_LTH:
+	case E_LEQ:
+	case E_GTH:
+	case E_GEQ:
+	case E_RANGE:
+		IMAGE_PTR(off, struct expr, e, left.sym, K_SYMBOL);
+		IMAGE_PTR(off, struct expr, e, right.sym, K_SYMBOL);
+		break;
+	default:
+		image_error = true;
+		break;
+	}
+}
+
+static void image_intern_menu(struct menu *menu)
+{
+	for (; menu; menu = menu->next) {
+		menu->dep = expr_intern(menu->dep);
+		menu->visibility = expr_intern(menu->visibility);
+		image_intern_menu(menu->list);
+	}
+}
+
+/*
+ * Expressions are duplicated a lot while finalizing the menu tree, share
+ * equal ones so every distinct expression is stored only once.
+ */
+static void image_intern(void)
+{
+	struct property *prop;
+	struct symbol *sym;
+	int i;
+
+	for_all_symbols(i, sym) {
+		sym->dir_dep.expr = expr_intern(sym->dir_dep.expr);
+		sym->rev_dep.expr = expr_intern(sym->rev_dep.expr);
+		sym->implied.expr = expr_intern(sym->implied.expr);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			prop->expr = expr_intern(prop->expr);
+			prop->visible.expr = expr_intern(prop->visible.expr);
+		}
+	}
+	image_intern_menu(&rootmenu);
+}
+
+static bool image_build(void)
+{
+	struct cache_pending p;
+	size_t root;
+	int i;
+
+	buf_reserve(&image, sizeof(struct cache_header));
+	root = buf_reserve(&image, sizeof(struct cache_root));
+
+	for (i = 0; i < SYMBOL_HASHSIZE; i++)
+		image_ptr(root + offsetof(struct cache_root, symbol_hash[i]),
+			  symbol_hash[i], K_SYMBOL);
+	image_ptr(root + offsetof(struct cache_root, file_list), file_list,
+		  K_FILE);
+	image_ptr(root + offsetof(struct cache_root, modules_sym), modules_sym,
+		  K_SYMBOL);
+
+	memcpy(image.data + root + offsetof(struct cache_root, rootmenu),
+	       &rootmenu, sizeof(rootmenu));
+	image_menu(root + offsetof(struct cache_root, rootmenu), &rootmenu);
+
+	((struct cache_root *)(image.data + root))->flags[0] = symbol_yes.flags;
+	((struct cache_root *)(image.data + root))->flags[1] = symbol_mod.flags;
+	((struct cache_root *)(image.data + root))->flags[2] = symbol_no.flags;
+
+	while (npending && !image_error) {
+		p = pending[--npending];
+		switch (p.kind) {
+		case K_FILE:
+			image_file(p.offset, p.ptr);
+			break;
+		case K_SYMBOL:
+			image_symbol(p.offset, p.ptr);
+			break;
+		case K_PROPERTY:
+			image_property(p.offset, p.ptr);
+			break;
+		case K_MENU:
+			image_menu(p.offset, p.ptr);
+			break;
+		case K_EXPR:
+			image_expr(p.offset, p.ptr);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return !image_error && image.len < UINT32_MAX;
+}
+
+static bool cache_write(const char *path)
+{
+	struct cache_header *hdr;
+	char tmp[PATH_MAX];
+	size_t done;
+	ssize_t n;
+	int fd;
+
+	hdr = (struct cache_header *)image.data;
+	memcpy(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic));
+	hdr->key = cache_key_val;
+	hdr->root = sizeof(*hdr);
+
+	/* the offsets are taken before each append, 'hdr' may move */
+	done = buf_reserve(&image, inputs.len);
+	memcpy(image.data + done, inputs.data, inputs.len);
+	hdr = (struct cache_header *)image.data;
+	hdr->inputs = done;
+	hdr->inputs_len = inputs.len;
+
+	done = buf_reserve(&image, messages.len);
+	memcpy(image.data + done, messages.data, messages.len);
+	hdr = (struct cache_header *)image.data;
+	hdr->messages = done;
+	hdr->messages_len = messages.len;
+
+	done = buf_reserve(&image, relocs.len);
+	memcpy(image.data + done, relocs.data, relocs.len);
+	hdr = (struct cache_header *)image.data;
+	hdr->relocs = done;
+	hdr->relocs_len = relocs.len;
+
+	done = buf_reserve(&image, externs.len);
+	memcpy(image.data + done, externs.data, externs.len);
+	hdr = (struct cache_header *)image.data;
+	hdr->externs = done;
+	hdr->nexterns = externs.len / sizeof(struct cache_extern);
+	hdr->size = image.len;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >=
+	    sizeof(tmp))
+		return false;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	for (done = 0; done < image.len; done += n) {
+		n = write(fd, image.data + done, image.len - done);
+		if (n <= 0)
+			break;
+	}
+
+	if (close(fd) || done < image.len || rename(tmp, path)) {
+		unlink(tmp);
+		return false;
+	}
+
+	return true;
+}
+
+/* Check that no Kconfig file was changed while it was being parsed */
+static bool cache_inputs_unchanged(void)
+{
+	const char *p = inputs.data, *end = inputs.data + inputs.len;
+	const char *args[4];
+
+	while (p && p < end) {
+		p = input_next(p, end, args, input_nargs(*p));
+		if (p && args[0][0] == 'F' && !input_check(args))
+			return false;
+	}
+
+	return p != NULL;
+}
+
+/*
+ * Store the tree created by conf_parse() if recording was started. This is
+ * done before conf_parse() returns, so that the cache is complete when this
+ * run exits and the next one starts.
+ */
+void conf_cache_save(void)
+{
+	if (!recording)
+		return;
+
+	recording = false;
+	cache_release_stderr();
+	if (disabled)
+		return;
+
+	if (cache_inputs_unchanged()) {
+		image_intern();
+		if (image_build())
+			cache_write(getenv("KCONFIG_CACHE"));
+	}
+
+	free(image.data);
+	free(relocs.data);
+	free(externs.data);
+	free(ptr_map);
+	free(pending);
+	memset(&image, 0, sizeof(image));
+	memset(&relocs, 0, sizeof(relocs));
+	memset(&externs, 0, sizeof(externs));
+	ptr_map = NULL;
+	ptr_map_size = ptr_map_count = 0;
+	pending = NULL;
+	npending = pending_size = 0;
+}
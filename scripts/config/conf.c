@@ -156,6 +156,7 @@ static bool randomize_choice_values(struct symbol *csym)
 	csym->flags |= SYMBOL_DEF_USER;
 	/* clear VALID to get value calculated */
 	csym->flags &= ~SYMBOL_VALID;
+	expr_invalidate_values();
 
 	return true;
 }
@@ -728,6 +729,9 @@ static void conf_usage(const char *progname)
 	printf("  --yes2modconfig         Change answers from yes to mod if possible\n");
 	printf("  --mod2yesconfig         Change answers from mod to yes if possible\n");
 	printf("  (If none of the above is given, --oldaskconfig is the default)\n");
+	printf("\n");
+	printf("  %s --configexpr [-n | -p <prefix>] <expression>\n", progname);
+	printf("                          Set operations on config files, see confexpr.c\n");
 }
 
 int main(int ac, char **av)
@@ -740,6 +744,10 @@ int main(int ac, char **av)
 
 	tty_stdio = isatty(0) && isatty(1);
 
+	/* set operations on config files don't need a Kconfig tree */
+	if (ac > 1 && !strcmp(av[1], "--configexpr"))
+		return conf_expr_main(ac - 2, av + 2);
+
 	while ((opt = getopt_long(ac, av, "hr:sw:", long_opts, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
@@ -366,6 +366,7 @@ void conf_reset(int def)
 			sym->def[def].tri = no;
 		}
 	}
+	expr_invalidate_values();
 }
 
 int conf_read_simple(const char *name, int def)
@@ -583,6 +584,7 @@ int conf_read(const char *name)
 				if (sym_string_within_range(sym, sym->def[S_DEF_USER].val))
 					break;
 				sym->flags &= ~(SYMBOL_VALID|SYMBOL_DEF_USER);
+				expr_invalidate_values();
 				conf_unsaved++;
 				break;
 			default:
@@ -1159,4 +1161,5 @@ void set_all_choice_values(struct symbol *csym)
 	csym->flags |= SYMBOL_DEF_USER;
 	/* clear VALID to get value calculated */
 	csym->flags &= ~(SYMBOL_VALID | SYMBOL_NEED_SET_CHOICE_VALUES);
+	expr_invalidate_values();
 }
@@ -0,0 +1,372 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Set operations on configuration files, as done by scripts/kconfig.pl
+ *
+ * conf --configexpr [-n | -p <prefix>] <expression>
+ *
+ * An expression is either a file name or one of the following operators in
+ * prefix notation, followed by its two operands:
+ *   &     symbols set to the same value in both
+ *   +     symbols of both, the second one taking precedence
+ *   m+    like '+', but 'y' is not changed to 'm' or unset
+ *   >     symbols of the second one that are not set the same in the first
+ *   >+    like '>', but without symbols only unset in the second one
+ *   -     the first one without the symbols of the second one, which may be
+ *         POSIX extended regular expressions
+ *
+ * The resulting configuration is written to stdout, sorted by symbol name.
+ * The output is identical to the one of kconfig.pl, except that kconfig.pl
+ * uses Perl regular expressions for '-'.
+ */
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lkc.h"
+
+#define UNDEF		"#undef"
+#define HASHSIZE	16384
+
+struct centry {
+	struct centry *next;
+	char *name;
+	char *val;
+};
+
+struct cset {
+	struct centry *hash[HASHSIZE];
+	int count;
+};
+
+static const char *prefix = "CONFIG_";
+static char **args;
+static int nargs, pos;
+
+static unsigned int cset_hash(const char *s)
+{
+	/* fnv32 hash */
+	unsigned int hash = 2166136261U;
+
+	for (; *s; s++)
+		hash = (hash ^ (unsigned char)*s) * 0x01000193;
+	return hash % HASHSIZE;
+}
+
+static struct centry *cset_find(struct cset *set, const char *name)
+{
+	struct centry *e;
+
+	for (e = set->hash[cset_hash(name)]; e; e = e->next)
+		if (!strcmp(e->name, name))
+			return e;
+	return NULL;
+}
+
+static void cset_set(struct cset *set, const char *name, const char *val)
+{
+	struct centry *e = cset_find(set, name);
+	unsigned int hash;
+
+	if (e) {
+		e->val = xstrdup(val);
+		return;
+	}
+
+	hash = cset_hash(name);
+	e = xmalloc(sizeof(*e));
+	e->name = xstrdup(name);
+	e->val = xstrdup(val);
+	e->next = set->hash[hash];
+	set->hash[hash] = e;
+	set->count++;
+}
+
+static void cset_del(struct cset *set, const char *name)
+{
+	struct centry **p;
+
+	for (p = &set->hash[cset_hash(name)]; *p; p = &(*p)->next) {
+		if (!strcmp((*p)->name, name)) {
+			*p = (*p)->next;
+			set->count--;
+			return;
+		}
+	}
+}
+
+#define cset_for_each(set, i, e) \
+	for (i = 0; i < HASHSIZE; i++) for (e = (set)->hash[i]; e; e = e->next)
+
+static struct cset *cset_new(void)
+{
+	return xcalloc(1, sizeof(struct cset));
+}
+
+/* what Perl considers true */
+static bool str_true(const char *s)
+{
+	return s && *s && strcmp(s, "0");
+}
+
+static bool val_true(const struct centry *e)
+{
+	return e && str_true(e->val);
+}
+
+static void set_config(struct cset *set, const char *name, const char *val,
+		       bool mod_plus)
+{
+	struct centry *e = cset_find(set, name);
+
+	if (!e || !mod_plus || !strcmp(e->val, UNDEF) || !strcmp(val, "y"))
+		cset_set(set, name, val);
+}
+
+static struct cset *load_config(const char *file, bool mod_plus)
+{
+	struct cset *set = cset_new();
+	size_t len = strlen(prefix), size = 0;
+	char *line = NULL, *p, *q;
+	ssize_t n;
+	FILE *in;
+
+	in = fopen(file, "r");
+	if (!in) {
+		fprintf(stderr, "can't open file '%s'\n", file);
+		exit(1);
+	}
+
+	while ((n = getline(&line, &size, in)) >= 0) {
+		if (n > 0 && line[n - 1] == '\n')
+			line[--n] = 0;
+
+		/* <prefix><name>=<value>, the name ending at the first '=' */
+		if (!strncmp(line, prefix, len)) {
+			p = line + len;
+			for (q = p + 1; *p && (q = strchr(q, '=')); q++)
+				if (q[1])
+					break;
+			if (*p && q) {
+				*q = 0;
+				set_config(set, p, q + 1, mod_plus);
+				continue;
+			}
+		}
+
+		/* # <prefix><name> is not set */
+		if (!strncmp(line, "# ", 2) && !strncmp(line + 2, prefix, len)) {
+			p = line + 2 + len;
+			q = *p ? strstr(p + 1, " is not set") : NULL;
+			if (q) {
+				*q = 0;
+				set_config(set, p, UNDEF, mod_plus);
+				continue;
+			}
+		}
+
+		if (line[0] && line[0] != '#')
+			fprintf(stderr, "WARNING: can't parse line: %s\n", line);
+	}
+	free(line);
+	fclose(in);
+
+	return set;
+}
+
+static struct cset *config_and(struct cset *cfg1, struct cset *cfg2)
+{
+	struct cset *set = cset_new();
+	struct centry *e, *e2;
+	int i;
+
+	cset_for_each(cfg1, i, e) {
+		e2 = cset_find(cfg2, e->name);
+		if (val_true(e2) && !strcmp(e->val, e2->val))
+			cset_set(set, e->name, e->val);
+	}
+
+	return set;
+}
+
+static struct cset *config_add(struct cset *cfg1, struct cset *cfg2,
+			       bool mod_plus)
+{
+	struct cset *set = cset_new(), *cfg[] = { cfg1, cfg2 };
+	struct centry *e, *cur;
+	int i, j;
+
+	for (j = 0; j < 2; j++) {
+		cset_for_each(cfg[j], i, e) {
+			cur = cset_find(set, e->name);
+			if (mod_plus && val_true(cur) &&
+			    (!strcmp(cur->val, "y") || !strcmp(e->val, UNDEF)))
+				continue;
+			cset_set(set, e->name, e->val);
+		}
+	}
+
+	return set;
+}
+
+static struct cset *config_diff(struct cset *cfg1, struct cset *cfg2,
+				bool new_only)
+{
+	struct cset *set = cset_new();
+	struct centry *e, *e1;
+	int i;
+
+	cset_for_each(cfg2, i, e) {
+		e1 = cset_find(cfg1, e->name);
+		if (e1 && !strcmp(e1->val, e->val))
+			continue;
+		if (new_only && !e1 && !strcmp(e->val, UNDEF))
+			continue;
+		cset_set(set, e->name, e->val);
+	}
+
+	return set;
+}
+
+static struct cset *config_sub(struct cset *cfg1, struct cset *cfg2)
+{
+	struct cset *set = cset_new();
+	struct centry *e, *e2;
+	char *pattern;
+	regex_t re;
+	int i, j;
+
+	cset_for_each(cfg1, i, e)
+		cset_set(set, e->name, e->val);
+
+	cset_for_each(cfg2, i, e2) {
+		if (!strpbrk(e2->name, "?.*")) {
+			cset_del(set, e2->name);
+			continue;
+		}
+
+		pattern = xmalloc(strlen(e2->name) + 3);
+		sprintf(pattern, "^%s$", e2->name);
+		if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB)) {
+			fprintf(stderr, "unsupported pattern: %s\n", e2->name);
+			exit(1);
+		}
+		free(pattern);
+
+		/* entries are not freed, so deleting while iterating is fine */
+		cset_for_each(set, j, e)
+			if (!regexec(&re, e->name, 0, NULL, 0))
+				cset_del(set, e->name);
+		regfree(&re);
+	}
+
+	return set;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+	return strcmp((*(struct centry **)a)->name, (*(struct centry **)b)->name);
+}
+
+static void dump_config(struct cset *set)
+{
+	struct centry **list, *e;
+	int i, n = 0;
+
+	list = xmalloc((set->count + 1) * sizeof(*list));
+	cset_for_each(set, i, e)
+		list[n++] = e;
+	qsort(list, n, sizeof(*list), entry_cmp);
+
+	for (i = 0; i < n; i++) {
+		e = list[i];
+		if (!strcmp(e->val, UNDEF) || !strcmp(e->val, "n"))
+			printf("# %s%s is not set\n", prefix, e->name);
+		else
+			printf("%s%s=%s\n", prefix, e->name, e->val);
+	}
+	free(list);
+}
+
+static struct cset *parse_expr(bool mod_plus)
+{
+	struct cset *arg1, *arg2;
+	const char *arg;
+
+	if (pos >= nargs || !str_true(args[pos])) {
+		fprintf(stderr, "Parse error\n");
+		exit(1);
+	}
+	arg = args[pos++];
+
+	if (!strcmp(arg, "&")) {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(false);
+		return config_and(arg1, arg2);
+	} else if (arg[0] == '+') {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(false);
+		return config_add(arg1, arg2, false);
+	} else if (!strncmp(arg, "m+", 2)) {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(true);
+		return config_add(arg1, arg2, true);
+	} else if (!strcmp(arg, ">")) {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(false);
+		return config_diff(arg1, arg2, false);
+	} else if (!strcmp(arg, ">+")) {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(false);
+		return config_diff(arg1, arg2, true);
+	} else if (!strcmp(arg, "-")) {
+		arg1 = parse_expr(false);
+		arg2 = parse_expr(false);
+		return config_sub(arg1, arg2);
+	}
+
+	return load_config(arg, mod_plus);
+}
+
+static bool is_option(const char *arg)
+{
+	const char *p;
+
+	if (arg[0] != '-' || !arg[1])
+		return false;
+	for (p = arg + 1; *p; p++)
+		if (!(*p == '_' || (*p >= '0' && *p <= '9') ||
+		      ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z')))
+			return false;
+	return true;
+}
+
+int conf_expr_main(int ac, char **av)
+{
+	int i = 0;
+
+	while (i < ac && is_option(av[i])) {
+		if (!strcmp(av[i], "-n")) {
+			prefix = "";
+			i++;
+		} else if (!strcmp(av[i], "-p") && i + 1 < ac) {
+			prefix = av[i + 1];
+			i += 2;
+		} else {
+			fprintf(stderr, "Invalid option: %s\n", av[i]);
+			exit(1);
+		}
+	}
+
+	args = av + i;
+	nargs = ac - i;
+	dump_config(parse_expr(false));
+	if (pos < nargs && str_true(args[pos])) {
+		fprintf(stderr, "Parse error\n");
+		return 1;
+	}
+
+	return 0;
+}
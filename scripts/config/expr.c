@@ -1027,7 +1027,36 @@ static enum string_value_kind expr_parse_string(const char *str,
 	       ? kind : k_string;
 }
 
-tristate expr_calc_value(struct expr *e)
+/*
+ * The results of expr_calc_value() are cached in the expression nodes. They
+ * stay valid until the value of any symbol is invalidated, which starts a new
+ * epoch.
+ */
+static unsigned int expr_calc_epoch = 1;
+
+/*
+ * Set when a symbol used in the expression is still being calculated further
+ * up the call chain (choices and recursive dependencies). Such results are
+ * not cached.
+ */
+static bool expr_calc_unstable;
+
+void expr_invalidate_values(void)
+{
+	/* epoch 0 is never current, new expressions start out invalid */
+	expr_calc_epoch = (expr_calc_epoch + 1) & ((1U << 30) - 1);
+	if (!expr_calc_epoch)
+		expr_calc_epoch = 1;
+}
+
+static void expr_calc_sym(struct symbol *sym)
+{
+	sym_calc_value(sym);
+	if (sym->flags & SYMBOL_CALC)
+		expr_calc_unstable = true;
+}
+
+static tristate __expr_calc_value(struct expr *e)
 {
 	tristate val1, val2;
 	const char *str1, *str2;
@@ -1035,12 +1064,9 @@ tristate expr_calc_value(struct expr *e)
 	union string_value lval = {}, rval = {};
 	int res;
 
-	if (!e)
-		return yes;
-
 	switch (e->type) {
 	case E_SYMBOL:
-		sym_calc_value(e->left.sym);
+		expr_calc_sym(e->left.sym);
 		return e->left.sym->curr.tri;
 	case E_AND:
 		val1 = expr_calc_value(e->left.expr);
@@ -1065,8 +1091,8 @@ tristate expr_calc_value(struct expr *e)
 		return no;
 	}
 
-	sym_calc_value(e->left.sym);
-	sym_calc_value(e->right.sym);
+	expr_calc_sym(e->left.sym);
+	expr_calc_sym(e->right.sym);
 	str1 = sym_get_string_value(e->left.sym);
 	str2 = sym_get_string_value(e->right.sym);
 
@@ -1101,6 +1127,119 @@ tristate expr_calc_value(struct expr *e)
 	}
 }
 
+tristate expr_calc_value(struct expr *e)
+{
+	bool unstable;
+	tristate val;
+
+	if (!e)
+		return yes;
+
+	if (e->calc_epoch == expr_calc_epoch)
+		return e->calc_tri;
+
+	unstable = expr_calc_unstable;
+	expr_calc_unstable = false;
+	val = __expr_calc_value(e);
+	if (!expr_calc_unstable) {
+		e->calc_tri = val;
+		e->calc_epoch = expr_calc_epoch;
+	}
+	expr_calc_unstable |= unstable;
+
+	return val;
+}
+
+/*
+ * Hash-consing of finalized expressions: structurally identical subtrees are
+ * replaced by one shared node, so that e.g. the dependencies of a menu copied
+ * into every entry below it are only calculated once per epoch. Interned
+ * expressions must not be modified or freed.
+ */
+struct expr_intern_entry {
+	size_t hash;
+	struct expr *e;
+};
+
+static struct expr_intern_entry *expr_intern_table;
+static size_t expr_intern_size, expr_intern_count;
+
+static size_t expr_intern_hash(struct expr *e)
+{
+	size_t h = e->type;
+
+	h = (h ^ (size_t)e->left.expr) * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ (size_t)e->right.expr) * 0x9e3779b97f4a7c15ULL;
+	return h ^ (h >> 29);
+}
+
+static struct expr_intern_entry *expr_intern_slot(struct expr *e, size_t hash)
+{
+	size_t mask = expr_intern_size - 1;
+	size_t i = hash & mask;
+	struct expr_intern_entry *slot;
+	struct expr *c;
+
+	for (;; i = (i + 1) & mask) {
+		slot = &expr_intern_table[i];
+		c = slot->e;
+		if (!c || (slot->hash == hash && c->type == e->type &&
+			   c->left.expr == e->left.expr &&
+			   c->right.expr == e->right.expr))
+			return slot;
+	}
+}
+
+static struct expr *expr_intern_node(struct expr *e)
+{
+	struct expr_intern_entry *old_table = expr_intern_table;
+	size_t old_size = expr_intern_size;
+	struct expr_intern_entry *slot;
+	size_t i, hash;
+
+	if (expr_intern_count * 2 >= expr_intern_size) {
+		expr_intern_size = old_size ? old_size * 2 : 4096;
+		expr_intern_table = xcalloc(expr_intern_size,
+					    sizeof(*expr_intern_table));
+		for (i = 0; i < old_size; i++)
+			if (old_table[i].e)
+				*expr_intern_slot(old_table[i].e,
+						  old_table[i].hash) = old_table[i];
+		free(old_table);
+	}
+
+	hash = expr_intern_hash(e);
+	slot = expr_intern_slot(e, hash);
+	if (!slot->e) {
+		slot->hash = hash;
+		slot->e = e;
+		expr_intern_count++;
+	}
+	return slot->e;
+}
+
+struct expr *expr_intern(struct expr *e)
+{
+	if (!e)
+		return NULL;
+
+	switch (e->type) {
+	case E_AND:
+	case E_OR:
+		e->right.expr = expr_intern(e->right.expr);
+		/* fall through */
+	case E_NOT:
+		e->left.expr = expr_intern(e->left.expr);
+		break;
+	case E_LIST:
+		return e;
+	default:
+		break;
+	}
+
+	return expr_intern_node(e);
+}
+
 static int expr_compare_type(enum expr_type t1, enum expr_type t2)
 {
 	if (t1 == t2)
@@ -41,6 +41,15 @@ union expr_data {
 
 struct expr {
 	enum expr_type type;
+
+	/*
+	 * Cached result of expr_calc_value(), valid as long as calc_epoch
+	 * matches the current epoch, see expr_invalidate_values(). Packed
+	 * next to 'type' to keep the size of the structure.
+	 */
+	unsigned int calc_tri:2;
+	unsigned int calc_epoch:30;
+
 	union expr_data left, right;
 };
 
@@ -129,6 +138,13 @@ struct symbol {
 	 * "Weak" reverse dependencies through being implied by other symbols
 	 */
 	struct expr_value implied;
+
+	/*
+	 * Symbols whose value is calculated from the value of this one. Used
+	 * to only invalidate what depends on a symbol when it is changed.
+	 */
+	struct symbol **rdeps;
+	int rdeps_count;
 };
 
 #define for_all_symbols(i, sym) for (i = 0; i < SYMBOL_HASHSIZE; i++) for (sym = symbol_hash[i]; sym; sym = sym->next)
@@ -137,6 +153,7 @@ struct symbol {
 #define SYMBOL_CHECK      0x0008  /* used during dependency checking */
 #define SYMBOL_CHOICE     0x0010  /* start of a choice block (null name) */
 #define SYMBOL_CHOICEVAL  0x0020  /* used as a value in a choice block */
+#define SYMBOL_CALC       0x0040  /* symbol.curr is being calculated */
 #define SYMBOL_VALID      0x0080  /* set when symbol.curr is calculated */
 #define SYMBOL_OPTIONAL   0x0100  /* choice is optional - values can be 'n' */
 #define SYMBOL_WRITE      0x0200  /* write symbol to file (KCONFIG_CONFIG) */
@@ -144,6 +161,7 @@ struct symbol {
 #define SYMBOL_WRITTEN    0x0800  /* track info to avoid double-write to .config */
 #define SYMBOL_NO_WRITE   0x1000  /* Symbol for internal use only; it will not be written */
 #define SYMBOL_CHECKED    0x2000  /* used during dependency checking */
+#define SYMBOL_QUEUED     0x4000  /* used during invalidation */
 #define SYMBOL_WARNED     0x8000  /* warning has been issued */
 
 /* Set when symbol.def[] is used */
@@ -297,6 +315,8 @@ void expr_free(struct expr *e);
 void expr_eliminate_eq(struct expr **ep1, struct expr **ep2);
 int expr_eq(struct expr *e1, struct expr *e2);
 tristate expr_calc_value(struct expr *e);
+void expr_invalidate_values(void);
+struct expr *expr_intern(struct expr *e);
 struct expr *expr_trans_bool(struct expr *e);
 struct expr *expr_eliminate_dups(struct expr *e);
 struct expr *expr_transform(struct expr *e);
@@ -4059,8 +4059,12 @@ FILE *zconf_fopen(const char *name)
 			snprintf(fullname, sizeof(fullname),
 				 "%s/%s", env, name);
 			f = fopen(fullname, "r");
+			if (f)
+				name = fullname;
 		}
 	}
+	if (f)
+		conf_cache_add_file(name);
 	return f;
 }
 
@@ -4120,30 +4124,44 @@ static void __zconf_nextfile(const char *name)
 	current_file = file;
 }
 
-void zconf_nextfile(const char *name)
+/*
+ * Expand the file name pattern of a 'source' statement in the file
+ * 'curname'. Patterns without a match are also looked up relative to the
+ * directory of that file.
+ */
+int zconf_glob(const char *name, const char *curname, glob_t *gl)
 {
-	glob_t gl;
 	int err;
-	int i;
 	char path[PATH_MAX], *p;
 
-	err = glob(name, GLOB_ERR | GLOB_MARK, NULL, &gl);
+	err = glob(name, GLOB_ERR | GLOB_MARK, NULL, gl);
 
 	/* ignore wildcard patterns that return no result */
 	if (err == GLOB_NOMATCH && strchr(name, '*')) {
 		err = 0;
-		gl.gl_pathc = 0;
+		gl->gl_pathc = 0;
 	}
 
 	if (err == GLOB_NOMATCH) {
-		p = strdup(current_file->name);
+		p = strdup(curname);
 		if (p) {
 			snprintf(path, sizeof(path), "%s/%s", dirname(p), name);
-			err = glob(path, GLOB_ERR | GLOB_MARK, NULL, &gl);
+			err = glob(path, GLOB_ERR | GLOB_MARK, NULL, gl);
 			free(p);
 		}
 	}
 
+	return err;
+}
+
+void zconf_nextfile(const char *name)
+{
+	glob_t gl;
+	int err;
+	int i;
+
+	err = zconf_glob(name, current_file->name, &gl);
+
 	if (err) {
 		const char *reason = "unknown error";
 
@@ -4167,6 +4185,8 @@ void zconf_nextfile(const char *name)
 		exit(1);
 	}
 
+	conf_cache_add_glob(name, current_file->name, gl.gl_pathc, gl.gl_pathv);
+
 	for (i = 0; i < gl.gl_pathc; i++)
 		__zconf_nextfile(gl.gl_pathv[i]);
 }
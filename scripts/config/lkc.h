@@ -7,6 +7,7 @@
 #define LKC_H
 
 #include <assert.h>
+#include <glob.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -36,10 +37,24 @@ void zconf_starthelp(void);
 FILE *zconf_fopen(const char *name);
 void zconf_initscan(const char *name);
 void zconf_nextfile(const char *name);
+int zconf_glob(const char *name, const char *curname, glob_t *gl);
 int zconf_lineno(void);
 const char *zconf_curname(void);
 extern int recursive_is_error;
 
+/* cache.c */
+bool conf_cache_load(const char *name);
+void conf_cache_save(void);
+void conf_cache_add_file(const char *path);
+void conf_cache_add_glob(const char *pattern, const char *curname,
+			 size_t count, char **paths);
+void conf_cache_add_env(const char *name, const char *value);
+void conf_cache_add_shell(const char *cmd, const char *output);
+void conf_cache_disable(void);
+
+/* confexpr.c */
+int conf_expr_main(int ac, char **av);
+
 /* confdata.c */
 const char *conf_get_configname(void);
 void set_all_choice_values(struct symbol *csym);
@@ -42,12 +42,14 @@ enum variable_flavor {
 	VAR_RECURSIVE,
 	VAR_APPEND,
 };
+void env_add(const char *name, const char *value);
 void env_write_dep(FILE *f, const char *auto_conf_name);
 void variable_add(const char *name, const char *value,
 		  enum variable_flavor flavor);
 void variable_all_del(void);
 char *expand_dollar(const char **str);
 char *expand_one_token(const char **str);
+char *preprocess_shell(const char *cmd);
 
 /* expr.c */
 void expr_print(struct expr *e, void (*fn)(void *, struct symbol *, const char *), void *data, int prevtoken);
@@ -41,7 +41,7 @@ struct env {
 	struct list_head node;
 };
 
-static void env_add(const char *name, const char *value)
+void env_add(const char *name, const char *value)
 {
 	struct env *e;
 
@@ -75,6 +75,7 @@ static char *env_expand(const char *name)
 	}
 
 	value = getenv(name);
+	conf_cache_add_env(name, value);
 	if (!value)
 		return NULL;
 
@@ -124,6 +125,8 @@ static char *do_filename(int argc, char *argv[])
 
 static char *do_info(int argc, char *argv[])
 {
+	/* only messages on stderr are replayed from the cache */
+	conf_cache_disable();
 	printf("%s\n", argv[0]);
 
 	return xstrdup("");
@@ -138,16 +141,13 @@ static char *do_lineno(int argc, char *argv[])
 	return xstrdup(buf);
 }
 
-static char *do_shell(int argc, char *argv[])
+char *preprocess_shell(const char *cmd)
 {
 	FILE *p;
 	char buf[256];
-	char *cmd;
 	size_t nread;
 	int i;
 
-	cmd = argv[0];
-
 	p = popen(cmd, "r");
 	if (!p) {
 		perror(cmd);
@@ -178,6 +178,15 @@ static char *do_shell(int argc, char *argv[])
 	return xstrdup(buf);
 }
 
+static char *do_shell(int argc, char *argv[])
+{
+	char *output = preprocess_shell(argv[0]);
+
+	conf_cache_add_shell(argv[0], output);
+
+	return output;
+}
+
 static char *do_warning_if(int argc, char *argv[])
 {
 	if (!strcmp(argv[0], "y"))
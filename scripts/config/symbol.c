@@ -340,6 +340,7 @@ void sym_calc_value(struct symbol *sym)
 		return;
 	}
 	sym->flags &= ~SYMBOL_WRITE;
+	sym->flags |= SYMBOL_CALC;
 
 	sym_calc_visibility(sym);
 
@@ -416,6 +417,7 @@ void sym_calc_value(struct symbol *sym)
 	if (sym_is_choice(sym) && newval.tri == yes)
 		sym->curr.val = sym_calc_choice(sym);
 	sym_validate_range(sym);
+	sym->flags &= ~SYMBOL_CALC;
 
 	if (memcmp(&oldval, &sym->curr, sizeof(oldval))) {
 		sym_set_changed(sym);
@@ -452,10 +454,146 @@ void sym_clear_all_valid(void)
 
 	for_all_symbols(i, sym)
 		sym->flags &= ~SYMBOL_VALID;
+	expr_invalidate_values();
 	conf_set_changed(true);
 	sym_calc_value(modules_sym);
 }
 
+static void sym_add_rdep(struct symbol *sym, struct symbol *rdep)
+{
+	if (!sym || sym == rdep || (sym->flags & SYMBOL_CONST))
+		return;
+	/* all expressions of a symbol are scanned in a row */
+	if (sym->rdeps_count && sym->rdeps[sym->rdeps_count - 1] == rdep)
+		return;
+	if (!(sym->rdeps_count & (sym->rdeps_count - 1)))
+		sym->rdeps = xrealloc(sym->rdeps, (sym->rdeps_count ?
+				      sym->rdeps_count * 2 : 1) * sizeof(*sym->rdeps));
+	sym->rdeps[sym->rdeps_count++] = rdep;
+}
+
+static void expr_add_rdeps(struct expr *e, struct symbol *rdep)
+{
+	if (!e)
+		return;
+
+	switch (e->type) {
+	case E_AND:
+	case E_OR:
+		expr_add_rdeps(e->right.expr, rdep);
+		/* fall through */
+	case E_NOT:
+		expr_add_rdeps(e->left.expr, rdep);
+		break;
+	case E_SYMBOL:
+		sym_add_rdep(e->left.sym, rdep);
+		break;
+	case E_LIST:
+		for (; e; e = e->left.expr)
+			sym_add_rdep(e->right.sym, rdep);
+		break;
+	default:
+		sym_add_rdep(e->left.sym, rdep);
+		sym_add_rdep(e->right.sym, rdep);
+		break;
+	}
+}
+
+/*
+ * Set up what is needed to recalculate only part of the symbols, once the
+ * first single symbol is changed (e.g. in menuconfig or oldconfig).
+ *
+ * Identical expressions are shared first, so that e.g. the dependencies of a
+ * menu copied into every entry below it are only calculated once. Then every
+ * symbol records which other symbols are calculated from it.
+ */
+static void sym_init_rdeps(void)
+{
+	static bool done;
+	struct property *prop;
+	struct symbol *sym;
+	int i;
+
+	if (done)
+		return;
+	done = true;
+
+	for_all_symbols(i, sym) {
+		sym->dir_dep.expr = expr_intern(sym->dir_dep.expr);
+		sym->rev_dep.expr = expr_intern(sym->rev_dep.expr);
+		sym->implied.expr = expr_intern(sym->implied.expr);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			prop->expr = expr_intern(prop->expr);
+			prop->visible.expr = expr_intern(prop->visible.expr);
+		}
+	}
+
+	for_all_symbols(i, sym) {
+		expr_add_rdeps(sym->dir_dep.expr, sym);
+		expr_add_rdeps(sym->rev_dep.expr, sym);
+		expr_add_rdeps(sym->implied.expr, sym);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			/* these only affect the value of the target symbol */
+			if (prop->type == P_SELECT || prop->type == P_IMPLY)
+				continue;
+			expr_add_rdeps(prop->expr, sym);
+			expr_add_rdeps(prop->visible.expr, sym);
+		}
+		/* choice values are calculated from the choice */
+		if (sym_is_choice_value(sym))
+			sym_add_rdep(prop_get_symbol(sym_get_choice_prop(sym)),
+				     sym);
+	}
+}
+
+/*
+ * Invalidate the value of a symbol whose user value has changed, along with
+ * the values of all symbols calculated from it. Everything is invalidated if
+ * the modules symbol is affected, as it changes the type of all tristates.
+ */
+static void sym_invalidate(struct symbol *sym)
+{
+	struct symbol **queue, *rdep;
+	int i, j, n = 0, size = 64;
+	bool all = false;
+
+	sym_init_rdeps();
+
+	queue = xmalloc(size * sizeof(*queue));
+	queue[n++] = sym;
+	sym->flags |= SYMBOL_QUEUED;
+
+	for (i = 0; i < n; i++) {
+		sym = queue[i];
+		sym->flags &= ~SYMBOL_VALID;
+		if (sym == modules_sym)
+			all = true;
+		for (j = 0; j < sym->rdeps_count; j++) {
+			rdep = sym->rdeps[j];
+			if (rdep->flags & SYMBOL_QUEUED)
+				continue;
+			if (n == size) {
+				size *= 2;
+				queue = xrealloc(queue, size * sizeof(*queue));
+			}
+			queue[n++] = rdep;
+			rdep->flags |= SYMBOL_QUEUED;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		queue[i]->flags &= ~SYMBOL_QUEUED;
+	free(queue);
+
+	if (all) {
+		sym_clear_all_valid();
+		return;
+	}
+
+	expr_invalidate_values();
+	conf_set_changed(true);
+}
+
 bool sym_tristate_within_range(struct symbol *sym, tristate val)
 {
 	int type = sym_get_type(sym);
@@ -506,7 +644,7 @@ bool sym_set_tristate_value(struct symbol *sym, tristate val)
 
 	sym->def[S_DEF_USER].tri = val;
 	if (oldval != val)
-		sym_clear_all_valid();
+		sym_invalidate(sym);
 
 	return true;
 }
@@ -663,7 +801,7 @@ bool sym_set_string_value(struct symbol *sym, const char *newval)
 
 	strcpy(val, newval);
 	free((void *)oldval);
-	sym_clear_all_valid();
+	sym_invalidate(sym);
 
 	return true;
 }
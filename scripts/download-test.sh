@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# download-test - exercise download.pl against local mirrors
+#
+# Usage:
+#   ./scripts/download-test.sh
+#
+# Serves a scratch directory through "python3 -m http.server" and as a
+# file:// mirror, then checks that download.pl fetches from both, races
+# remote mirrors past a dead one and satisfies repeated downloads from
+# the content addressed store without touching any mirror.
+
+export LANG=C
+export LC_ALL=C
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+WORK="$(mktemp -d)"
+PORT="${PORT:-8123}"
+SERVER=
+
+cleanup() {
+	[ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail() {
+	echo "FAIL: $*" >&2
+	exit 1
+}
+
+mkdir -p "$WORK/mirror/sub" "$WORK/tmp"
+head -c 3000000 /dev/urandom > "$WORK/mirror/sub/test-1.0.tar.xz"
+HASH="$(sha256sum "$WORK/mirror/sub/test-1.0.tar.xz" | cut -d' ' -f1)"
+
+export TMPDIR="$WORK/tmp"
+export TOPDIR="$WORK"
+export DOWNLOAD_STORE="$WORK/store"
+export DOWNLOAD_CHECK_CERTIFICATE=n
+export DOWNLOAD_TOOL_CUSTOM=
+
+dl() {
+	"$SCRIPT_DIR/download.pl" "$WORK/dl" test-1.0.tar.xz "$HASH" "" "$@"
+}
+
+(cd "$WORK/mirror/sub" && exec python3 -m http.server "$PORT" --bind 127.0.0.1) >/dev/null 2>&1 &
+SERVER=$!
+for i in $(seq 50); do
+	curl -s -o /dev/null "http://127.0.0.1:$PORT/" && break
+	sleep 0.1
+done
+
+DOWNLOAD_MIRROR="file://$WORK/mirror" dl >/dev/null || fail "file:// mirror"
+cmp -s "$WORK/dl/test-1.0.tar.xz" "$WORK/mirror/sub/test-1.0.tar.xz" || fail "file:// content"
+ls "$TMPDIR"/.download-index-* >/dev/null 2>&1 || fail "file:// mirror index"
+[ -f "$DOWNLOAD_STORE/sha256/${HASH:0:2}/$HASH" ] || fail "store not populated"
+echo "ok - file:// mirror"
+
+rm -rf "$WORK/dl" "$DOWNLOAD_STORE"
+DOWNLOAD_MIRROR_RACE=3 dl "http://127.0.0.1:1" "http://127.0.0.1:$PORT" >/dev/null 2>&1 || fail "http mirror race"
+cmp -s "$WORK/dl/test-1.0.tar.xz" "$WORK/mirror/sub/test-1.0.tar.xz" || fail "http content"
+ls "$WORK/dl" | grep -q '\.dl' && fail "leftover partial downloads"
+echo "ok - http mirror race"
+
+kill "$SERVER"
+SERVER=
+rm -rf "$WORK/dl"
+dl "http://127.0.0.1:$PORT" >/dev/null || fail "download store"
+cmp -s "$WORK/dl/test-1.0.tar.xz" "$WORK/mirror/sub/test-1.0.tar.xz" || fail "store content"
+echo "ok - download store"
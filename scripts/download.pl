@@ -9,9 +9,14 @@
 
 use strict;
 use warnings;
+use Digest::MD5;
+use Digest::SHA;
 use File::Basename;
 use File::Copy;
+use File::Find;
+use File::Path qw(make_path);
 use Text::ParseWords;
+use Time::HiRes ();
 
 @ARGV > 2 or die "Syntax: $0 <target dir> <filename> <hash> <url filename> [<mirror> ...]\n";
 
@@ -27,6 +32,9 @@ my $ok;
 my $check_certificate = $ENV{DOWNLOAD_CHECK_CERTIFICATE} eq "y";
 my $custom_tool = $ENV{DOWNLOAD_TOOL_CUSTOM};
 my $download_tool;
+my $store = $ENV{DOWNLOAD_STORE};
+my $race = $ENV{DOWNLOAD_MIRROR_RACE};
+my %children;
 
 $url_filename or $url_filename = $filename;
 
@@ -63,15 +71,26 @@ sub which($) {
 	return $res;
 }
 
-sub hash_cmd() {
+sub hash_ctx() {
 	my $len = length($file_hash);
-	my $cmd;
 
-	$len == 64 and return "$ENV{'MKHASH'} sha256";
-	$len == 32 and return "$ENV{'MKHASH'} md5";
+	$len == 64 and return Digest::SHA->new(256);
+	$len == 32 and return Digest::MD5->new;
 	return undef;
 }
 
+sub hash_file($) {
+	my $file = shift;
+	my $ctx = hash_ctx() or return undef;
+
+	open my $fh, '<', $file or return undef;
+	binmode $fh;
+	$ctx->addfile($fh);
+	close $fh;
+
+	return $ctx->hexdigest;
+}
+
 sub tool_present {
 	my $tool_name = shift;
 	my $compare_line = shift;
@@ -138,13 +157,188 @@ sub download_cmd {
 	}
 }
 
-my $hash_cmd = hash_cmd();
-$hash_cmd or ($file_hash eq "skip") or die "Cannot find appropriate hash command, ensure the provided hash is either a MD5 or SHA256 checksum.\n";
+my $hash_ok = defined(hash_ctx());
+$hash_ok or ($file_hash eq "skip") or die "Cannot find appropriate hash command, ensure the provided hash is either a MD5 or SHA256 checksum.\n";
+
+sub verify
+{
+	my $file = shift;
+
+	$hash_ok or return 1;
+
+	my $sum = hash_file($file);
+	defined($sum) or die "Could not generate file hash\n";
+	return 1 if $sum eq lc($file_hash);
+
+	print STDERR "Hash of the downloaded file does not match (file: $sum, requested: $file_hash) - deleting download.\n";
+	unlink $file;
+	return 0;
+}
+
+# Content addressed store, shared between build trees. Files are kept
+# below <store>/<algorithm>/<first two hash digits>/<hash> and are only
+# ever added with an atomic rename, so concurrent readers and writers
+# never observe partial files.
+sub store_path
+{
+	$store and $hash_ok or return undef;
+
+	my $algo = length($file_hash) == 64 ? "sha256" : "md5";
+	my $hash = lc($file_hash);
+
+	return "$store/$algo/".substr($hash, 0, 2)."/$hash";
+}
+
+sub store_fetch
+{
+	my $out = shift;
+	my $path = store_path();
+
+	$path and -f $path or return 0;
+
+	print("Copying $filename from download store\n");
+	link($path, $out) or copy($path, $out) or return 0;
+	return verify($out);
+}
+
+sub store_put
+{
+	my $path = store_path() or return;
+
+	-f $path and return;
+	make_path(dirname($path));
+
+	my $tmp = "$path.$$";
+	if ((link("$target/$filename", $tmp) or copy("$target/$filename", $tmp)) and
+	    rename($tmp, $path)) {
+		return;
+	}
+
+	print STDERR "Failed to add $filename to download store $store\n";
+	unlink $tmp;
+}
+
+# Local mirrors are indexed once instead of being searched with find on
+# every call. The index is kept in TMPDIR together with the modification
+# times of all directories of the mirror and is only rebuilt when one of
+# them changed, i.e. when files were added, removed or renamed, not when
+# a file is missing from it.
+sub mirror_index
+{
+	my $dir = shift;
+	my $index_file = ($ENV{TMPDIR} || "/tmp")."/.download-index-".Digest::MD5::md5_hex($dir);
+	my (%index, %dirs);
+
+	if (open my $fh, '<', $index_file) {
+		my $valid = 0;
+		while (defined(my $line = readline $fh)) {
+			chomp $line;
+			my ($type, $key, $path) = split /\t/, $line, 3;
+			if ($type eq 'D') {
+				$valid = mirror_mtime($path) eq $key or last;
+			}
+			elsif ($type eq 'F') {
+				push @{$index{$key}}, $path;
+			}
+			else {
+				$valid = 0;
+				last;
+			}
+		}
+		close $fh;
+		return \%index if $valid;
+		%index = ();
+	}
+
+	eval {
+		find({
+			wanted => sub {
+				if (-d $_) {
+					$dirs{$File::Find::name} = mirror_mtime($_);
+				}
+				elsif (-f _) {
+					push @{$index{$_}}, $File::Find::name;
+				}
+			},
+			follow_fast => 1,
+			follow_skip => 2,
+		}, $dir);
+	};
+
+	my $tmp = "$index_file.$$";
+	if (!$@ and open my $fh, '>', $tmp) {
+		print $fh "D\t$dirs{$_}\t$_\n" foreach sort keys %dirs;
+		foreach my $name (sort keys %index) {
+			print $fh "F\t$name\t$_\n" foreach @{$index{$name}};
+		}
+		close $fh;
+		rename $tmp, $index_file or unlink $tmp;
+	}
+
+	return \%index;
+}
+
+sub mirror_mtime
+{
+	my $mtime = (Time::HiRes::stat(shift))[9];
+
+	return defined($mtime) ? sprintf("%.6f", $mtime) : "-";
+}
+
+sub mirror_lookup
+{
+	my $dir = shift;
+	my $paths = mirror_index($dir)->{$filename};
+
+	return $paths ? @$paths : ();
+}
+
+sub fetch
+{
+	my $url = shift;
+	my $out = shift;
+	my $download_filename = shift;
+	my @additional_mirrors = @_;
+
+	my @cmd = download_cmd($url, $download_filename, @additional_mirrors);
+	print STDERR "+ ".join(" ",@cmd)."\n";
+
+	my $pid = open(my $fetch_fd, '-|', @cmd) or die "Cannot launch aria2c, curl or wget.\n";
+	local $SIG{TERM} = sub { kill 'TERM', $pid; unlink $out; exit 1 };
+
+	open my $output, '>', $out or die "Cannot create file $out: $!\n";
+	binmode $output;
+
+	my $ctx = hash_ctx();
+	my $buffer;
+	while (read $fetch_fd, $buffer, 1048576) {
+		$ctx and $ctx->add($buffer);
+		print $output $buffer;
+	}
+	close $fetch_fd;
+	my $failed = $? >> 8;
+	close $output;
+
+	if ($failed) {
+		print STDERR "Download failed.\n";
+		unlink $out;
+		return 0;
+	}
+
+	$ctx or return 1;
+
+	my $sum = $ctx->hexdigest;
+	return 1 if $sum eq lc($file_hash);
+
+	print STDERR "Hash of the downloaded file does not match (file: $sum, requested: $file_hash) - deleting download.\n";
+	unlink $out;
+	return 0;
+}
 
 sub download
 {
 	my $mirror = shift;
-	my $download_filename = shift;
+	my $out = shift;
 	my @additional_mirrors = @_;
 
 	$mirror =~ s!/$!!;
@@ -152,90 +346,105 @@ sub download
 	if ($mirror =~ s!^file://!!) {
 		if (! -d "$mirror") {
 			print STDERR "Wrong local cache directory -$mirror-.\n";
-			cleanup();
-			return;
+			return 0;
 		}
 
-		if (! -d "$target") {
-			system("mkdir", "-p", "$target/");
+		my @links = mirror_lookup($mirror);
+
+		if (@links > 1) {
+			print(scalar(@links)." or more instances of $filename in $mirror found . Only one instance allowed.\n");
+			return 0;
 		}
 
-		if (! open TMPDLS, "find $mirror -follow -name $filename 2>/dev/null |") {
-			print("Failed to search for $filename in $mirror\n");
-			return;
+		if (! @links) {
+			print("No instances of $filename found in $mirror.\n");
+			return 0;
 		}
 
-		my $link;
+		print("Copying $filename from $links[0]\n");
+		copy($links[0], $out) or return 0;
+		return verify($out);
+	}
 
-		while (defined(my $line = readline TMPDLS)) {
-			chomp ($link = $line);
-			if ($. > 1) {
-				print("$. or more instances of $filename in $mirror found . Only one instance allowed.\n");
-				return;
-			}
-		}
+	fetch("$mirror/$url_filename", $out, $url_filename, @additional_mirrors) and return 1;
+	if ($url_filename ne $filename) {
+		fetch("$mirror/$filename", $out, $filename, @additional_mirrors) and return 1;
+	}
 
-		close TMPDLS;
+	return 0;
+}
 
-		if (! $link) {
-			print("No instances of $filename found in $mirror.\n");
-			return;
-		}
+sub stop_children
+{
+	foreach my $pid (keys %children) {
+		kill 'TERM', $pid;
+		waitpid($pid, 0);
+		unlink $children{$pid};
+	}
+	%children = ();
+}
+
+# Race up to $race remote mirrors at a time, taking them in order of
+# preference. The first one to deliver a file with the expected hash
+# wins and the remaining transfers are aborted.
+sub download_race
+{
+	while (1) {
+		while (keys %children < $race and @mirrors) {
+			my $mirror = shift @mirrors;
+
+			if ($mirror =~ m!^file://!) {
+				my $out = "$target/$filename.dl";
+				if (download($mirror, $out)) {
+					stop_children();
+					return $out;
+				}
+				next;
+			}
 
-		print("Copying $filename from $link\n");
-		copy($link, "$target/$filename.dl");
+			my $pid = fork();
+			defined($pid) or die "Cannot fork: $!\n";
 
-		$hash_cmd and do {
-			if (system("cat '$target/$filename.dl' | $hash_cmd > '$target/$filename.hash'")) {
-				print("Failed to generate hash for $filename\n");
-				return;
+			if (!$pid) {
+				my $out = "$target/$filename.dl.$$";
+
+				%children = ();
+				$SIG{INT} = $SIG{TERM} = sub { unlink $out; exit 1 };
+				exit(download($mirror, $out) ? 0 : 1);
 			}
-		};
-	} else {
-		my @cmd = download_cmd("$mirror/$download_filename", $download_filename, @additional_mirrors);
-		print STDERR "+ ".join(" ",@cmd)."\n";
-		open(FETCH_FD, '-|', @cmd) or die "Cannot launch aria2c, curl or wget.\n";
-		$hash_cmd and do {
-			open MD5SUM, "| $hash_cmd > '$target/$filename.hash'" or die "Cannot launch $hash_cmd.\n";
-		};
-		open OUTPUT, "> $target/$filename.dl" or die "Cannot create file $target/$filename.dl: $!\n";
-		my $buffer;
-		while (read FETCH_FD, $buffer, 1048576) {
-			$hash_cmd and print MD5SUM $buffer;
-			print OUTPUT $buffer;
+
+			$children{$pid} = "$target/$filename.dl.$pid";
 		}
-		$hash_cmd and close MD5SUM;
-		close FETCH_FD;
-		close OUTPUT;
-
-		if ($? >> 8) {
-			print STDERR "Download failed.\n";
-			cleanup();
-			return;
+
+		keys %children or return undef;
+
+		my $pid = waitpid(-1, 0);
+		my $out = delete $children{$pid};
+		defined($out) or next;
+
+		if ($? == 0) {
+			stop_children();
+			return $out;
 		}
 	}
+}
 
-	$hash_cmd and do {
-		my $sum = `cat "$target/$filename.hash"`;
-		$sum =~ /^(\w+)\s*/ or die "Could not generate file hash\n";
-		$sum = $1;
+sub download_serial
+{
+	while (my $mirror = shift @mirrors) {
+		my $out = "$target/$filename.dl";
 
-		if ($sum ne $file_hash) {
-			print STDERR "Hash of the downloaded file does not match (file: $sum, requested: $file_hash) - deleting download.\n";
-			cleanup();
-			return;
-		}
-	};
+		download($mirror, $out, @mirrors) and return $out;
+		unlink $out;
+	}
 
-	unlink "$target/$filename";
-	system("mv", "$target/$filename.dl", "$target/$filename");
-	cleanup();
+	return undef;
 }
 
 sub cleanup
 {
+	stop_children();
 	unlink "$target/$filename.dl";
-	unlink "$target/$filename.hash";
 }
 
 @mirrors = localmirrors();
@@ -330,34 +539,39 @@ push @mirrors, 'https://sources.cdn.openwrt.org';
 push @mirrors, 'https://sources.openwrt.org';
 push @mirrors, 'https://mirror2.openwrt.org/sources';
 
-if (-f "$target/$filename") {
-	$hash_cmd and do {
-		if (system("cat '$target/$filename' | $hash_cmd > '$target/$filename.hash'")) {
-			die "Failed to generate hash for $filename\n";
-		}
+make_path($target);
 
-		my $sum = `cat "$target/$filename.hash"`;
-		$sum =~ /^(\w+)\s*/ or die "Could not generate file hash\n";
-		$sum = $1;
+if (-f "$target/$filename") {
+	$hash_ok and do {
+		my $sum = hash_file("$target/$filename");
+		defined($sum) or die "Failed to generate hash for $filename\n";
 
-		cleanup();
-		exit 0 if $sum eq $file_hash;
+		if ($sum eq lc($file_hash)) {
+			store_put();
+			exit 0;
+		}
 
 		die "Hash of the local file $filename does not match (file: $sum, requested: $file_hash) - deleting download.\n";
-		unlink "$target/$filename";
 	};
 }
 
-$download_tool = select_tool();
+$SIG{INT} = $SIG{TERM} = sub { cleanup(); exit 1 };
 
-while (!-f "$target/$filename") {
-	my $mirror = shift @mirrors;
-	$mirror or die "No more mirrors to try - giving up.\n";
+my $out = "$target/$filename.dl";
+if (!store_fetch($out)) {
+	$download_tool = select_tool();
 
-	download($mirror, $url_filename, @mirrors);
-	if (!-f "$target/$filename" && $url_filename ne $filename) {
-		download($mirror, $filename, @mirrors);
-	}
+	# aria2c already spreads a single download over all mirrors
+	($race and $race =~ /^\d+$/ and $download_tool ne "aria2c") or $race = 1;
+
+	$out = $race > 1 ? download_race() : download_serial();
+	$out or do {
+		cleanup();
+		die "No more mirrors to try - giving up.\n";
+	};
 }
 
-$SIG{INT} = \&cleanup;
+unlink "$target/$filename";
+rename($out, "$target/$filename") or die "Cannot move $out to $target/$filename: $!\n";
+cleanup();
+store_put();
@@ -0,0 +1,233 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# host-cache - keep the files installed by host builds of tools/ and
+#              toolchain/ in a local cache directory
+#
+# Usage:
+#   host-cache.sh lock <lock dir> <owner pid>
+#   host-cache.sh store <lock dir> <owner pid> <cache dir> <key> <path key> <marker> <file list> <topdir> <root>...
+#   host-cache.sh restore <lock dir> <cache dir> <key> <path key> <file list> <topdir> <root>...
+#
+# While the cache is enabled, every host build takes the lock before it
+# starts writing to its install roots and touches <marker>, so that only one
+# build writes to them at a time. "store" then collects every file below the
+# roots whose inode changed after <marker>, writes them to <file list> and
+# releases the lock, but only if it is still held by <owner pid>; otherwise
+# the capture may have been interrupted and nothing is recorded. The lock is
+# a directory holding the pid of its owner (the make process of the build)
+# and is taken over once that process is gone.
+#
+# Files that an install leaves untouched, e.g. because they did not change
+# since the last build, are taken from the previous <file list> of the
+# build. With a <key> other than "-", the files are packed into
+# <cache dir>/<key>. "restore" unpacks an entry and writes its files to
+# <file list>.
+#
+# Text files that refer to <topdir> or one of the roots are rewritten on
+# restore, as are symlinks pointing into them, so that an entry can be used
+# by a tree in another location. If a binary file refers to one of these
+# paths, the entry is only valid for the same locations and is stored as
+# <key>-<path key> instead.
+
+export LC_ALL=C
+
+SELF=${0##*/}
+
+lock() {
+	local dir="$1" owner="$2" pid
+
+	while ! mkdir "$dir" 2>/dev/null; do
+		pid="$(cat "$dir/pid" 2>/dev/null)"
+		if [ -n "$pid" ] && ! kill -0 "$pid" 2>/dev/null; then
+			rm -rf "$dir"
+			continue
+		fi
+		sleep 0.2
+	done
+	echo "$owner" > "$dir/pid"
+}
+
+unlock() {
+	rm -rf "$1"
+}
+
+# writes the files changed after <marker> and those of the previous list
+# that still exist to <file list>, as "<root index> <path>" lines
+record() {
+	local files="$1" marker="$2" i=0 root
+	shift 2
+
+	for root in "$@"; do
+		mkdir -p "$root"
+		{
+			( cd "$root" && find . -path ./stamp -prune -o -cnewer "$marker" -print ) | \
+				sed -e '/^\.$/d' -e 's,^\./,,'
+			sed -n -e "s,^$i ,,p" "$files" 2>/dev/null | \
+			( cd "$root" && while read -r file; do
+				[ -e "$file" ] || [ -L "$file" ] && echo "$file"
+			done )
+		} | sort -u | sed -e "s,^,$i ,"
+		i=$((i + 1))
+	done > "$files.new" && mv "$files.new" "$files"
+}
+
+# entries are directories, so that they appear atomically by renaming
+store() {
+	local lock="$1" owner="$2" cache="$3" key="$4" pathkey="$5" marker="$6"
+	local files="$7" topdir="$8" tmp i root entry
+	shift 8
+
+	[ "$(cat "$lock/pid" 2>/dev/null)" = "$owner" ] && [ -f "$marker" ] || {
+		rm -f "$marker"
+		return 0
+	}
+
+	[ "$key" != "-" ] && mkdir -p "$cache" && tmp="$(mktemp -d "$cache/.$key.XXXXXX")" && chmod 755 "$tmp" || {
+		record "$files" "$marker" "$@"
+		rm -f "$marker"
+		unlock "$lock"
+		return 0
+	}
+	{ echo "$topdir"; printf '%s\n' "$@"; } > "$tmp/paths"
+	: > "$tmp/relocate"
+	: > "$tmp/links"
+
+	record "$files" "$marker" "$@" || {
+		rm -rf "$tmp"
+		rm -f "$marker"
+		unlock "$lock"
+		return 0
+	}
+
+	i=0
+	for root in "$@"; do
+		sed -n -e "s,^$i ,,p" "$files" > "$tmp/$i.list"
+
+		( cd "$root" && while read -r file; do
+			if [ -L "$file" ]; then
+				case "$(readlink "$file")" in
+					"$topdir"/*|"$root"/*) echo "$file" >&3 ;;
+				esac
+			elif [ -f "$file" ]; then
+				printf '%s\0' "$file"
+			fi
+		done < "$tmp/$i.list" 3> "$tmp/$i.links" | \
+			xargs -0 -r grep -l -F -f "$tmp/paths" -- ) > "$tmp/$i.refs"
+
+		( cd "$root" && tr '\n' '\0' < "$tmp/$i.refs" | \
+			xargs -0 -r grep -I -l -F -f "$tmp/paths" -- ) > "$tmp/$i.text"
+		cmp -s "$tmp/$i.refs" "$tmp/$i.text" || entry="$key-$pathkey"
+
+		sed -e "s,^,$i ," "$tmp/$i.text" >> "$tmp/relocate"
+		sed -e "s,^,$i ," "$tmp/$i.links" >> "$tmp/links"
+		tar -C "$root" --no-recursion -czf "$tmp/$i.tar.gz" -T "$tmp/$i.list" || {
+			rm -rf "$tmp"
+			unlock "$lock"
+			return 0
+		}
+		rm -f "$tmp/$i.list" "$tmp/$i.links" "$tmp/$i.refs" "$tmp/$i.text"
+		i=$((i + 1))
+	done
+
+	entry="${entry:-$key}"
+	[ -e "$cache/$entry" ] || mv "$tmp" "$cache/$entry" 2>/dev/null
+	rm -rf "$tmp"
+	rm -f "$marker"
+	unlock "$lock"
+	echo "$SELF: stored $entry"
+}
+
+restore() {
+	local lock="$1" cache="$2" key="$3" pathkey="$4" files="$5" topdir="$6"
+	local entry i root
+	shift 6
+
+	if [ -d "$cache/$key" ]; then
+		entry="$cache/$key"
+	elif [ -d "$cache/$key-$pathkey" ]; then
+		entry="$cache/$key-$pathkey"
+	else
+		echo "$SELF: $key not found" >&2
+		return 1
+	fi
+
+	lock "$lock" $$
+	rm -f "$files.new"
+	i=0
+	for root in "$@"; do
+		mkdir -p "$root"
+		tar -C "$root" -xzf "$entry/$i.tar.gz" && \
+		tar -tzf "$entry/$i.tar.gz" | \
+			sed -e 's,^\./,,' -e 's,/$,,' -e "s,^,$i ," >> "$files.new" || {
+			rm -f "$files.new"
+			unlock "$lock"
+			return 1
+		}
+		i=$((i + 1))
+	done
+	mv "$files.new" "$files"
+
+	{ echo "$topdir"; printf '%s\n' "$@"; } | \
+	perl -e '
+		my ($entry, @new) = @ARGV;
+		chomp(my @to = <STDIN>);
+		open my $fh, "<", "$entry/paths" or die;
+		chomp(my @from = <$fh>);
+		close $fh;
+		my %map;
+		$map{$from[$_]} = $to[$_] for 0 .. $#from;
+		delete $map{$_} for grep { $map{$_} eq $_ } keys %map;
+		exit 0 unless %map;
+		my $re = join "|", map quotemeta, sort { length $b <=> length $a } keys %map;
+		$re = qr/($re)/;
+
+		open $fh, "<", "$entry/relocate" or die;
+		while (<$fh>) {
+			chomp;
+			my ($i, $file) = split / /, $_, 2;
+			$file = "$new[$i]/$file";
+			open my $in, "<", $file or next;
+			my $data = do { local $/; <$in> };
+			close $in;
+			$data =~ s/$re/$map{$1}/g or next;
+			my $mode = (stat $file)[2] & 07777;
+			open my $out, ">", "$file.relocate" or die;
+			print $out $data;
+			close $out;
+			chmod $mode, "$file.relocate";
+			rename "$file.relocate", $file or die;
+		}
+		close $fh;
+
+		open $fh, "<", "$entry/links" or die;
+		while (<$fh>) {
+			chomp;
+			my ($i, $file) = split / /, $_, 2;
+			$file = "$new[$i]/$file";
+			my $target = readlink $file;
+			defined $target and $target =~ s/^$re/$map{$1}/ or next;
+			unlink $file;
+			symlink $target, $file or die;
+		}
+		close $fh;
+	' "$entry" "$@" || {
+		unlock "$lock"
+		return 1
+	}
+
+	unlock "$lock"
+	echo "$SELF: restored ${entry##*/}"
+}
+
+cmd="$1"
+shift
+case "$cmd" in
+	lock) lock "$@" ;;
+	store) store "$@" ;;
+	restore) restore "$@" ;;
+	*)
+		echo "usage: $SELF lock|store|restore ..." >&2
+		exit 1
+		;;
+esac
@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# image-bench - report image stage wall time for a set of -j levels
+#
+# Usage:
+#   ./scripts/image-bench.sh [-s <step>] [jobs...]
+#
+# Runs "make target/linux/install" once per given job count (default:
+# 1, 2, 4 and the number of online CPUs) against the current .config with
+# the build profile enabled, and prints the wall clock time of the per-device
+# image steps ("image/..." in the profile) of each run, from the start of
+# the first one to the end of the last one. Kernel and rootfs preparation are
+# not included. The kernel, packages and rootfs must already be built.
+#
+# With -s, the steps named <step>/... are reported instead, e.g.
+# "-s target-dir" for the per-device rootfs assembly of
+# CONFIG_TARGET_PER_DEVICE_ROOTFS.
+
+export LANG=C
+export LC_ALL=C
+
+if [ -n "$TOPDIR" ]; then
+	cd "$TOPDIR" || exit 1
+fi
+
+[ -f .config ] || {
+	echo "No .config found, run this from the top of the build tree" >&2
+	exit 1
+}
+
+STEP=image
+if [ "$1" = "-s" ]; then
+	STEP="$2"
+	shift 2
+fi
+
+JOBS="$*"
+[ -n "$JOBS" ] || JOBS="1 2 4 $(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)"
+
+PROFILE="$(mktemp -d)" || exit 1
+trap 'rm -rf "$PROFILE"' EXIT
+
+# prints the number of steps, their wall time and the sum of their durations
+image_time() {
+	STEP="$STEP" perl -F'\t' -lane '
+		next unless $F[0] =~ m{ \Q$ENV{STEP}\E/} && defined $F[6];
+		$n{$F[0]} = 1;
+		$start = $F[1] if !defined($start) || $F[1] < $start;
+		$end = $F[2] if !defined($end) || $F[2] > $end;
+		$sum += $F[2] - $F[1];
+		END {
+			printf "%d %.1f %.1f\n", scalar(keys %n),
+				defined($start) ? $end - $start : 0, $sum;
+		}
+	' "$1"
+}
+
+printf "%6s %8s %12s %12s\n" "jobs" "steps" "seconds" "step sum"
+for j in $(echo $JOBS | tr ' ' '\n' | sort -n -u); do
+	rm -f "$PROFILE/steps"
+	make -j"$j" target/linux/install BUILD_PROFILE=1 BUILD_PROFILE_DIR="$PROFILE" \
+		>/dev/null 2>&1 || {
+		echo "make -j$j target/linux/install failed" >&2
+		exit 1
+	}
+	[ -s "$PROFILE/steps" ] || {
+		echo "no build steps were recorded for -j$j" >&2
+		exit 1
+	}
+	printf "%6s %8s %12s %12s\n" "$j" $(image_time "$PROFILE/steps")
+done
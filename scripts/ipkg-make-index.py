@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+# ipkg-make-index - generate an opkg "Packages" index for a directory
+#
+# Single process replacement for ipkg-make-index.sh producing identical
+# output. Every package is opened once, the outer and inner gzip tar
+# streams are decoded in memory and the SHA256 sum is computed while
+# reading. Packages are processed in parallel on all available cores.
+#
+# An optional cache file (-c) keeps the generated index entry of every
+# package keyed on its path, size and modification time so that
+# unchanged packages are not read again on the next run.
+"""
+
+import getopt
+import hashlib
+import io
+import json
+import os
+import sys
+import tarfile
+from multiprocessing import Pool
+
+CACHE_VERSION = 1
+READ_SIZE = 256 * 1024
+
+
+class HashingReader(io.RawIOBase):
+    def __init__(self, fileobj):
+        self.fileobj = fileobj
+        self.hash = hashlib.sha256()
+
+    def readable(self):
+        return True
+
+    def readinto(self, buf):
+        data = self.fileobj.read(len(buf))
+        self.hash.update(data)
+        buf[: len(data)] = data
+        return len(data)
+
+    def drain(self):
+        while True:
+            data = self.fileobj.read(READ_SIZE)
+            if not data:
+                break
+            self.hash.update(data)
+
+
+def usage():
+    print("Usage: ipkg-make-index [-c <cache_file>] [-j <jobs>] <package_directory>",
+          file=sys.stderr)
+    sys.exit(1)
+
+
+def find_packages(pkg_dir):
+    pkgs = []
+    for root, dirs, files in os.walk(pkg_dir):
+        for name in files + [d for d in dirs if os.path.islink(os.path.join(root, d))]:
+            if name.endswith(".ipk"):
+                pkgs.append(os.path.join(root, name))
+
+    # match the ordering of "find | sort" in the C locale
+    return sorted(pkgs, key=os.fsencode)
+
+
+def skip_package(pkg):
+    name = os.path.basename(pkg).split("_", 1)[0]
+    return name in ("kernel", "libc")
+
+
+def read_control(reader):
+    with tarfile.open(fileobj=reader, mode="r|gz") as outer:
+        for member in outer:
+            if os.path.normpath(member.name) != "control.tar.gz":
+                continue
+
+            inner_data = outer.extractfile(member).read()
+            with tarfile.open(fileobj=io.BytesIO(inner_data), mode="r:gz") as inner:
+                for entry in inner:
+                    if os.path.normpath(entry.name) == "control":
+                        return inner.extractfile(entry).read()
+
+    raise ValueError("no ./control found in ./control.tar.gz")
+
+
+def index_entry(pkg, size, sha256sum, control):
+    filename = pkg[2:] if pkg.startswith("./") else pkg
+    prefix = b"Filename: %s\nSize: %d\nSHA256sum: %s\n" % (
+        os.fsencode(filename), size, sha256sum.encode())
+
+    lines = control.split(b"\n")
+    for i, line in enumerate(lines):
+        if line.startswith(b"Description:"):
+            lines[i] = prefix + line
+
+    return b"\n".join(lines)
+
+
+def process_package(pkg):
+    with open(pkg, "rb") as f:
+        size = os.fstat(f.fileno()).st_size
+        reader = HashingReader(f)
+        control = read_control(io.BufferedReader(reader, READ_SIZE))
+        reader.drain()
+
+    return index_entry(pkg, size, reader.hash.hexdigest(), control)
+
+
+def load_cache(cache_file):
+    try:
+        with open(cache_file, "r") as f:
+            cache = json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+    if cache.get("version") != CACHE_VERSION:
+        return {}
+
+    return cache.get("entries", {})
+
+
+def save_cache(cache_file, entries):
+    tmp_file = "%s.%d" % (cache_file, os.getpid())
+    with open(tmp_file, "w") as f:
+        json.dump({"version": CACHE_VERSION, "entries": entries}, f)
+    os.replace(tmp_file, cache_file)
+
+
+def cache_key(pkg):
+    st = os.stat(pkg)
+    return "%d:%d" % (st.st_size, st.st_mtime_ns)
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "c:j:")
+    except getopt.GetoptError:
+        usage()
+
+    cache_file = None
+    jobs = os.cpu_count() or 1
+    for o, v in opts:
+        if o == "-c":
+            cache_file = v
+        elif o == "-j":
+            jobs = max(1, int(v))
+
+    if len(args) != 1 or not os.path.isdir(args[0]):
+        usage()
+
+    pkg_dir = args[0]
+    pkgs = find_packages(pkg_dir)
+    if not pkgs:
+        sys.stdout.buffer.write(b"\n")
+        return 0
+
+    pkgs = [pkg for pkg in pkgs if not skip_package(pkg)]
+    cache = load_cache(cache_file) if cache_file else {}
+    keys = {pkg: cache_key(pkg) for pkg in pkgs}
+    entries = {}
+    todo = []
+
+    for pkg in pkgs:
+        cached = cache.get(pkg)
+        if cached and cached[0] == keys[pkg]:
+            entries[pkg] = cached[1].encode("utf-8", "surrogateescape")
+        else:
+            todo.append(pkg)
+
+    for pkg in todo:
+        print("Generating index for package %s" % pkg, file=sys.stderr)
+
+    if len(todo) > 1 and jobs > 1:
+        with Pool(min(jobs, len(todo))) as pool:
+            results = pool.map(process_package, todo, chunksize=4)
+    else:
+        results = [process_package(pkg) for pkg in todo]
+
+    entries.update(zip(todo, results))
+
+    out = sys.stdout.buffer
+    for pkg in pkgs:
+        out.write(entries[pkg])
+        out.write(b"\n")
+
+    if cache_file:
+        save_cache(cache_file, {
+            pkg: [keys[pkg], entries[pkg].decode("utf-8", "surrogateescape")]
+            for pkg in pkgs
+        })
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# mkhash-bench - compare mkhash sha256 throughput against sha256sum
+#
+# Usage:
+#   ./scripts/mkhash-bench.sh [<mkhash binary>] [<file>...]
+#
+# Without files, a set of random test files in a temporary directory is
+# hashed: one large file and many small ones, the typical mix seen in
+# $(DL_DIR) and package directories. Each tool hashes all files in a
+# single invocation and the wall clock time is printed.
+
+export LANG=C
+export LC_ALL=C
+
+MKHASH="${1:-${STAGING_DIR_HOST:-staging_dir/host}/bin/mkhash}"
+[ $# -gt 0 ] && shift
+
+[ -x "$MKHASH" ] || {
+	echo "mkhash binary $MKHASH not found" >&2
+	exit 1
+}
+
+cleanup() {
+	[ -n "$TMP" ] && rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+if [ $# -eq 0 ]; then
+	TMP="$(mktemp -d)"
+	dd if=/dev/urandom of="$TMP/large" bs=1M count=256 2>/dev/null
+	for i in $(seq 1 500); do
+		dd if=/dev/urandom of="$TMP/small-$i" bs=4k count=$((i % 64 + 1)) 2>/dev/null
+	done
+	set -- "$TMP"/*
+fi
+
+now() {
+	perl -MTime::HiRes=time -e 'printf "%.3f\n", time'
+}
+
+run() {
+	local name="$1"; shift
+	local start end
+
+	start=$(now)
+	"$@" > /dev/null || exit 1
+	end=$(now)
+	printf "%-24s %8s s\n" "$name" "$(perl -e "printf '%.3f', $end - $start")"
+}
+
+# warm up the page cache
+cat "$@" > /dev/null
+
+run "sha256sum" sha256sum "$@"
+run "mkhash sha256 -j1" "$MKHASH" sha256 -j 1 "$@"
+run "mkhash sha256" "$MKHASH" sha256 "$@"
+run "md5sum" md5sum "$@"
+run "mkhash md5" "$MKHASH" md5 "$@"
+
+[ "$(sha256sum "$@" | cut -d' ' -f1)" = "$("$MKHASH" sha256 "$@")" ] || {
+	echo "mkhash sha256 output differs from sha256sum" >&2
+	exit 1
+}
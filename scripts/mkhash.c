@@ -85,13 +85,31 @@
 #include <sys/endian.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define SHA256_X86_SHA
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+#define SHA256_ARM_SHA2
+#include <arm_neon.h>
+#endif
+
 #define ARRAY_SIZE(_n) (sizeof(_n) / sizeof((_n)[0]))
 
 #ifndef __FreeBSD__
@@ -451,6 +469,26 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 #define Maj(x, y, z)	((x & (y | z)) | (y & z))
 #define ROTR(x, n)	((x >> n) | (x << (32 - n)))
 
+/* SHA256 round constants. */
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
 /*
  * SHA256 block compression function.  The 256-bit state is transformed via
  * the 512-bit input block to produce a new state.
@@ -458,25 +496,6 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 static void
 SHA256_Transform(uint32_t * state, const unsigned char block[64])
 {
-	/* SHA256 round constants. */
-	static const uint32_t K[64] = {
-		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-		0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-		0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-		0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-		0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-		0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-		0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-		0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-		0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-	};
 	uint32_t W[64];
 	uint32_t S[8];
 	int i;
@@ -562,6 +581,150 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 		state[i] += S[i];
 }
 
+static void
+SHA256_Blocks_generic(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	while (blocks--) {
+		SHA256_Transform(state, data);
+		data += 64;
+	}
+}
+
+#ifdef SHA256_X86_SHA
+/*
+ * SHA256 block function using the x86 SHA extensions, four rounds per
+ * iteration with the message schedule computed by SHA256MSG1/SHA256MSG2.
+ */
+static void __attribute__((target("sha,sse4.1")))
+SHA256_Blocks_x86(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+	int i;
+
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);
+	state1 = _mm_shuffle_epi32(state1, 0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	while (blocks--) {
+		abef = state0;
+		cdgh = state1;
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				msg = _mm_loadu_si128((const __m128i *)(data + i * 16));
+				w[i] = _mm_shuffle_epi8(msg, mask);
+			} else {
+				tmp = _mm_alignr_epi8(w[(i - 1) & 3], w[(i - 2) & 3], 4);
+				msg = _mm_sha256msg1_epu32(w[i & 3], w[(i - 3) & 3]);
+				msg = _mm_add_epi32(msg, tmp);
+				w[i & 3] = _mm_sha256msg2_epu32(msg, w[(i - 1) & 3]);
+			}
+
+			msg = _mm_add_epi32(w[i & 3],
+				_mm_loadu_si128((const __m128i *)&K[i * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		data += 64;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+static bool
+SHA256_x86_supported(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	/* SSSE3 and SSE4.1 */
+	if (!(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+		return false;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* SHA */
+	return !!(ebx & (1 << 29));
+}
+#endif
+
+#ifdef SHA256_ARM_SHA2
+/* SHA256 block function using the ARMv8 cryptography extensions */
+static void
+SHA256_Blocks_arm(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	uint32x4_t state0, state1, abcd, efgh, msg, tmp, w[4];
+	int i;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+	while (blocks--) {
+		abcd = state0;
+		efgh = state1;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		for (i = 0; i < 16; i++) {
+			if (i >= 4)
+				w[i & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(w[i & 3], w[(i - 3) & 3]),
+					w[(i - 2) & 3], w[(i - 1) & 3]);
+
+			msg = vaddq_u32(w[i & 3], vld1q_u32(&K[i * 4]));
+			tmp = state0;
+			state0 = vsha256hq_u32(state0, state1, msg);
+			state1 = vsha256h2q_u32(state1, tmp, msg);
+		}
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+		data += 64;
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+#endif
+
+static void (*SHA256_Blocks)(uint32_t *state, const unsigned char *data,
+			     size_t blocks) = SHA256_Blocks_generic;
+
+/* Select the fastest block function supported by the host CPU */
+static void
+SHA256_Select(void)
+{
+#ifdef SHA256_X86_SHA
+	if (SHA256_x86_supported())
+		SHA256_Blocks = SHA256_Blocks_x86;
+#endif
+#ifdef SHA256_ARM_SHA2
+	SHA256_Blocks = SHA256_Blocks_arm;
+#endif
+}
+
 static unsigned char PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -585,7 +748,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	} else {
 		/* Finish the current block and mix. */
 		memcpy(&ctx->buf[r], PAD, 64 - r);
-		SHA256_Transform(ctx->state, ctx->buf);
+		SHA256_Blocks(ctx->state, ctx->buf, 1);
 
 		/* The start of the final block is all zeroes. */
 		memset(&ctx->buf[0], 0, 56);
@@ -595,7 +758,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	be64enc(&ctx->buf[56], ctx->count);
 
 	/* Mix in the final block. */
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 }
 
 /* SHA-256 initialization.  Begins a SHA-256 operation. */
@@ -642,15 +805,15 @@ SHA256_Update(SHA256_CTX * ctx, const void *in, size_t len)
 
 	/* Finish the current block */
 	memcpy(&ctx->buf[r], src, 64 - r);
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 	src += 64 - r;
 	len -= 64 - r;
 
 	/* Perform complete blocks */
-	while (len >= 64) {
-		SHA256_Transform(ctx->state, src);
-		src += 64;
-		len -= 64;
+	if (len >= 64) {
+		SHA256_Blocks(ctx->state, src, len / 64);
+		src += len & ~(size_t)0x3f;
+		len &= 0x3f;
 	}
 
 	/* Copy left over data into buffer */
@@ -674,71 +837,243 @@ SHA256_Final(unsigned char digest[static SHA256_DIGEST_LENGTH], SHA256_CTX *ctx)
 	memset(ctx, 0, sizeof(*ctx));
 }
 
-static void *hash_buf(FILE *f, int *len)
+#define HASH_READ_SIZE	(64 * 1024)
+#define HASH_MMAP_SIZE	(1024 * 1024)
+
+struct hash_ctx {
+	union {
+		MD5_CTX md5;
+		SHA256_CTX sha256;
+	};
+};
+
+struct hash_type {
+	const char *name;
+	void (*init)(struct hash_ctx *ctx);
+	void (*update)(struct hash_ctx *ctx, const void *data, size_t len);
+	void (*final)(struct hash_ctx *ctx, unsigned char *digest);
+	int len;
+};
+
+struct hash_job {
+	const char *filename;
+	char str[SHA256_DIGEST_LENGTH * 2 + 1];
+	char err[64];
+};
+
+struct hash_pool {
+	struct hash_type *type;
+	struct hash_job *jobs;
+	int n_jobs;
+	int next;
+	pthread_mutex_t lock;
+};
+
+static void md5_init(struct hash_ctx *ctx)
+{
+	MD5_begin(&ctx->md5);
+}
+
+static void md5_update(struct hash_ctx *ctx, const void *data, size_t len)
 {
-	static char buf[1024];
+	MD5_hash(data, len, &ctx->md5);
+}
+
+static void md5_final(struct hash_ctx *ctx, unsigned char *digest)
+{
+	MD5_end(digest, &ctx->md5);
+}
 
-	*len = fread(buf, 1, sizeof(buf), f);
+static void sha256_init(struct hash_ctx *ctx)
+{
+	SHA256_Init(&ctx->sha256);
+}
 
-	return *len > 0 ? buf : NULL;
+static void sha256_update(struct hash_ctx *ctx, const void *data, size_t len)
+{
+	SHA256_Update(&ctx->sha256, data, len);
 }
 
-static char *hash_string(unsigned char *buf, int len)
+static void sha256_final(struct hash_ctx *ctx, unsigned char *digest)
 {
-	static char str[SHA256_DIGEST_LENGTH * 2 + 1];
-	int i;
+	SHA256_Final(digest, &ctx->sha256);
+}
 
-	if (len * 2 + 1 > sizeof(str))
-		return NULL;
+struct hash_type types[] = {
+	{ "md5", md5_init, md5_update, md5_final, MD5_DIGEST_LENGTH },
+	{ "sha256", sha256_init, sha256_update, sha256_final, SHA256_DIGEST_LENGTH },
+};
+
+static void hash_string(char *str, const unsigned char *buf, int len)
+{
+	int i;
 
 	for (i = 0; i < len; i++)
 		sprintf(&str[i * 2], "%02x", buf[i]);
-
-	return str;
 }
 
-static const char *md5_hash(FILE *f)
+static bool hash_mmap(struct hash_type *t, struct hash_ctx *ctx, int fd,
+		      size_t size)
 {
-	MD5_CTX ctx;
-	unsigned char val[MD5_DIGEST_LENGTH];
-	void *buf;
-	int len;
+	void *data;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return false;
 
-	MD5_begin(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		MD5_hash(buf, len, &ctx);
-	MD5_end(val, &ctx);
+#ifdef MADV_SEQUENTIAL
+	madvise(data, size, MADV_SEQUENTIAL);
+#endif
+	t->update(ctx, data, size);
+	munmap(data, size);
 
-	return hash_string(val, MD5_DIGEST_LENGTH);
+	return true;
 }
 
-static const char *sha256_hash(FILE *f)
+static int hash_fd(struct hash_type *t, int fd, char *str)
 {
-	SHA256_CTX ctx;
 	unsigned char val[SHA256_DIGEST_LENGTH];
-	void *buf;
-	int len;
+	struct hash_ctx ctx;
+	struct stat st;
+	char *buf;
+	ssize_t len;
+
+	t->init(&ctx);
+
+	if (!fstat(fd, &st) && S_ISREG(st.st_mode) &&
+	    st.st_size >= HASH_MMAP_SIZE &&
+	    hash_mmap(t, &ctx, fd, st.st_size))
+		goto out;
+
+	buf = malloc(HASH_READ_SIZE);
+	if (!buf)
+		return -1;
+
+	while ((len = read(fd, buf, HASH_READ_SIZE)) != 0) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			free(buf);
+			return -1;
+		}
+		t->update(&ctx, buf, len);
+	}
+	free(buf);
 
-	SHA256_Init(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		SHA256_Update(&ctx, buf, len);
-	SHA256_Final(val, &ctx);
+out:
+	t->final(&ctx, val);
+	hash_string(str, val, t->len);
 
-	return hash_string(val, SHA256_DIGEST_LENGTH);
+	return 0;
 }
 
+static int hash_job_run(struct hash_type *t, struct hash_job *job)
+{
+	const char *filename = job->filename;
+	struct stat path_stat;
+	int fd, ret;
 
-struct hash_type {
-	const char *name;
-	const char *(*func)(FILE *f);
-	int len;
-};
+	if (!filename || !strcmp(filename, "-"))
+		return hash_fd(t, STDIN_FILENO, job->str);
 
-struct hash_type types[] = {
-	{ "md5", md5_hash, MD5_DIGEST_LENGTH },
-	{ "sha256", sha256_hash, SHA256_DIGEST_LENGTH },
-};
+	if (!stat(filename, &path_stat) && S_ISDIR(path_stat.st_mode)) {
+		snprintf(job->err, sizeof(job->err), "Is a directory");
+		return -1;
+	}
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	ret = hash_fd(t, fd, job->str);
+	close(fd);
+
+	return ret;
+}
+
+static void *hash_worker(void *arg)
+{
+	struct hash_pool *pool = arg;
+	struct hash_job *job;
+	int idx;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		idx = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (idx >= pool->n_jobs)
+			break;
+
+		job = &pool->jobs[idx];
+		if (hash_job_run(pool->type, job))
+			job->str[0] = 0;
+	}
+
+	return NULL;
+}
+
+/*
+ * Hash all files on up to n_threads threads. Results are printed in the
+ * order of the command line, stopping at the first file that fails.
+ */
+static int hash_files(struct hash_type *t, struct hash_job *jobs, int n_jobs,
+		      int n_threads, bool add_filename, bool no_newline)
+{
+	struct hash_pool pool = {
+		.type = t,
+		.jobs = jobs,
+		.n_jobs = n_jobs,
+	};
+	pthread_t *threads = NULL;
+	int i, n_started = 0;
+
+	if (n_threads > n_jobs)
+		n_threads = n_jobs;
 
+	pthread_mutex_init(&pool.lock, NULL);
+
+	if (n_threads > 1)
+		threads = calloc(n_threads - 1, sizeof(*threads));
+
+	for (i = 0; threads && i < n_threads - 1; i++) {
+		if (pthread_create(&threads[i], NULL, hash_worker, &pool))
+			break;
+		n_started++;
+	}
+
+	hash_worker(&pool);
+
+	for (i = 0; i < n_started; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_mutex_destroy(&pool.lock);
+
+	for (i = 0; i < n_jobs; i++) {
+		struct hash_job *job = &jobs[i];
+		const char *filename = job->filename;
+
+		if (!job->str[0]) {
+			if (job->err[0])
+				fprintf(stderr, "Failed to open '%s': %s\n",
+					filename, job->err);
+			else if (filename && strcmp(filename, "-"))
+				fprintf(stderr, "Failed to open '%s'\n", filename);
+			else
+				fprintf(stderr, "Failed to generate hash\n");
+			return 1;
+		}
+
+		if (add_filename)
+			printf("%s %s%s", job->str, filename ? filename : "-",
+				no_newline ? "" : "\n");
+		else
+			printf("%s%s", job->str, no_newline ? "" : "\n");
+	}
+
+	return 0;
+}
 
 static int usage(const char *progname)
 {
@@ -748,6 +1083,7 @@ static int usage(const char *progname)
 		"Options:\n"
 		"	-n		Print filename(s)\n"
 		"	-N		Suppress trailing newline\n"
+		"	-j <jobs>	Number of files hashed in parallel\n"
 		"\n"
 		"Supported hash types:", progname);
 
@@ -772,53 +1108,15 @@ static struct hash_type *get_hash_type(const char *name)
 }
 
 
-static int hash_file(struct hash_type *t, const char *filename, bool add_filename,
-	bool no_newline)
-{
-	const char *str;
-
-	if (!filename || !strcmp(filename, "-")) {
-		str = t->func(stdin);
-	} else {
-		struct stat path_stat;
-		stat(filename, &path_stat);
-		if (S_ISDIR(path_stat.st_mode)) {
-			fprintf(stderr, "Failed to open '%s': Is a directory\n", filename);
-			return 1;
-		}
-
-		FILE *f = fopen(filename, "r");
-
-		if (!f) {
-			fprintf(stderr, "Failed to open '%s'\n", filename);
-			return 1;
-		}
-		str = t->func(f);
-		fclose(f);
-	}
-
-	if (!str) {
-		fprintf(stderr, "Failed to generate hash\n");
-		return 1;
-	}
-
-	if (add_filename)
-		printf("%s %s%s", str, filename ? filename : "-",
-			no_newline ? "" : "\n");
-	else
-		printf("%s%s", str, no_newline ? "" : "\n");
-	return 0;
-}
-
-
 int main(int argc, char **argv)
 {
 	struct hash_type *t;
+	struct hash_job *jobs;
 	const char *progname = argv[0];
-	int i, ch;
+	int i, ch, ret, n_threads = 0;
 	bool add_filename = false, no_newline = false;
 
-	while ((ch = getopt(argc, argv, "nN")) != -1) {
+	while ((ch = getopt(argc, argv, "nNj:")) != -1) {
 		switch (ch) {
 		case 'n':
 			add_filename = true;
@@ -826,6 +1124,9 @@ int main(int argc, char **argv)
 		case 'N':
 			no_newline = true;
 			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			break;
 		default:
 			return usage(progname);
 		}
@@ -841,14 +1142,25 @@ int main(int argc, char **argv)
 	if (!t)
 		return usage(progname);
 
-	if (argc < 2)
-		return hash_file(t, NULL, add_filename, no_newline);
+	SHA256_Select();
 
-	for (i = 0; i < argc - 1; i++) {
-		int ret = hash_file(t, argv[1 + i], add_filename, no_newline);
-		if (ret)
-			return ret;
+	if (n_threads <= 0)
+		n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads <= 0)
+		n_threads = 1;
+
+	jobs = calloc(argc > 1 ? argc - 1 : 1, sizeof(*jobs));
+	if (!jobs) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
 	}
 
-	return 0;
+	for (i = 0; i < argc - 1; i++)
+		jobs[i].filename = argv[1 + i];
+
+	ret = hash_files(t, jobs, argc > 1 ? argc - 1 : 1, n_threads,
+			 add_filename, no_newline);
+	free(jobs);
+
+	return ret;
 }
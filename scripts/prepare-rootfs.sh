@@ -0,0 +1,132 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# prepare-rootfs - run postinst scripts and set up init scripts of a rootfs
+#
+# Usage:
+#   ./scripts/prepare-rootfs.sh <root> [<disabled services>] [<init script list>]
+#
+# Everything runs from a single shell. lib/functions.sh of the target is
+# sourced once and the default postinst scripts generated by
+# include/package-ipkg.mk are run as a function in a subshell instead of
+# starting a new shell for every package. Init scripts with plain numeric
+# START/STOP values get their /etc/rc.d links created directly, all others
+# still go through rc.common. If the init script list file exists, only
+# the scripts named in it are enabled or disabled.
+
+SELF=${0##*/}
+ROOT="$1"
+DISABLED=" $2 "
+INIT_LIST="$3"
+
+[ -d "$ROOT" ] || {
+	echo "usage: $SELF <root> [<disabled services>] [<init script list>]" >&2
+	exit 1
+}
+
+cd "$ROOT" || exit 1
+export IPKG_INSTROOT="$ROOT"
+
+# Init scripts are set up below for all packages at once
+export IPKG_DEFER_INIT=1
+
+SHELL_BIN="$(command -v bash)"
+DEFAULT_POSTINST='#!/bin/sh
+[ "${IPKG_NO_SCRIPT}" = "1" ] && exit 0
+[ -s ${IPKG_INSTROOT}/lib/functions.sh ] || exit 0
+. ${IPKG_INSTROOT}/lib/functions.sh
+default_postinst $0 $@
+'
+
+# $0 of a postinst run as a function is set to the script, as postinst-pkg
+# scripts may use it, which needs bash 5
+HAVE_FUNCTIONS=
+[ "${BASH_VERSINFO[0]}" -ge 5 ] && [ -s ./lib/functions.sh ] && \
+	. ./lib/functions.sh && HAVE_FUNCTIONS=1
+
+read_file() {
+	FILE_DATA=
+	IFS= read -r -d '' FILE_DATA < "$1"
+	return 0
+}
+
+rc_links() {
+	local script="$1"
+	local action="$2"
+	local name="${script##*/}"
+	local start= stop= line
+
+	while IFS= read -r line; do
+		case "$line" in
+		*enable*\(\)*|*disable*\(\)*)
+			return 1
+			;;
+		START=*)
+			start="${line#START=}"
+			[[ "$start" =~ ^[0-9]+$ ]] || return 1
+			;;
+		STOP=*)
+			stop="${line#STOP=}"
+			[[ "$stop" =~ ^[0-9]+$ ]] || return 1
+			;;
+		*START=*|*STOP=*)
+			return 1
+			;;
+		esac
+	done < "$script"
+
+	if [ "$action" = "enable" ]; then
+		[ -n "$start$stop" ] || {
+			echo "$name does not have a START or STOP value" >&2
+			return 0
+		}
+		rm -f etc/rc.d/S??$name etc/rc.d/K??$name
+		[ -n "$start" ] && ln -sf "../init.d/$name" "etc/rc.d/S${start}${name##S[0-9][0-9]}"
+		[ -n "$stop" ] && ln -sf "../init.d/$name" "etc/rc.d/K${stop}${name##K[0-9][0-9]}"
+	else
+		rm -f etc/rc.d/S??$name etc/rc.d/K??$name
+	fi
+
+	return 0
+}
+
+for script in ./usr/lib/opkg/info/*.postinst; do
+	[ -f "$script" ] || continue
+
+	read_file "$script"
+	if [ -n "$HAVE_FUNCTIONS" ] && [ "$FILE_DATA" = "$DEFAULT_POSTINST" ]; then
+		( BASH_ARGV0="$script"; default_postinst "$script" )
+	else
+		"$SHELL_BIN" "$script"
+	fi
+	ret=$?
+
+	if [ $ret -ne 0 ]; then
+		echo "postinst script $script has failed with exit code $ret" >&2
+		exit 1
+	fi
+done
+
+if [ -n "$INIT_LIST" ] && [ -f "$INIT_LIST" ]; then
+	mapfile -t scripts < <(sed 's:^:.:' "$INIT_LIST")
+else
+	scripts=(./etc/init.d/*)
+fi
+
+for script in "${scripts[@]}"; do
+	[ -f "$script" ] || continue
+
+	read_file "$script"
+	[[ "$FILE_DATA" == *'#!/bin/sh /etc/rc.common'* ]] || continue
+
+	name="${script##*/}"
+	if [[ "$DISABLED" != *" $name "* ]]; then
+		rc_links "$script" enable || "$SHELL_BIN" ./etc/rc.common "$script" enable
+		echo "Enabling $name"
+	else
+		rc_links "$script" disable || "$SHELL_BIN" ./etc/rc.common "$script" disable
+		echo "Disabling $name"
+	fi
+done
+
+exit 0
@@ -0,0 +1,34 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# prereq-key - print the cache key of a host prerequisite check
+#
+# Usage:
+#   ./scripts/prereq-key.sh <check definition> [<tmp dir>]
+#
+# The key covers the text of the check and the path, size and modification
+# time of every host binary or file it refers to: words resolving to an
+# executable in $PATH and absolute paths of existing regular files. Files
+# below <tmp dir> are scratch files of the checks and are left out. Symlinks
+# are listed both as link and as target, so that re-pointing one of the
+# links in staging_dir/host/bin changes the key as well.
+
+export LC_ALL=C
+
+def="$1"
+tmp="${2:-/nonexistent}"
+
+{
+	printf '%s\n' "$def"
+	printf '%s\n' "$def" | tr -c 'A-Za-z0-9_./+-' '\n' | sort -u | \
+	while read -r word; do
+		case "$word" in
+			"$tmp"/*) continue ;;
+			/*) file="$word" ;;
+			*) file="$(command -v "$word" 2>/dev/null)" || continue ;;
+		esac
+		case "$file" in
+			/*) [ -f "$file" ] && ls -ldL -- "$file" && ls -ld -- "$file" ;;
+		esac
+	done
+} | cksum | cut -d' ' -f1
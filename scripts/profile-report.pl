@@ -0,0 +1,164 @@
+#!/usr/bin/env perl
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# profile-report - summarize the steps recorded by scripts/profile.pl
+#
+# Usage:
+#   ./scripts/profile-report.pl [-n <count>] <profile dir>
+#
+# Reads <profile dir>/steps and writes <profile dir>/trace.json, which can
+# be loaded into chrome://tracing or https://ui.perfetto.dev, and
+# <profile dir>/report.txt, which is printed as well. The report lists the
+# time spent per kind of step, the <count> longest steps (default 20) and
+# an estimate of the critical path: starting at the step that finished
+# last, each step is preceded by the step that finished last before it
+# started, or by the previous step of the same package if that one finished
+# less than a second earlier. Recipes do not record their prerequisites, so
+# this is a guess, but a good one for steps that waited for a dependency.
+
+use strict;
+use warnings;
+use Getopt::Std;
+
+my %opts;
+getopts('n:', \%opts) && @ARGV == 1 or
+	die "Usage: $0 [-n <count>] <profile dir>\n";
+
+my $dir = $ARGV[0];
+my $top = $opts{n} // 20;
+
+my %steps;
+
+open my $in, '<', "$dir/steps" or die "Cannot open $dir/steps: $!\n";
+while (<$in>) {
+	chomp;
+	my ($id, $start, $end, $user, $sys, $rss, $rc) = split /\t/;
+	next unless defined $rc;
+
+	my $s = $steps{$id} //= {
+		id => $id,
+		start => $start,
+		end => $end,
+		user => 0,
+		sys => 0,
+		rss => 0,
+		rc => 0,
+	};
+	$s->{start} = $start if $start < $s->{start};
+	$s->{end} = $end if $end > $s->{end};
+	$s->{user} += $user;
+	$s->{sys} += $sys;
+	$s->{rss} = $rss if $rss > $s->{rss};
+	$s->{rc} ||= $rc;
+}
+close $in;
+
+my @steps = sort { $a->{start} <=> $b->{start} } values %steps;
+@steps or die "No steps recorded in $dir/steps\n";
+
+foreach my $s (@steps) {
+	($s->{name}, $s->{step}) = split / /, $s->{id}, 2;
+	$s->{step} //= '';
+	($s->{kind}) = split m{/}, $s->{step};
+	$s->{kind} ||= 'other';
+	$s->{time} = $s->{end} - $s->{start};
+}
+
+my $t0 = $steps[0]{start};
+my $t1 = (sort { $b <=> $a } map { $_->{end} } @steps)[0];
+my $wall = $t1 - $t0;
+
+# lanes for the trace, the first one that is free when the step starts
+my @lanes;
+foreach my $s (@steps) {
+	my $lane = 0;
+	$lane++ while $lane < @lanes && $lanes[$lane] > $s->{start};
+	$lanes[$lane] = $s->{end};
+	$s->{lane} = $lane + 1;
+}
+
+sub json_str {
+	my $str = shift;
+	$str =~ s/(["\\])/\\$1/g;
+	$str =~ s/([\x00-\x1f])/sprintf '\\u%04x', ord $1/ge;
+	return "\"$str\"";
+}
+
+open my $trace, '>', "$dir/trace.json" or die "Cannot write $dir/trace.json: $!\n";
+print $trace "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+print $trace join ",\n", map {
+	sprintf '{"name":%s,"cat":%s,"ph":"X","pid":1,"tid":%d,"ts":%d,"dur":%d,'.
+		'"args":{"user":%.2f,"sys":%.2f,"maxrss_kb":%d,"exit":%d}}',
+		json_str("$_->{name} $_->{step}"), json_str($_->{kind}), $_->{lane},
+		($_->{start} - $t0) * 1e6, $_->{time} * 1e6,
+		$_->{user}, $_->{sys}, $_->{rss}, $_->{rc}
+} @steps;
+print $trace "\n]}\n";
+close $trace;
+
+# time during which no recorded step was running
+my ($idle, $until) = (0, $t0);
+foreach my $s (@steps) {
+	$idle += $s->{start} - $until if $s->{start} > $until;
+	$until = $s->{end} if $s->{end} > $until;
+}
+
+my ($busy, $cpu) = (0, 0);
+my %kinds;
+foreach my $s (@steps) {
+	my $k = $kinds{$s->{kind}} //= { count => 0, time => 0, cpu => 0, rss => 0 };
+	$k->{count}++;
+	$k->{time} += $s->{time};
+	$k->{cpu} += $s->{user} + $s->{sys};
+	$k->{rss} = $s->{rss} if $s->{rss} > $k->{rss};
+	$busy += $s->{time};
+	$cpu += $s->{user} + $s->{sys};
+}
+
+my @path;
+my $cur = (sort { $b->{end} <=> $a->{end} } @steps)[0];
+while ($cur) {
+	unshift @path, $cur;
+	my @prev = sort { $b->{end} <=> $a->{end} }
+		grep { $_ != $cur && $_->{end} <= $cur->{start} } @steps;
+	my ($same) = grep { $_->{name} eq $cur->{name} } @prev;
+	$cur = ($same && $prev[0] && $same->{end} >= $prev[0]{end} - 1) ? $same : $prev[0];
+}
+
+my $report = '';
+$report .= sprintf "Wall time:         %10.1f s\n", $wall;
+$report .= sprintf "Step time:         %10.1f s (%.2f steps running on average)\n",
+	$busy, $wall > 0 ? $busy / $wall : 0;
+$report .= sprintf "CPU time:          %10.1f s (%.2f CPUs used on average)\n",
+	$cpu, $wall > 0 ? $cpu / $wall : 0;
+$report .= sprintf "No step running:   %10.1f s\n", $idle;
+
+$report .= sprintf "\n%-16s %6s %10s %10s %10s\n", 'Kind', 'Steps', 'Time [s]', 'CPU [s]', 'RSS [MB]';
+foreach my $kind (sort { $kinds{$b}{time} <=> $kinds{$a}{time} } keys %kinds) {
+	my $k = $kinds{$kind};
+	$report .= sprintf "%-16s %6d %10.1f %10.1f %10.1f\n",
+		$kind, $k->{count}, $k->{time}, $k->{cpu}, $k->{rss} / 1024;
+}
+
+$report .= sprintf "\n%-56s %10s %10s %10s\n", 'Longest steps', 'Time [s]', 'CPU [s]', 'RSS [MB]';
+foreach my $s ((sort { $b->{time} <=> $a->{time} } @steps)[0 .. $top - 1]) {
+	last unless $s;
+	$report .= sprintf "%-56s %10.1f %10.1f %10.1f%s\n",
+		"$s->{name} $s->{step}", $s->{time}, $s->{user} + $s->{sys},
+		$s->{rss} / 1024, $s->{rc} ? " (exit $s->{rc})" : '';
+}
+
+$report .= sprintf "\n%-56s %10s %10s %10s\n", 'Critical path', 'Start [s]', 'Wait [s]', 'Time [s]';
+my $last = $t0;
+foreach my $s (@path) {
+	$report .= sprintf "%-56s %10.1f %10.1f %10.1f\n",
+		"$s->{name} $s->{step}", $s->{start} - $t0, $s->{start} - $last, $s->{time};
+	$last = $s->{end};
+}
+
+open my $out, '>', "$dir/report.txt" or die "Cannot write $dir/report.txt: $!\n";
+print $out $report;
+close $out;
+
+print $report;
+print "\nTrace written to $dir/trace.json\n";
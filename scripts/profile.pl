@@ -0,0 +1,88 @@
+#!/usr/bin/env perl
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# profile - recipe shell of the build steps when BUILD_PROFILE is enabled
+#
+# Usage: profile.pl --step=<name>:<step> <args...>
+#
+# Runs "$BUILD_PROFILE_SHELL <args...>" and appends one line to
+# $BUILD_PROFILE_DIR/steps with the step, start and end time, user and
+# system CPU time, maximum resident set size in kB and exit code of the
+# command. The ProfileStep macro of rules.mk sets this as the shell of
+# the targets of a step.
+
+use strict;
+use warnings;
+
+my @shell = split ' ', ($ENV{BUILD_PROFILE_SHELL} || '/bin/sh');
+$ENV{SHELL} = $ENV{BUILD_PROFILE_SHELL} if $ENV{BUILD_PROFILE_SHELL};
+
+my $step;
+if (@ARGV && $ARGV[0] =~ /^--step=([^:]*):(.*)$/) {
+	$step = "$1 $2";
+	shift @ARGV;
+}
+unless (defined($step) && $ENV{BUILD_PROFILE_DIR}) {
+	exec(@shell, @ARGV);
+	die "$0: Failure to exec(): $!\n";
+}
+
+require Time::HiRes;
+
+# ru_maxrss of the terminated children, in kB on Linux
+sub maxrss {
+	my $buf = "\0" x 144;
+	my $ret;
+
+	eval {
+		require 'syscall.ph';
+		$ret = syscall(SYS_getrusage(), -1, $buf);
+	};
+	return 0 unless defined($ret) && $ret == 0;
+
+	# struct rusage starts with two struct timeval of two longs each
+	my $rss = (unpack 'l!5', $buf)[4];
+	$rss = int($rss / 1024) if $^O eq 'darwin';
+	return $rss;
+}
+
+my $start = Time::HiRes::time();
+my $pid = fork();
+
+if (!defined($pid)) {
+	die "$0: Failure to fork(): $!\n";
+}
+elsif ($pid == 0) {
+	exec(@shell, @ARGV);
+	die "$0: Failure to exec(): $!\n";
+}
+
+$SIG{'INT'} = 'IGNORE';
+$SIG{'QUIT'} = 'IGNORE';
+
+if (waitpid($pid, 0) == -1) {
+	die "$0: Failure to waitpid(): $!\n";
+}
+
+my $status = $?;
+my $end = Time::HiRes::time();
+my (undef, undef, $cuser, $csystem) = times();
+my $exitcode = ($status & 127) ? 128 + ($status & 127) : $status >> 8;
+
+$step =~ s/[\t\n]/ /g;
+unless (-d $ENV{BUILD_PROFILE_DIR}) {
+	require File::Path;
+	File::Path::mkpath($ENV{BUILD_PROFILE_DIR});
+}
+if (open my $fh, '>>', "$ENV{BUILD_PROFILE_DIR}/steps") {
+	# a single write, so that parallel jobs do not mix their lines
+	syswrite $fh, sprintf("%s\t%.6f\t%.6f\t%.2f\t%.2f\t%d\t%d\n",
+		$step, $start, $end, $cuser, $csystem, maxrss(), $exitcode);
+	close $fh;
+}
+
+$SIG{'INT'} = 'DEFAULT';
+$SIG{'QUIT'} = 'DEFAULT';
+
+kill $status & 127, $$ if $status & 127;
+exit $exitcode;
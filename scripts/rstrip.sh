@@ -1,12 +1,23 @@
 #!/usr/bin/env bash
-# 
+#
 # Copyright (C) 2006 OpenWrt.org
 #
 # This is free software, licensed under the GNU General Public License v2.
 # See /LICENSE for more information.
 #
+# ELF files are found with elfscan if $ELFSCAN is set and stripped in
+# parallel when $RSTRIP_JOBSERVER is set and job slots can be taken from
+# the make jobserver, otherwise one after another. Without elfscan they are found with file(1) and
+# always stripped one after another.
+# If $RSTRIP_CACHE is set, stripped files are kept there keyed by the hash
+# of their input and of the strip tools and flags, and unchanged files are
+# copied from it instead of being stripped again. The least recently used
+# entries are removed when it grows beyond $RSTRIP_CACHE_SIZE MB.
+#
 SELF=${0##*/}
 
+export LC_ALL=C
+
 [ -z "$STRIP" ] && {
   echo "$SELF: strip command not defined (STRIP variable not set)"
   exit 1
@@ -20,31 +31,176 @@ TARGETS=$*
   exit 1
 }
 
-find $TARGETS -type f -a -exec file {} \; | \
-  sed -n -e 's/^\(.*\):.*ELF.*\(executable\|relocatable\|shared object\).*,.*/\1:\2/p' | \
-(
-  IFS=":"
-  while read F S; do
-    echo "$SELF: $F: $S"
-	[ "${S}" = "relocatable" ] && {
-		[ "${F##*.}" == "o" ] && continue
+list_elf() {
+	if [ -n "$ELFSCAN" ] && [ -x "$ELFSCAN" ]; then
+		"$ELFSCAN" -u $TARGETS
+	else
+		find $TARGETS -type f -a -exec file {} \; | \
+		  sed -n -e 's/^\(.*\):.*ELF.*\(executable\|relocatable\|shared object\).*,.*/\1:\2/p'
+	fi
+}
+
+hash_files() {
+	[ $# -gt 0 ] || return 0
+	if [ -n "$MKHASH" ]; then
+		$MKHASH -n sha256 "$@"
+	else
+		sha256sum "$@"
+	fi
+}
+
+hash_stdin() {
+	if [ -n "$MKHASH" ]; then
+		$MKHASH sha256
+	else
+		sha256sum | cut -d' ' -f1
+	fi
+}
+
+tool_id() {
+	local tool
+
+	for tool in "$@"; do
+		tool="$(command -v "$tool")" && [ -f "$tool" ] && ls -lL "$tool"
+	done
+}
+
+strip_file() {
+	local F="$1" S="$2" a b old_rpath new_rpath path
+
+	if [ "${S}" = "relocatable" ]; then
+		[ "${F##*.}" == "o" ] && return
 		eval "$STRIP_KMOD $F"
-	} || {
-		b=$(stat -c '%a' $F)
-		[ -z "$PATCHELF" ] || [ -z "$TOPDIR" ] || {
-			old_rpath="$($PATCHELF --print-rpath $F)"; new_rpath=""
-			for path in $old_rpath; do
-				case "$path" in
-					/lib/[^/]*|/usr/lib/[^/]*|\$ORIGIN/*|\$ORIGIN) new_rpath="${new_rpath:+$new_rpath:}$path" ;;
-					*) echo "$SELF: $F: removing rpath $path" ;;
-				esac
-			done
-			[ "$new_rpath" = "$old_rpath" ] || $PATCHELF --set-rpath "$new_rpath" $F
-		}
-		eval "$STRIP $F"
-		a=$(stat -c '%a' $F)
-		[ "$a" = "$b" ] || chmod $b $F
+		return
+	fi
+
+	b=$(stat -c '%a' $F)
+	[ -z "$PATCHELF" ] || [ -z "$TOPDIR" ] || {
+		old_rpath="$($PATCHELF --print-rpath $F)"; new_rpath=""
+		for path in $old_rpath; do
+			case "$path" in
+				/lib/[^/]*|/usr/lib/[^/]*|\$ORIGIN/*|\$ORIGIN) new_rpath="${new_rpath:+$new_rpath:}$path" ;;
+				*) echo "$SELF: $F: removing rpath $path" ;;
+			esac
+		done
+		[ "$new_rpath" = "$old_rpath" ] || $PATCHELF --set-rpath "$new_rpath" $F
+	}
+	eval "$STRIP $F"
+	a=$(stat -c '%a' $F)
+	[ "$a" = "$b" ] || chmod $b $F
+}
+
+process_file() {
+	local F="$1" S="$2" key="$3" cached
+
+	echo "$SELF: $F: $S"
+
+	[ -n "$key" ] || {
+		strip_file "$F" "$S"
+		return
 	}
-  done
-  true
-)
+
+	cached="$CACHE_DIR/$key"
+	strip_file "$F" "$S"
+	cp "$F" "$cached.$BASHPID" && \
+		mv "$cached.$BASHPID" "$cached" || \
+		rm -f "$cached.$BASHPID"
+}
+
+prune_cache() {
+	local limit=$((${RSTRIP_CACHE_SIZE:-1024} * 1024)) size t k f
+
+	size="$(du -sk "$RSTRIP_CACHE" | cut -f1)"
+	[ "$size" -gt "$limit" ] || return 0
+
+	find "$RSTRIP_CACHE" -type f -printf '%T@ %k %p\n' | sort -n | \
+	while read -r t k f; do
+		[ "$size" -gt $((limit * 3 / 4)) ] || break
+		rm -f "$f"
+		size=$((size - k))
+	done
+}
+
+# Only strip in parallel with job slots from the jobserver of the calling
+# make, passed down as descriptors or as a fifo. A fixed number of jobs
+# would multiply with the packages make is already building in parallel.
+# make only hands the jobserver to recipe lines marked with "+", which set
+# $RSTRIP_JOBSERVER; the fifo is named in $MAKEFLAGS for all of them.
+# Without elfscan hardlinked files are listed once per name and must not
+# be stripped concurrently.
+JS_R=
+JS_W=
+[ -n "$RSTRIP_JOBSERVER" ] && [ -n "$ELFSCAN" ] && [ -x "$ELFSCAN" ] && for flag in $MAKEFLAGS; do
+	case "$flag" in
+		--jobserver-auth=fifo:*)
+			[ -p "${flag#*fifo:}" ] && exec {JS_R}<>"${flag#*fifo:}" && JS_W=$JS_R
+			;;
+		--jobserver-auth=*|--jobserver-fds=*)
+			fds="${flag#*=}"
+			[ -p "/proc/$$/fd/${fds%,*}" ] && [ -p "/proc/$$/fd/${fds#*,}" ] && {
+				JS_R="${fds%,*}"
+				JS_W="${fds#*,}"
+			}
+			;;
+	esac
+done
+
+CACHE_DIR=
+[ -n "$RSTRIP_CACHE" ] && {
+	CACHE_DIR="$RSTRIP_CACHE/$( {
+		echo "$STRIP"
+		echo "$STRIP_KMOD"
+		echo "$CROSS $KEEP_BUILD_ID $NO_RENAME $KEEP_SYMBOLS"
+		[ -z "$PATCHELF" ] || [ -z "$TOPDIR" ] || tool_id "$PATCHELF"
+		tool_id ${STRIP%% *} "${CROSS}objcopy" "${CROSS}nm" ${STRIP_KMOD%% *}
+	} | hash_stdin )"
+}
+
+mapfile -t ENTRIES < <(list_elf)
+
+# Hash all inputs in one go and copy the files found in the cache back
+# before anything is started in parallel.
+declare -A KEYS
+[ -n "$CACHE_DIR" ] && mkdir -p "$CACHE_DIR" && {
+	files=()
+	for entry in "${ENTRIES[@]}"; do
+		F="${entry%%:*}"
+		[ "${entry#*:}" = "relocatable" ] && [ "${F##*.}" == "o" ] && continue
+		files+=("$F")
+	done
+	while read -r key F; do
+		KEYS["$F"]="$key"
+	done < <(hash_files "${files[@]}")
+}
+
+stored=
+for entry in "${ENTRIES[@]}"; do
+	F="${entry%%:*}"
+	S="${entry#*:}"
+	key="${KEYS[$F]}"
+
+	# the entry may have been pruned by a concurrent build in the meantime
+	if [ -n "$key" ] && cp --reflink=auto "$CACHE_DIR/$key" "$F" 2>/dev/null; then
+		echo "$SELF: $F: $S"
+		touch -c "$CACHE_DIR/$key"
+		continue
+	fi
+	[ -n "$key" ] && stored=1
+
+	# a token read just as the timeout expires is still stored in $token
+	token=
+	[ -n "$JS_R" ] && IFS= read -r -n1 -t 0.01 -u "$JS_R" token
+
+	if [ -n "$token" ]; then
+		(
+			process_file "$F" "$S" "$key"
+			printf '%s' "$token" >&$JS_W
+		) &
+	else
+		process_file "$F" "$S" "$key"
+	fi
+done
+
+wait
+[ -z "$stored" ] || prune_cache
+true
@@ -0,0 +1,501 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * elfscan - classify ELF files below a set of paths
+ *
+ * Walks the given files and directories (without following symlinks) and
+ * reads the ELF header, program headers and dynamic section of every
+ * regular file to classify it the way file(1) would, without loading a
+ * magic database. Files are examined by a pool of threads, output order
+ * only depends on the directory contents: the files of a directory are
+ * listed in name order before its subdirectories.
+ *
+ * By default every executable, relocatable object and shared object is
+ * printed as "<path>:<type>", with -u only under the first name of files
+ * having several hardlinks. With -x and -l the dynamically linked
+ * executables (with the owner execute bit set) and the shared objects
+ * named *.so* are written to separate files as expected by mklibs.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define MAX_PHNUM	256
+#define MAX_DYN_SIZE	(256 * 1024)
+
+enum elf_type {
+	TYPE_NONE,
+	TYPE_EXEC,
+	TYPE_REL,
+	TYPE_SHARED,
+};
+
+static const char * const type_names[] = {
+	[TYPE_EXEC] = "executable",
+	[TYPE_REL] = "relocatable",
+	[TYPE_SHARED] = "shared object",
+};
+
+struct entry {
+	char *path;
+	mode_t mode;
+	dev_t dev;
+	ino_t ino;
+	nlink_t nlink;
+	enum elf_type type;
+	bool dynamic;
+};
+
+struct elf_file {
+	int fd;
+	bool is64;
+	bool swap;
+};
+
+static struct entry *entries;
+static size_t n_entries, entries_size;
+static size_t next_entry;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint16_t get16(const struct elf_file *ef, uint16_t v)
+{
+	return ef->swap ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t get32(const struct elf_file *ef, uint32_t v)
+{
+	return ef->swap ? __builtin_bswap32(v) : v;
+}
+
+static uint64_t get64(const struct elf_file *ef, uint64_t v)
+{
+	return ef->swap ? __builtin_bswap64(v) : v;
+}
+
+static bool read_at(int fd, void *buf, size_t len, off_t ofs)
+{
+	uint8_t *p = buf;
+
+	while (len > 0) {
+		ssize_t r = pread(fd, p, len, ofs);
+
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return false;
+
+		p += r;
+		ofs += r;
+		len -= r;
+	}
+
+	return true;
+}
+
+static bool host_big_endian(void)
+{
+	const uint16_t v = 1;
+
+	return *(const uint8_t *)&v == 0;
+}
+
+/* Check DT_FLAGS_1 for DF_1_PIE, which file(1) reports as executable */
+static bool dyn_is_pie(const struct elf_file *ef, uint64_t ofs, uint64_t size)
+{
+	size_t ent = ef->is64 ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+	bool pie = false;
+	uint8_t *buf;
+	size_t i;
+
+	if (size > MAX_DYN_SIZE)
+		size = MAX_DYN_SIZE;
+
+	buf = malloc(size);
+	if (!buf || !read_at(ef->fd, buf, size, ofs))
+		goto out;
+
+	for (i = 0; i + ent <= size; i += ent) {
+		uint64_t tag, val;
+
+		if (ef->is64) {
+			Elf64_Dyn *d = (Elf64_Dyn *)(buf + i);
+
+			tag = get64(ef, d->d_tag);
+			val = get64(ef, d->d_un.d_val);
+		} else {
+			Elf32_Dyn *d = (Elf32_Dyn *)(buf + i);
+
+			tag = get32(ef, d->d_tag);
+			val = get32(ef, d->d_un.d_val);
+		}
+
+		if (tag == DT_NULL)
+			break;
+
+		if (tag == DT_FLAGS_1) {
+			pie = !!(val & DF_1_PIE);
+			break;
+		}
+	}
+
+out:
+	free(buf);
+	return pie;
+}
+
+static void classify(struct entry *e)
+{
+	unsigned char ident[EI_NIDENT];
+	struct elf_file ef;
+	uint64_t phoff, dyn_ofs = 0, dyn_size = 0;
+	uint16_t type, phnum, phentsize;
+	bool interp = false, dynamic = false;
+	unsigned int i;
+
+	ef.fd = open(e->path, O_RDONLY | O_NOFOLLOW);
+	if (ef.fd < 0)
+		return;
+
+	if (!read_at(ef.fd, ident, sizeof(ident), 0) ||
+	    memcmp(ident, ELFMAG, SELFMAG) != 0 ||
+	    (ident[EI_CLASS] != ELFCLASS32 && ident[EI_CLASS] != ELFCLASS64) ||
+	    (ident[EI_DATA] != ELFDATA2LSB && ident[EI_DATA] != ELFDATA2MSB))
+		goto out;
+
+	ef.is64 = ident[EI_CLASS] == ELFCLASS64;
+	ef.swap = (ident[EI_DATA] == ELFDATA2MSB) != host_big_endian();
+
+	if (ef.is64) {
+		Elf64_Ehdr eh;
+
+		if (!read_at(ef.fd, &eh, sizeof(eh), 0))
+			goto out;
+
+		type = get16(&ef, eh.e_type);
+		phoff = get64(&ef, eh.e_phoff);
+		phnum = get16(&ef, eh.e_phnum);
+		phentsize = get16(&ef, eh.e_phentsize);
+	} else {
+		Elf32_Ehdr eh;
+
+		if (!read_at(ef.fd, &eh, sizeof(eh), 0))
+			goto out;
+
+		type = get16(&ef, eh.e_type);
+		phoff = get32(&ef, eh.e_phoff);
+		phnum = get16(&ef, eh.e_phnum);
+		phentsize = get16(&ef, eh.e_phentsize);
+	}
+
+	if (phnum > MAX_PHNUM)
+		phnum = MAX_PHNUM;
+
+	for (i = 0; phoff && i < phnum; i++) {
+		off_t ofs = phoff + (uint64_t)i * phentsize;
+		uint32_t p_type;
+		uint64_t p_offset, p_filesz;
+
+		if (ef.is64) {
+			Elf64_Phdr ph;
+
+			if (phentsize < sizeof(ph) || !read_at(ef.fd, &ph, sizeof(ph), ofs))
+				break;
+
+			p_type = get32(&ef, ph.p_type);
+			p_offset = get64(&ef, ph.p_offset);
+			p_filesz = get64(&ef, ph.p_filesz);
+		} else {
+			Elf32_Phdr ph;
+
+			if (phentsize < sizeof(ph) || !read_at(ef.fd, &ph, sizeof(ph), ofs))
+				break;
+
+			p_type = get32(&ef, ph.p_type);
+			p_offset = get32(&ef, ph.p_offset);
+			p_filesz = get32(&ef, ph.p_filesz);
+		}
+
+		if (p_type == PT_INTERP) {
+			interp = true;
+		} else if (p_type == PT_DYNAMIC) {
+			dynamic = true;
+			dyn_ofs = p_offset;
+			dyn_size = p_filesz;
+		}
+	}
+
+	e->dynamic = interp || dynamic;
+
+	switch (type) {
+	case ET_EXEC:
+		e->type = TYPE_EXEC;
+		break;
+	case ET_REL:
+		e->type = TYPE_REL;
+		break;
+	case ET_DYN:
+		if (interp && dynamic && dyn_is_pie(&ef, dyn_ofs, dyn_size))
+			e->type = TYPE_EXEC;
+		else
+			e->type = TYPE_SHARED;
+		break;
+	}
+
+out:
+	close(ef.fd);
+}
+
+static void *worker(void *arg)
+{
+	while (1) {
+		size_t i;
+
+		pthread_mutex_lock(&next_lock);
+		i = next_entry++;
+		pthread_mutex_unlock(&next_lock);
+
+		if (i >= n_entries)
+			break;
+
+		classify(&entries[i]);
+	}
+
+	return NULL;
+}
+
+static void add_entry(const char *path, const struct stat *st)
+{
+	if (n_entries == entries_size) {
+		entries_size = entries_size ? entries_size * 2 : 1024;
+		entries = realloc(entries, entries_size * sizeof(*entries));
+		if (!entries) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	entries[n_entries++] = (struct entry) {
+		.path = strdup(path),
+		.mode = st->st_mode,
+		.dev = st->st_dev,
+		.ino = st->st_ino,
+		.nlink = st->st_nlink,
+	};
+}
+
+static int name_cmp(const struct dirent **a, const struct dirent **b)
+{
+	return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+static int walk(const char *dir)
+{
+	struct dirent **names;
+	char **subdirs;
+	int i, n, n_subdirs = 0;
+
+	n = scandir(dir, &names, NULL, name_cmp);
+	if (n < 0) {
+		fprintf(stderr, "elfscan: %s: %s\n", dir, strerror(errno));
+		return -1;
+	}
+
+	subdirs = calloc(n + 1, sizeof(*subdirs));
+
+	for (i = 0; i < n; i++) {
+		const char *name = names[i]->d_name;
+		struct stat st;
+		char *path;
+
+		if (!strcmp(name, ".") || !strcmp(name, "..") ||
+		    asprintf(&path, "%s/%s", dir, name) < 0)
+			goto next;
+
+		if (lstat(path, &st) < 0) {
+			free(path);
+			goto next;
+		}
+
+		if (S_ISREG(st.st_mode)) {
+			add_entry(path, &st);
+			free(path);
+		} else if (S_ISDIR(st.st_mode)) {
+			subdirs[n_subdirs++] = path;
+		} else {
+			free(path);
+		}
+next:
+		free(names[i]);
+	}
+	free(names);
+
+	for (i = 0; i < n_subdirs; i++) {
+		walk(subdirs[i]);
+		free(subdirs[i]);
+	}
+	free(subdirs);
+
+	return 0;
+}
+
+static int add_path(const char *arg)
+{
+	char *path = strdup(arg);
+	size_t len = strlen(path);
+	struct stat st;
+	int ret = 0;
+
+	while (len > 1 && path[len - 1] == '/')
+		path[--len] = 0;
+
+	if (lstat(path, &st) < 0) {
+		fprintf(stderr, "elfscan: %s: %s\n", path, strerror(errno));
+		ret = -1;
+	} else if (S_ISDIR(st.st_mode)) {
+		ret = walk(path);
+	} else if (S_ISREG(st.st_mode)) {
+		add_entry(path, &st);
+	}
+
+	free(path);
+	return ret;
+}
+
+static bool seen_before(size_t n)
+{
+	size_t i;
+
+	if (entries[n].nlink < 2)
+		return false;
+
+	for (i = 0; i < n; i++)
+		if (entries[i].ino == entries[n].ino &&
+		    entries[i].dev == entries[n].dev)
+			return true;
+
+	return false;
+}
+
+static FILE *open_list(const char *name)
+{
+	FILE *f;
+
+	if (!name)
+		return NULL;
+
+	f = fopen(name, "w");
+	if (!f) {
+		fprintf(stderr, "elfscan: %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+
+	return f;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-j <jobs>] [-u] [-x <progs>] [-l <libs>] <path>...\n"
+		"\n"
+		"  -j <jobs>   number of threads (default: online CPUs)\n"
+		"  -u          list files with several hardlinks only once\n"
+		"  -x <progs>  write dynamically linked executables to <progs>\n"
+		"  -l <libs>   write shared objects named *.so* to <libs>\n"
+		"\n"
+		"Without -x and -l every ELF executable, relocatable and shared\n"
+		"object is printed as <path>:<type>.\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *progs_name = NULL, *libs_name = NULL;
+	FILE *progs, *libs;
+	pthread_t *threads;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	bool unique = false;
+	int i, ch, ret = 0;
+	size_t n;
+
+	while ((ch = getopt(argc, argv, "j:ux:l:")) != -1) {
+		switch (ch) {
+		case 'j':
+			jobs = atol(optarg);
+			break;
+		case 'u':
+			unique = true;
+			break;
+		case 'x':
+			progs_name = optarg;
+			break;
+		case 'l':
+			libs_name = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind >= argc)
+		usage(argv[0]);
+
+	for (i = optind; i < argc; i++)
+		if (add_path(argv[i]))
+			ret = 1;
+
+	if (jobs < 1)
+		jobs = 1;
+	if ((size_t)jobs > n_entries)
+		jobs = n_entries ? n_entries : 1;
+
+	threads = calloc(jobs, sizeof(*threads));
+	for (i = 1; i < jobs; i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL))
+			break;
+	worker(NULL);
+	while (--i > 0)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	progs = open_list(progs_name);
+	libs = open_list(libs_name);
+
+	for (n = 0; n < n_entries; n++) {
+		struct entry *e = &entries[n];
+		const char *base = strrchr(e->path, '/');
+
+		base = base ? base + 1 : e->path;
+
+		if (!progs && !libs) {
+			if (e->type != TYPE_NONE && !(unique && seen_before(n)))
+				printf("%s:%s\n", e->path, type_names[e->type]);
+			continue;
+		}
+
+		if (progs && e->type == TYPE_EXEC && e->dynamic && (e->mode & S_IXUSR))
+			fprintf(progs, "%s\n", e->path);
+
+		if (libs && e->type == TYPE_SHARED && !fnmatch("*.so*", base, 0))
+			fprintf(libs, "%s\n", e->path);
+	}
+
+	if (progs && fclose(progs))
+		ret = 1;
+	if (libs && fclose(libs))
+		ret = 1;
+
+	return ret;
+}
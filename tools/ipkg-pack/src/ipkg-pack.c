@@ -0,0 +1,665 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * ipkg-pack - build an .ipk package in a single process
+ *
+ * Creates data.tar.gz, control.tar.gz and the outer package archive of
+ * an ipkg-build style package directory in memory, without temporary
+ * files. Archive headers are deterministic (GNU format, numeric owners,
+ * fixed mtime, entries sorted by name).
+ *
+ * Compression splits the input into fixed size blocks which are deflated
+ * independently, each primed with the preceding 32 KiB as dictionary, and
+ * joined with sync flushes. The resulting gzip stream only depends on the
+ * input and the compression level, never on the number of threads used.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#define TAR_BLOCK	512
+#define TAR_RECORD	(20 * TAR_BLOCK)
+#define GZ_BLOCK	(128 * 1024)
+#define GZ_DICT		(32 * 1024)
+
+struct buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+};
+
+struct link_ent {
+	dev_t dev;
+	ino_t ino;
+	char *name;
+};
+
+struct tar {
+	struct buf *out;
+	time_t mtime;
+	struct link_ent *links;
+	size_t n_links;
+};
+
+struct gz_job {
+	const uint8_t *in;
+	size_t in_len;
+	int level;
+	size_t n_blocks;
+	struct buf *blocks;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+static const char *progname;
+
+static void __attribute__((noreturn, format(printf, 1, 2)))
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (!ptr)
+		fail("out of memory");
+
+	return ptr;
+}
+
+static char *xstrdup(const char *s)
+{
+	char *ret = strdup(s);
+
+	if (!ret)
+		fail("out of memory");
+
+	return ret;
+}
+
+static void buf_reserve(struct buf *b, size_t len)
+{
+	if (b->len + len <= b->size)
+		return;
+
+	while (b->len + len > b->size)
+		b->size = b->size ? b->size * 2 : 64 * 1024;
+
+	b->data = xrealloc(b->data, b->size);
+}
+
+static void buf_append(struct buf *b, const void *data, size_t len)
+{
+	buf_reserve(b, len);
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void buf_pad(struct buf *b, size_t align)
+{
+	size_t pad = (align - b->len % align) % align;
+
+	buf_reserve(b, pad);
+	memset(b->data + b->len, 0, pad);
+	b->len += pad;
+}
+
+static void buf_free(struct buf *b)
+{
+	free(b->data);
+	memset(b, 0, sizeof(*b));
+}
+
+static void read_file(const char *path, size_t size, struct buf *b)
+{
+	size_t done = 0;
+	ssize_t r;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		fail("cannot open %s: %s", path, strerror(errno));
+
+	buf_reserve(b, size);
+	while (done < size) {
+		r = read(fd, b->data + b->len + done, size - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			fail("cannot read %s: %s", path,
+			     r ? strerror(errno) : "file truncated");
+		done += r;
+	}
+	b->len += size;
+	close(fd);
+}
+
+/*
+ * GNU tar (--format=gnu --numeric-owner) compatible header encoding:
+ * len - 1 octal digits and a NUL, or base-256 with the high bit of the
+ * first byte set if the value does not fit.
+ */
+static void tar_octal(char *field, size_t len, unsigned long long val)
+{
+	unsigned long long v = val;
+	size_t i;
+
+	if (len - 1 >= 22 || !(val >> (3 * (len - 1)))) {
+		field[len - 1] = 0;
+		for (i = len - 1; i > 0; i--, v >>= 3)
+			field[i - 1] = '0' + (v & 7);
+		return;
+	}
+
+	if (len - 1 < sizeof(val) && (val >> (8 * (len - 1))))
+		fail("value %llu does not fit in a tar header field", val);
+
+	for (i = len; i > 0; i--, v >>= 8)
+		field[i - 1] = v & 0xff;
+	field[0] = (char)0x80;
+}
+
+static void tar_header(struct tar *t, const char *name, const char *link,
+		       char type, mode_t mode, uid_t uid, gid_t gid,
+		       unsigned long long size, dev_t rdev)
+{
+	char hdr[TAR_BLOCK];
+	unsigned int sum = 0;
+	size_t i;
+
+	memset(hdr, 0, sizeof(hdr));
+	strncpy(hdr, name, 100);
+	tar_octal(hdr + 100, 8, mode & 07777);
+	tar_octal(hdr + 108, 8, uid);
+	tar_octal(hdr + 116, 8, gid);
+	tar_octal(hdr + 124, 12, size);
+	tar_octal(hdr + 136, 12, t->mtime);
+	memset(hdr + 148, ' ', 8);
+	hdr[156] = type;
+	if (link)
+		strncpy(hdr + 157, link, 100);
+	memcpy(hdr + 257, "ustar  ", 8);
+	if (type == '3' || type == '4') {
+		tar_octal(hdr + 329, 8, major(rdev));
+		tar_octal(hdr + 337, 8, minor(rdev));
+	}
+
+	for (i = 0; i < sizeof(hdr); i++)
+		sum += (unsigned char)hdr[i];
+
+	tar_octal(hdr + 148, 7, sum);
+	hdr[155] = ' ';
+
+	buf_append(t->out, hdr, sizeof(hdr));
+}
+
+static void tar_longname(struct tar *t, char type, const char *name)
+{
+	size_t len = strlen(name) + 1;
+	time_t mtime = t->mtime;
+
+	/* GNU tar does not timestamp long name records */
+	t->mtime = 0;
+	tar_header(t, "././@LongLink", NULL, type, 0644, 0, 0, len, 0);
+	t->mtime = mtime;
+	buf_append(t->out, name, len);
+	buf_pad(t->out, TAR_BLOCK);
+}
+
+static void tar_entry(struct tar *t, const char *name, const char *link,
+		      char type, const struct stat *st, unsigned long long size)
+{
+	if (link && strlen(link) > 100)
+		tar_longname(t, 'K', link);
+	if (strlen(name) > 100)
+		tar_longname(t, 'L', name);
+
+	tar_header(t, name, link, type, st->st_mode, st->st_uid, st->st_gid,
+		   size, st->st_rdev);
+}
+
+static const char *tar_hardlink(struct tar *t, const char *name,
+				const struct stat *st)
+{
+	size_t i;
+
+	if (st->st_nlink < 2)
+		return NULL;
+
+	for (i = 0; i < t->n_links; i++)
+		if (t->links[i].dev == st->st_dev && t->links[i].ino == st->st_ino)
+			return t->links[i].name;
+
+	t->links = xrealloc(t->links, (t->n_links + 1) * sizeof(*t->links));
+	t->links[t->n_links].dev = st->st_dev;
+	t->links[t->n_links].ino = st->st_ino;
+	t->links[t->n_links].name = xstrdup(name);
+	t->n_links++;
+
+	return NULL;
+}
+
+static int name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+static void tar_add(struct tar *t, const char *path, const char *name,
+		    const char *exclude);
+
+static void tar_add_dir(struct tar *t, const char *path, const char *name,
+			const char *exclude)
+{
+	char **names = NULL;
+	size_t n = 0, i;
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(path);
+	if (!d)
+		fail("cannot open directory %s: %s", path, strerror(errno));
+
+	while ((de = readdir(d)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		if (exclude && !strcmp(de->d_name, exclude))
+			continue;
+
+		names = xrealloc(names, (n + 1) * sizeof(*names));
+		names[n++] = xstrdup(de->d_name);
+	}
+	closedir(d);
+
+	qsort(names, n, sizeof(*names), name_cmp);
+
+	for (i = 0; i < n; i++) {
+		char *sub_path, *sub_name;
+
+		if (asprintf(&sub_path, "%s/%s", path, names[i]) < 0 ||
+		    asprintf(&sub_name, "%s%s", name, names[i]) < 0)
+			fail("out of memory");
+
+		tar_add(t, sub_path, sub_name, exclude);
+		free(sub_path);
+		free(sub_name);
+		free(names[i]);
+	}
+	free(names);
+}
+
+static void tar_add(struct tar *t, const char *path, const char *name,
+		    const char *exclude)
+{
+	char link[PATH_MAX];
+	const char *target;
+	struct stat st;
+	char *dir_name;
+	ssize_t len;
+
+	if (lstat(path, &st))
+		fail("cannot stat %s: %s", path, strerror(errno));
+
+	switch (st.st_mode & S_IFMT) {
+	case S_IFDIR:
+		if (asprintf(&dir_name, "%s/", name) < 0)
+			fail("out of memory");
+
+		tar_entry(t, dir_name, NULL, '5', &st, 0);
+		tar_add_dir(t, path, dir_name, exclude);
+		free(dir_name);
+		break;
+
+	case S_IFREG:
+		target = tar_hardlink(t, name, &st);
+		if (target) {
+			tar_entry(t, name, target, '1', &st, 0);
+			break;
+		}
+
+		tar_entry(t, name, NULL, '0', &st, st.st_size);
+		read_file(path, st.st_size, t->out);
+		buf_pad(t->out, TAR_BLOCK);
+		break;
+
+	case S_IFLNK:
+		len = readlink(path, link, sizeof(link) - 1);
+		if (len < 0)
+			fail("cannot read link %s: %s", path, strerror(errno));
+
+		link[len] = 0;
+		tar_entry(t, name, link, '2', &st, 0);
+		break;
+
+	case S_IFCHR:
+		tar_entry(t, name, NULL, '3', &st, 0);
+		break;
+
+	case S_IFBLK:
+		tar_entry(t, name, NULL, '4', &st, 0);
+		break;
+
+	case S_IFIFO:
+		tar_entry(t, name, NULL, '6', &st, 0);
+		break;
+
+	default:
+		fprintf(stderr, "%s: %s: socket ignored\n", progname, path);
+		break;
+	}
+}
+
+static void tar_add_buf(struct tar *t, const char *name, const struct buf *b)
+{
+	struct stat st = {
+		.st_mode = 0644,
+		.st_uid = getuid(),
+		.st_gid = getgid(),
+	};
+
+	tar_entry(t, name, NULL, '0', &st, b->len);
+	buf_append(t->out, b->data, b->len);
+	buf_pad(t->out, TAR_BLOCK);
+}
+
+static void tar_finish(struct tar *t)
+{
+	size_t i;
+
+	buf_reserve(t->out, 2 * TAR_BLOCK);
+	memset(t->out->data + t->out->len, 0, 2 * TAR_BLOCK);
+	t->out->len += 2 * TAR_BLOCK;
+	buf_pad(t->out, TAR_RECORD);
+
+	for (i = 0; i < t->n_links; i++)
+		free(t->links[i].name);
+	free(t->links);
+	t->links = NULL;
+	t->n_links = 0;
+}
+
+static void gz_block(struct gz_job *job, size_t idx)
+{
+	size_t start = idx * GZ_BLOCK;
+	size_t len = job->in_len - start;
+	struct buf *out = &job->blocks[idx];
+	bool last = idx == job->n_blocks - 1;
+	z_stream zs = {};
+	int ret;
+
+	if (len > GZ_BLOCK)
+		len = GZ_BLOCK;
+
+	if (deflateInit2(&zs, job->level, Z_DEFLATED, -15, 8,
+			 Z_DEFAULT_STRATEGY) != Z_OK)
+		fail("deflateInit2 failed");
+
+	if (start)
+		deflateSetDictionary(&zs, job->in + start - GZ_DICT, GZ_DICT);
+
+	buf_reserve(out, deflateBound(&zs, len) + 16);
+	zs.next_in = (Bytef *)job->in + start;
+	zs.avail_in = len;
+	zs.next_out = out->data;
+	zs.avail_out = out->size;
+
+	ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+	if (ret != (last ? Z_STREAM_END : Z_OK) || zs.avail_in)
+		fail("deflate failed");
+
+	out->len = out->size - zs.avail_out;
+	deflateEnd(&zs);
+}
+
+static void *gz_worker(void *arg)
+{
+	struct gz_job *job = arg;
+	size_t idx;
+
+	while (1) {
+		pthread_mutex_lock(&job->lock);
+		idx = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (idx >= job->n_blocks)
+			break;
+
+		gz_block(job, idx);
+	}
+
+	return NULL;
+}
+
+static void gz_compress(const struct buf *in, struct buf *out, int level,
+			int jobs)
+{
+	static const uint8_t gz_hdr[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+	struct gz_job job = {
+		.in = in->data,
+		.in_len = in->len,
+		.level = level,
+	};
+	pthread_t *threads;
+	uint8_t trailer[8];
+	uint32_t crc;
+	size_t i;
+	int n;
+
+	job.n_blocks = in->len ? (in->len + GZ_BLOCK - 1) / GZ_BLOCK : 1;
+	job.blocks = calloc(job.n_blocks, sizeof(*job.blocks));
+	if (!job.blocks)
+		fail("out of memory");
+
+	pthread_mutex_init(&job.lock, NULL);
+
+	n = jobs;
+	if ((size_t)n > job.n_blocks)
+		n = job.n_blocks;
+
+	threads = calloc(n, sizeof(*threads));
+	if (!threads)
+		fail("out of memory");
+
+	for (i = 1; i < (size_t)n; i++)
+		if (pthread_create(&threads[i], NULL, gz_worker, &job))
+			fail("cannot create thread");
+
+	gz_worker(&job);
+	crc = crc32(0, in->data, in->len);
+
+	for (i = 1; i < (size_t)n; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_mutex_destroy(&job.lock);
+
+	buf_append(out, gz_hdr, sizeof(gz_hdr));
+	if (level == 9)
+		out->data[out->len - 2] = 2;
+	else if (level == 1)
+		out->data[out->len - 2] = 4;
+
+	for (i = 0; i < job.n_blocks; i++) {
+		buf_append(out, job.blocks[i].data, job.blocks[i].len);
+		buf_free(&job.blocks[i]);
+	}
+	free(job.blocks);
+
+	for (i = 0; i < 4; i++) {
+		trailer[i] = crc >> (8 * i);
+		trailer[4 + i] = (uint32_t)in->len >> (8 * i);
+	}
+	buf_append(out, trailer, sizeof(trailer));
+}
+
+static void write_file(const char *path, const struct buf *b)
+{
+	size_t done = 0;
+	ssize_t r;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		fail("cannot create %s: %s", path, strerror(errno));
+
+	while (done < b->len) {
+		r = write(fd, b->data + done, b->len - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			fail("cannot write %s: %s", path, strerror(errno));
+		done += r;
+	}
+
+	if (close(fd))
+		fail("cannot write %s: %s", path, strerror(errno));
+}
+
+/* Rewrite the Installed-Size field in place, like ipkg-build does with sed */
+static void update_installed_size(const char *path, size_t size)
+{
+	struct buf in = {}, out = {};
+	struct stat st;
+	char *line, *end;
+	char field[64];
+
+	if (stat(path, &st))
+		fail("cannot stat %s: %s", path, strerror(errno));
+
+	read_file(path, st.st_size, &in);
+	buf_append(&in, "", 1);
+
+	for (line = (char *)in.data; *line; line = end) {
+		end = strchrnul(line, '\n');
+		if (*end)
+			end++;
+
+		if (!strncmp(line, "Installed-Size: ", 16)) {
+			snprintf(field, sizeof(field), "Installed-Size: %zu", size);
+			buf_append(&out, field, strlen(field));
+			if (end[-1] == '\n')
+				buf_append(&out, "\n", 1);
+			continue;
+		}
+
+		buf_append(&out, line, end - line);
+	}
+
+	write_file(path, &out);
+	buf_free(&in);
+	buf_free(&out);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: %s [options] <pkg_directory> <output.ipk>\n"
+		"Options:\n"
+		"  -t <epoch>    timestamp of all archive members\n"
+		"  -l <level>    gzip compression level (default: 6)\n"
+		"  -j <jobs>     compression threads (default: 1)\n",
+		progname);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct buf data = {}, control = {}, data_gz = {}, control_gz = {};
+	struct buf pkg = {}, pkg_gz = {};
+	static const struct buf debian_binary = {
+		.data = (uint8_t *)"2.0\n",
+		.len = 4,
+	};
+	struct tar t = {};
+	int level = Z_DEFAULT_COMPRESSION;
+	int jobs = 1;
+	char *control_dir, *control_file;
+	const char *pkg_dir;
+	int ch;
+
+	progname = argv[0];
+	while ((ch = getopt(argc, argv, "t:l:j:")) != -1) {
+		switch (ch) {
+		case 't':
+			t.mtime = strtoll(optarg, NULL, 10);
+			break;
+		case 'l':
+			level = atoi(optarg);
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (argc - optind != 2)
+		usage();
+
+	if (level == Z_DEFAULT_COMPRESSION)
+		level = 6;
+	if (level < 1 || level > 9)
+		fail("invalid compression level %d", level);
+	if (jobs < 1)
+		jobs = 1;
+
+	pkg_dir = argv[optind];
+	if (asprintf(&control_dir, "%s/CONTROL", pkg_dir) < 0 ||
+	    asprintf(&control_file, "%s/control", control_dir) < 0)
+		fail("out of memory");
+
+	t.out = &data;
+	tar_add(&t, pkg_dir, ".", "CONTROL");
+	tar_finish(&t);
+	gz_compress(&data, &data_gz, level, jobs);
+	buf_free(&data);
+
+	update_installed_size(control_file, data_gz.len);
+
+	t.out = &control;
+	tar_add(&t, control_dir, ".", NULL);
+	tar_finish(&t);
+	gz_compress(&control, &control_gz, level, jobs);
+	buf_free(&control);
+
+	t.out = &pkg;
+	tar_add_buf(&t, "./debian-binary", &debian_binary);
+	tar_add_buf(&t, "./data.tar.gz", &data_gz);
+	tar_add_buf(&t, "./control.tar.gz", &control_gz);
+	tar_finish(&t);
+	buf_free(&data_gz);
+	buf_free(&control_gz);
+
+	gz_compress(&pkg, &pkg_gz, level, jobs);
+	buf_free(&pkg);
+
+	write_file(argv[optind + 1], &pkg_gz);
+	buf_free(&pkg_gz);
+
+	free(control_dir);
+	free(control_file);
+
+	return 0;
+}